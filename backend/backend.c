@@ -12,6 +12,7 @@
 #include <wlr/backend/libinput.h>
 #include <wlr/backend/multi.h>
 #include <wlr/backend/noop.h>
+#include <wlr/backend/replay.h>
 #include <wlr/backend/session.h>
 #include <wlr/backend/wayland.h>
 #include <wlr/config.h>
@@ -148,6 +149,29 @@ static struct wlr_backend *attempt_noop_backend(struct wl_display *display) {
 	return backend;
 }
 
+static struct wlr_backend *attempt_replay_backend(
+		struct wl_display *display) {
+	const char *path = getenv("WLR_REPLAY_TRACE");
+	if (path == NULL) {
+		wlr_log(WLR_ERROR, "WLR_REPLAY_TRACE is required by the replay backend");
+		return NULL;
+	}
+
+	double speed = 1;
+	const char *speed_str = getenv("WLR_REPLAY_SPEED");
+	if (speed_str != NULL) {
+		char *end;
+		speed = strtod(speed_str, &end);
+		if (*end || speed < 0) {
+			wlr_log(WLR_ERROR, "WLR_REPLAY_SPEED specified with invalid "
+				"value, defaulting to 1");
+			speed = 1;
+		}
+	}
+
+	return wlr_replay_backend_create(display, path, speed);
+}
+
 static struct wlr_backend *attempt_drm_backend(struct wl_display *display,
 		struct wlr_backend *backend, struct wlr_session *session,
 		wlr_renderer_create_func_t create_renderer_func) {
@@ -187,6 +211,8 @@ static struct wlr_backend *attempt_backend_by_name(struct wl_display *display,
 		return attempt_headless_backend(display, create_renderer_func);
 	} else if (strcmp(name, "noop") == 0) {
 		return attempt_noop_backend(display);
+	} else if (strcmp(name, "replay") == 0) {
+		return attempt_replay_backend(display);
 	} else if (strcmp(name, "drm") == 0 || strcmp(name, "libinput") == 0) {
 		// DRM and libinput need a session
 		if (!*session) {
@@ -97,6 +97,33 @@ static void set_plane_props(struct atomic *atom, struct wlr_drm_plane *plane,
 	}
 }
 
+static void set_overlay_props(struct atomic *atom, struct wlr_drm_crtc *crtc) {
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = crtc->overlays[i];
+		uint32_t id = plane->id;
+		const union wlr_drm_plane_props *props = &plane->props;
+
+		if (plane->overlay.fb_id == 0) {
+			atomic_add(atom, id, props->fb_id, 0);
+			atomic_add(atom, id, props->crtc_id, 0);
+			continue;
+		}
+
+		// Overlays aren't scaled, the source and destination sizes match
+		const struct wlr_box *box = &plane->overlay.box;
+		atomic_add(atom, id, props->src_x, 0);
+		atomic_add(atom, id, props->src_y, 0);
+		atomic_add(atom, id, props->src_w, (uint64_t)box->width << 16);
+		atomic_add(atom, id, props->src_h, (uint64_t)box->height << 16);
+		atomic_add(atom, id, props->crtc_x, (uint64_t)box->x);
+		atomic_add(atom, id, props->crtc_y, (uint64_t)box->y);
+		atomic_add(atom, id, props->crtc_w, box->width);
+		atomic_add(atom, id, props->crtc_h, box->height);
+		atomic_add(atom, id, props->fb_id, plane->overlay.fb_id);
+		atomic_add(atom, id, props->crtc_id, crtc->id);
+	}
+}
+
 static bool atomic_crtc_pageflip(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn,
 		struct wlr_drm_crtc *crtc,
@@ -130,6 +157,9 @@ static bool atomic_crtc_pageflip(struct wlr_drm_backend *drm,
 	atomic_add(&atom, crtc->id, crtc->props.mode_id, crtc->mode_id);
 	atomic_add(&atom, crtc->id, crtc->props.active, 1);
 	set_plane_props(&atom, crtc->primary, crtc->id, fb_id, true);
+	if (crtc->overlays_changed) {
+		set_overlay_props(&atom, crtc);
+	}
 	return atomic_commit(drm->fd, &atom, conn, flags, mode);
 }
 
@@ -257,6 +287,22 @@ static size_t atomic_crtc_get_gamma_size(struct wlr_drm_backend *drm,
 	return (size_t)gamma_lut_size;
 }
 
+static bool atomic_crtc_test_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc) {
+	struct atomic atom;
+	atomic_begin(crtc, &atom);
+	set_overlay_props(&atom, crtc);
+	if (atom.failed) {
+		return false;
+	}
+
+	// Rejected configurations are expected here, don't log failures
+	uint32_t flags = DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_NONBLOCK;
+	int ret = drmModeAtomicCommit(drm->fd, atom.req, flags, NULL);
+	drmModeAtomicSetCursor(atom.req, atom.cursor);
+	return ret == 0;
+}
+
 const struct wlr_drm_interface atomic_iface = {
 	.conn_enable = atomic_conn_enable,
 	.crtc_pageflip = atomic_crtc_pageflip,
@@ -264,4 +310,5 @@ const struct wlr_drm_interface atomic_iface = {
 	.crtc_move_cursor = atomic_crtc_move_cursor,
 	.crtc_set_gamma = atomic_crtc_set_gamma,
 	.crtc_get_gamma_size = atomic_crtc_get_gamma_size,
+	.crtc_test_overlays = atomic_crtc_test_overlays,
 };
@@ -91,6 +91,11 @@ static void session_signal(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_INFO, "DRM fd resumed");
 		scan_drm_connectors(drm);
 
+		// Another DRM master may have changed the overlay planes
+		for (size_t i = 0; i < drm->num_crtcs; ++i) {
+			drm->crtcs[i].overlays_changed = true;
+		}
+
 		struct wlr_drm_connector *conn;
 		wl_list_for_each(conn, &drm->outputs, link){
 			if (conn->output.enabled && conn->output.current_mode != NULL) {
@@ -106,7 +111,7 @@ static void session_signal(struct wl_listener *listener, void *data) {
 
 			struct wlr_drm_plane *plane = conn->crtc->cursor;
 			drm->iface->crtc_set_cursor(drm, conn->crtc,
-				(plane && plane->cursor_enabled) ? plane->surf.back : NULL);
+				(plane && plane->cursor_enabled) ? plane->cursor_bo : NULL);
 			drm->iface->crtc_move_cursor(drm, conn->crtc, conn->cursor_x,
 				conn->cursor_y);
 
@@ -26,6 +26,7 @@
 #include "backend/drm/cvt.h"
 #include "backend/drm/drm.h"
 #include "backend/drm/iface.h"
+#include "backend/drm/overlay.h"
 #include "backend/drm/util.h"
 #include "util/signal.h"
 
@@ -155,6 +156,16 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	case DRM_PLANE_TYPE_CURSOR:
 		crtc->cursor = p;
 		break;
+	case DRM_PLANE_TYPE_OVERLAY:;
+		struct wlr_drm_plane **overlays = realloc(crtc->overlays,
+			sizeof(*crtc->overlays) * (crtc->num_overlays + 1));
+		if (overlays == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			goto error;
+		}
+		crtc->overlays = overlays;
+		crtc->overlays[crtc->num_overlays++] = p;
+		break;
 	default:
 		abort();
 	}
@@ -162,6 +173,7 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	return true;
 
 error:
+	wlr_drm_format_set_finish(&p->formats);
 	free(p);
 	return false;
 }
@@ -201,11 +213,8 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 		 * logic. Primary and cursor planes should only work on a
 		 * single CRTC, and this should be perfectly adequate, but
 		 * overlay planes can potentially work with multiple CRTCs,
-		 * meaning this could return inefficient/skewed results.
-		 *
-		 * However, we don't really care about overlay planes, as we
-		 * don't support them yet. We only bother to keep basic
-		 * tracking of them for DRM lease clients.
+		 * meaning this could return inefficient/skewed results: overlay
+		 * planes are only used with the first CRTC they support.
 		 *
 		 * possible_crtcs is a bitmask of crtcs, where each bit is an
 		 * index into drmModeRes.crtcs. So if bit 0 is set (ffs starts
@@ -218,17 +227,6 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 
 		struct wlr_drm_crtc *crtc = &drm->crtcs[crtc_bit];
 
-		if (type == DRM_PLANE_TYPE_OVERLAY) {
-			uint32_t *tmp = realloc(crtc->overlays,
-				sizeof(*crtc->overlays) * (crtc->num_overlays + 1));
-			if (tmp) {
-				crtc->overlays = tmp;
-				crtc->overlays[crtc->num_overlays++] = id;
-			}
-			drmModeFreePlane(plane);
-			continue;
-		}
-
 		if (!add_plane(drm, crtc, plane, type, &props)) {
 			drmModeFreePlane(plane);
 			goto error;
@@ -316,6 +314,12 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 			wlr_drm_format_set_finish(&crtc->cursor->formats);
 			free(crtc->cursor);
 		}
+		for (size_t j = 0; j < crtc->num_overlays; ++j) {
+			struct wlr_drm_plane *plane = crtc->overlays[j];
+			drm_plane_release_overlay(plane);
+			wlr_drm_format_set_finish(&plane->formats);
+			free(plane);
+		}
 		free(crtc->overlays);
 	}
 
@@ -382,7 +386,7 @@ static bool test_buffer(struct wlr_drm_connector *conn,
 	return true;
 }
 
-static bool drm_connector_test(struct wlr_output *output) {
+static bool drm_connector_test_buffer(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 
 	if ((output->pending.committed & WLR_OUTPUT_STATE_BUFFER) &&
@@ -395,6 +399,22 @@ static bool drm_connector_test(struct wlr_output *output) {
 	return true;
 }
 
+static bool drm_connector_test(struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+
+	if (!drm_connector_test_buffer(output)) {
+		return false;
+	}
+
+	if (output->pending.committed & WLR_OUTPUT_STATE_OVERLAYS) {
+		struct wlr_drm_backend *drm =
+			get_drm_backend_from_backend(output->backend);
+		drm_connector_test_overlays(drm, conn);
+	}
+
+	return true;
+}
+
 static bool drm_connector_commit_buffer(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
@@ -464,7 +484,10 @@ static bool drm_connector_commit_buffer(struct wlr_output *output) {
 		return false;
 	}
 
-	if (!drm->iface->crtc_pageflip(drm, conn, crtc, fb_id, NULL)) {
+	bool update_overlays =
+		output->pending.committed & WLR_OUTPUT_STATE_OVERLAYS;
+	if (!drm_connector_pageflip_overlays(drm, conn, fb_id,
+			update_overlays)) {
 		return false;
 	}
 
@@ -521,7 +544,7 @@ static bool drm_connector_set_custom_mode(struct wlr_output *output,
 static bool drm_connector_commit(struct wlr_output *output) {
 	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
 
-	if (!drm_connector_test(output)) {
+	if (!drm_connector_test_buffer(output)) {
 		return false;
 	}
 
@@ -902,6 +925,101 @@ struct wlr_output_mode *wlr_drm_connector_add_mode(struct wlr_output *output,
 	return &mode->wlr_mode;
 }
 
+static bool init_cursor_surface(struct wlr_drm_backend *drm,
+		struct wlr_drm_surface *surf, uint32_t width, uint32_t height) {
+	if (!drm->parent) {
+		return init_drm_surface(surf, &drm->renderer, width, height,
+			drm->renderer.gbm_format, NULL,
+			GBM_BO_USE_LINEAR | GBM_BO_USE_SCANOUT);
+	} else {
+		return init_drm_surface(surf, &drm->parent->renderer, width, height,
+			drm->parent->renderer.gbm_format, NULL, GBM_BO_USE_LINEAR);
+	}
+}
+
+static void finish_cursor_image(struct wlr_drm_cursor_image *image) {
+	if (image->texture != NULL) {
+		wlr_renderer_cursor_texture_unref(image->surf.renderer->wlr_rend,
+			image->texture);
+		image->texture = NULL;
+	}
+	finish_drm_surface(&image->surf);
+}
+
+static void finish_cursor_plane(struct wlr_drm_plane *plane) {
+	if (plane == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < DRM_CURSOR_IMAGE_CACHE_SIZE; i++) {
+		finish_cursor_image(&plane->cursor_images[i]);
+	}
+	plane->cursor_bo = NULL;
+	finish_drm_surface(&plane->surf);
+}
+
+/**
+ * Look up a cursor image holding the texture rendered with the same
+ * parameters. If there is none, the least recently used slot is assigned to
+ * the texture and *rendered is set to false. Returns NULL if the texture
+ * can't be cached, e.g. because it comes from a client surface whose
+ * contents may change.
+ */
+static struct wlr_drm_cursor_image *get_cursor_image(
+		struct wlr_drm_backend *drm, struct wlr_drm_plane *plane,
+		struct wlr_texture *texture, float scale, struct wlr_output *output,
+		enum wl_output_transform transform, bool *rendered) {
+	struct wlr_renderer *rend = plane->surf.renderer->wlr_rend;
+	if (!wlr_renderer_cursor_texture_ref(rend, texture)) {
+		*rendered = false;
+		return NULL;
+	}
+
+	struct wlr_drm_cursor_image *image = NULL, *lru = NULL;
+	for (size_t i = 0; i < DRM_CURSOR_IMAGE_CACHE_SIZE; i++) {
+		struct wlr_drm_cursor_image *slot = &plane->cursor_images[i];
+		if (slot->texture == texture && slot->scale == scale &&
+				slot->output_scale == output->scale &&
+				slot->transform == transform &&
+				slot->output_transform == output->transform &&
+				slot->surf.back != NULL) {
+			image = slot;
+			break;
+		}
+		if (lru == NULL || slot->last_used < lru->last_used) {
+			lru = slot;
+		}
+	}
+
+	if (image != NULL) {
+		// The slot already holds a reference
+		wlr_renderer_cursor_texture_unref(rend, texture);
+		plane->cursor_image_stats.hits++;
+		*rendered = true;
+	} else {
+		plane->cursor_image_stats.misses++;
+		image = lru;
+		if (image->texture != NULL) {
+			wlr_renderer_cursor_texture_unref(rend, image->texture);
+			image->texture = NULL;
+		}
+		if (!image->surf.gbm && !init_cursor_surface(drm, &image->surf,
+				plane->surf.width, plane->surf.height)) {
+			wlr_renderer_cursor_texture_unref(rend, texture);
+			*rendered = false;
+			return NULL;
+		}
+		image->texture = texture;
+		image->scale = scale;
+		image->output_scale = output->scale;
+		image->transform = transform;
+		image->output_transform = output->transform;
+		*rendered = false;
+	}
+
+	image->last_used = ++plane->cursor_images_seq;
+	return image;
+}
+
 static bool drm_connector_set_cursor(struct wlr_output *output,
 		struct wlr_texture *texture, float scale,
 		enum wl_output_transform transform,
@@ -933,21 +1051,12 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 		ret = drmGetCap(drm->fd, DRM_CAP_CURSOR_HEIGHT, &h);
 		h = ret ? 64 : h;
 
-		if (!drm->parent) {
-			if (!init_drm_surface(&plane->surf, &drm->renderer, w, h,
-					drm->renderer.gbm_format, NULL,
-					GBM_BO_USE_LINEAR | GBM_BO_USE_SCANOUT)) {
-				wlr_log(WLR_ERROR, "Cannot allocate cursor resources");
-				return false;
-			}
-		} else {
-			if (!init_drm_surface(&plane->surf, &drm->parent->renderer, w, h,
-					drm->parent->renderer.gbm_format, NULL,
-					GBM_BO_USE_LINEAR)) {
-				wlr_log(WLR_ERROR, "Cannot allocate cursor resources");
-				return false;
-			}
+		if (!init_cursor_surface(drm, &plane->surf, w, h)) {
+			wlr_log(WLR_ERROR, "Cannot allocate cursor resources");
+			return false;
+		}
 
+		if (drm->parent) {
 			if (!init_drm_surface(&plane->mgpu_surf, &drm->renderer, w, h,
 					drm->renderer.gbm_format, NULL,
 					GBM_BO_USE_LINEAR | GBM_BO_USE_SCANOUT)) {
@@ -987,6 +1096,7 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 	}
 
 	plane->cursor_enabled = false;
+	plane->cursor_bo = NULL;
 	if (texture != NULL) {
 		int width, height;
 		wlr_texture_get_size(texture, &width, &height);
@@ -999,30 +1109,40 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 			return false;
 		}
 
-		make_drm_surface_current(&plane->surf, NULL);
-
 		struct wlr_renderer *rend = plane->surf.renderer->wlr_rend;
 
-		struct wlr_box cursor_box = { .width = width, .height = height };
+		bool rendered = false;
+		struct wlr_drm_cursor_image *image = get_cursor_image(drm, plane,
+			texture, scale, output, transform, &rendered);
+		struct wlr_drm_surface *surf = image ? &image->surf : &plane->surf;
+
+		if (rendered) {
+			plane->cursor_bo = surf->back;
+		} else {
+			make_drm_surface_current(surf, NULL);
+
+			struct wlr_box cursor_box = { .width = width, .height = height };
 
-		float matrix[9];
-		wlr_matrix_project_box(matrix, &cursor_box, transform, 0, plane->matrix);
+			float matrix[9];
+			wlr_matrix_project_box(matrix, &cursor_box, transform, 0,
+				plane->matrix);
 
-		wlr_renderer_begin(rend, plane->surf.width, plane->surf.height);
-		wlr_renderer_clear(rend, (float[]){ 0.0, 0.0, 0.0, 0.0 });
-		wlr_render_texture_with_matrix(rend, texture, matrix, 1.0);
-		wlr_renderer_end(rend);
+			wlr_renderer_begin(rend, surf->width, surf->height);
+			wlr_renderer_clear(rend, (float[]){ 0.0, 0.0, 0.0, 0.0 });
+			wlr_render_texture_with_matrix(rend, texture, matrix, 1.0);
+			wlr_renderer_end(rend);
 
-		swap_drm_surface_buffers(&plane->surf, NULL);
+			plane->cursor_bo = swap_drm_surface_buffers(surf, NULL);
+		}
 
-		plane->cursor_enabled = true;
+		plane->cursor_enabled = plane->cursor_bo != NULL;
 	}
 
 	if (!drm->session->active) {
 		return true; // will be committed when session is resumed
 	}
 
-	struct gbm_bo *bo = plane->cursor_enabled ? plane->surf.back : NULL;
+	struct gbm_bo *bo = plane->cursor_enabled ? plane->cursor_bo : NULL;
 	if (bo && drm->parent) {
 		bo = copy_drm_surface_mgpu(&plane->mgpu_surf, bo);
 	}
@@ -1134,7 +1254,7 @@ static void dealloc_crtc(struct wlr_drm_connector *conn) {
 
 	set_drm_connector_gamma(&conn->output, 0, NULL, NULL, NULL);
 	finish_drm_surface(&conn->crtc->primary->surf);
-	finish_drm_surface(&conn->crtc->cursor->surf);
+	finish_cursor_plane(conn->crtc->cursor);
 
 	drm->iface->conn_enable(drm, conn, false);
 
@@ -1576,6 +1696,22 @@ static void page_flip_handler(int fd, unsigned seq,
 	conn->current_bo = conn->pending_bo;
 	conn->pending_bo = NULL;
 
+	for (size_t i = 0; i < conn->crtc->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = conn->crtc->overlays[i];
+		if (!plane->overlay.flip_pending) {
+			continue;
+		}
+		wlr_buffer_unlock(plane->overlay.current_buffer);
+		plane->overlay.current_buffer = plane->overlay.pending_buffer;
+		plane->overlay.pending_buffer = NULL;
+		if (plane->overlay.current_bo != NULL) {
+			gbm_bo_destroy(plane->overlay.current_bo);
+		}
+		plane->overlay.current_bo = plane->overlay.pending_bo;
+		plane->overlay.pending_bo = NULL;
+		plane->overlay.flip_pending = false;
+	}
+
 	uint32_t present_flags = WLR_OUTPUT_PRESENT_VSYNC |
 		WLR_OUTPUT_PRESENT_HW_CLOCK | WLR_OUTPUT_PRESENT_HW_COMPLETION;
 	if (conn->current_buffer != NULL) {
@@ -1691,6 +1827,13 @@ static void drm_connector_cleanup(struct wlr_drm_connector *conn) {
 		wlr_buffer_unlock(conn->current_buffer);
 		conn->pending_buffer = conn->current_buffer = NULL;
 
+		if (conn->crtc != NULL) {
+			for (size_t i = 0; i < conn->crtc->num_overlays; ++i) {
+				drm_plane_release_overlay(conn->crtc->overlays[i]);
+			}
+			conn->crtc->overlays_changed = true;
+		}
+
 		/* Fallthrough */
 	case WLR_DRM_CONN_NEEDS_MODESET:
 		wlr_log(WLR_INFO, "Emitting destruction signal for '%s'",
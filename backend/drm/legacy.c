@@ -79,6 +79,18 @@ static size_t legacy_crtc_get_gamma_size(struct wlr_drm_backend *drm,
 	return (size_t)crtc->legacy_crtc->gamma_size;
 }
 
+static bool legacy_crtc_test_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc) {
+	// drmModeSetPlane isn't synchronized with page-flips, so overlay planes
+	// are only used with the atomic interface
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		if (crtc->overlays[i]->overlay.fb_id != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
 const struct wlr_drm_interface legacy_iface = {
 	.conn_enable = legacy_conn_enable,
 	.crtc_pageflip = legacy_crtc_pageflip,
@@ -86,4 +98,5 @@ const struct wlr_drm_interface legacy_iface = {
 	.crtc_move_cursor = legacy_crtc_move_cursor,
 	.crtc_set_gamma = legacy_crtc_set_gamma,
 	.crtc_get_gamma_size = legacy_crtc_get_gamma_size,
+	.crtc_test_overlays = legacy_crtc_test_overlays,
 };
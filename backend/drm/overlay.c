@@ -0,0 +1,276 @@
+#include <gbm.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "backend/drm/drm.h"
+#include "backend/drm/iface.h"
+#include "backend/drm/overlay.h"
+#include "backend/drm/renderer.h"
+#include "backend/drm/util.h"
+
+struct drm_overlay_plane_state {
+	uint32_t fb_id;
+	struct wlr_box box;
+};
+
+struct drm_overlay_assignment {
+	struct wlr_output_overlay *overlay;
+	struct wlr_drm_plane *plane;
+	struct gbm_bo *bo;
+	uint32_t fb_id;
+};
+
+struct drm_overlay_config {
+	struct drm_overlay_assignment *assignments;
+	size_t n;
+	// Overlay planes' state before the configuration was staged
+	struct drm_overlay_plane_state *saved;
+};
+
+void drm_plane_release_overlay(struct wlr_drm_plane *plane) {
+	wlr_buffer_unlock(plane->overlay.pending_buffer);
+	wlr_buffer_unlock(plane->overlay.current_buffer);
+	if (plane->overlay.pending_bo != NULL) {
+		gbm_bo_destroy(plane->overlay.pending_bo);
+	}
+	if (plane->overlay.current_bo != NULL) {
+		gbm_bo_destroy(plane->overlay.current_bo);
+	}
+	memset(&plane->overlay, 0, sizeof(plane->overlay));
+}
+
+/**
+ * Assign overlay planes to the output's overlays, top-most first. Overlays
+ * left out are rendered by the compositor into the primary plane, which is
+ * below all overlay planes: to preserve the stacking order, only a top-most
+ * run of overlays can be assigned planes. Overlay planes are assumed to be
+ * stacked in the order the kernel lists them.
+ *
+ * Returns the number of assignments, from top to bottom.
+ */
+static size_t assign_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn,
+		struct drm_overlay_assignment *assignments) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	size_t n = 0;
+	size_t next_plane = crtc->num_overlays;
+	struct wlr_output_overlay *overlay;
+	wl_list_for_each_reverse(overlay, &conn->output.overlays, link) {
+		struct wlr_buffer *buffer = overlay->buffer;
+		if (buffer == NULL) {
+			continue;
+		}
+
+		// Scaling isn't supported
+		if (overlay->dst_box.width != buffer->width ||
+				overlay->dst_box.height != buffer->height) {
+			break;
+		}
+
+		struct wlr_dmabuf_attributes attribs;
+		if (!wlr_buffer_get_dmabuf(buffer, &attribs) || attribs.flags != 0) {
+			break;
+		}
+
+		struct wlr_drm_plane *plane = NULL;
+		while (next_plane > 0) {
+			struct wlr_drm_plane *p = crtc->overlays[--next_plane];
+			if (wlr_drm_format_set_has(&p->formats, attribs.format,
+					attribs.modifier)) {
+				plane = p;
+				break;
+			}
+		}
+		if (plane == NULL) {
+			break;
+		}
+
+		struct gbm_bo *bo = import_gbm_bo(&drm->renderer, &attribs);
+		if (bo == NULL) {
+			break;
+		}
+		uint32_t fb_id =
+			get_fb_for_bo(bo, gbm_bo_get_format(bo), drm->addfb2_modifiers);
+		if (fb_id == 0) {
+			gbm_bo_destroy(bo);
+			break;
+		}
+
+		assignments[n++] = (struct drm_overlay_assignment){
+			.overlay = overlay,
+			.plane = plane,
+			.bo = bo,
+			.fb_id = fb_id,
+		};
+	}
+
+	return n;
+}
+
+static void crtc_stage_overlays(struct wlr_drm_crtc *crtc,
+		const struct drm_overlay_assignment *assignments, size_t n) {
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		crtc->overlays[i]->overlay.fb_id = 0;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		struct wlr_drm_plane *plane = assignments[i].plane;
+		plane->overlay.fb_id = assignments[i].fb_id;
+		plane->overlay.box = assignments[i].overlay->dst_box;
+	}
+}
+
+/**
+ * Put the output's overlays on overlay planes, and stage the configuration
+ * the kernel accepts in the CRTC's overlay planes. Bottom-most overlays are
+ * given up on until the kernel accepts the configuration. The configuration
+ * must be released with finish_overlays.
+ */
+static bool prepare_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, struct drm_overlay_config *config) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	if (crtc == NULL || crtc->num_overlays == 0 || !drm->session->active) {
+		return false;
+	}
+
+	config->assignments =
+		calloc(crtc->num_overlays, sizeof(struct drm_overlay_assignment));
+	config->saved =
+		calloc(crtc->num_overlays, sizeof(struct drm_overlay_plane_state));
+	if (config->assignments == NULL || config->saved == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(config->assignments);
+		free(config->saved);
+		return false;
+	}
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		config->saved[i].fb_id = crtc->overlays[i]->overlay.fb_id;
+		config->saved[i].box = crtc->overlays[i]->overlay.box;
+	}
+
+	struct drm_overlay_assignment *assignments = config->assignments;
+	size_t n = assign_overlays(drm, conn, assignments);
+	while (n > 0) {
+		crtc_stage_overlays(crtc, assignments, n);
+		if (drm->iface->crtc_test_overlays(drm, crtc)) {
+			break;
+		}
+		--n;
+		gbm_bo_destroy(assignments[n].bo);
+	}
+	crtc_stage_overlays(crtc, assignments, n);
+	config->n = n;
+
+	return true;
+}
+
+/**
+ * Give up on all overlay planes of a staged configuration.
+ */
+static void drop_overlays(struct wlr_drm_crtc *crtc,
+		struct drm_overlay_config *config) {
+	for (size_t i = 0; i < config->n; ++i) {
+		gbm_bo_destroy(config->assignments[i].bo);
+	}
+	config->n = 0;
+	crtc_stage_overlays(crtc, config->assignments, 0);
+}
+
+/**
+ * Release a configuration staged by prepare_overlays. If `apply` is set, the
+ * overlays are marked as accepted and their buffers are kept until they're
+ * replaced on screen. Otherwise the overlay planes' state is rolled back.
+ */
+static void finish_overlays(struct wlr_drm_crtc *crtc,
+		struct drm_overlay_config *config, bool apply) {
+	struct drm_overlay_assignment *assignments = config->assignments;
+
+	if (!apply) {
+		for (size_t i = 0; i < crtc->num_overlays; ++i) {
+			crtc->overlays[i]->overlay.fb_id = config->saved[i].fb_id;
+			crtc->overlays[i]->overlay.box = config->saved[i].box;
+		}
+		for (size_t i = 0; i < config->n; ++i) {
+			gbm_bo_destroy(assignments[i].bo);
+		}
+		free(assignments);
+		free(config->saved);
+		return;
+	}
+
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = crtc->overlays[i];
+		wlr_buffer_unlock(plane->overlay.pending_buffer);
+		plane->overlay.pending_buffer = NULL;
+		if (plane->overlay.pending_bo != NULL) {
+			gbm_bo_destroy(plane->overlay.pending_bo);
+			plane->overlay.pending_bo = NULL;
+		}
+		// Planes left unused release their buffer on page-flip too
+		plane->overlay.flip_pending = true;
+	}
+	for (size_t i = 0; i < config->n; ++i) {
+		struct wlr_drm_plane *plane = assignments[i].plane;
+		plane->overlay.pending_bo = assignments[i].bo;
+		plane->overlay.pending_buffer =
+			wlr_buffer_lock(assignments[i].overlay->buffer);
+		assignments[i].overlay->accepted = true;
+	}
+
+	free(assignments);
+	free(config->saved);
+}
+
+void drm_connector_test_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn) {
+	struct drm_overlay_config config = {0};
+	if (!prepare_overlays(drm, conn, &config)) {
+		return;
+	}
+
+	// Tests must not clobber the configuration of the next page-flip
+	for (size_t i = 0; i < config.n; ++i) {
+		config.assignments[i].overlay->accepted = true;
+	}
+	finish_overlays(conn->crtc, &config, false);
+}
+
+bool drm_connector_pageflip_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, uint32_t fb_id, bool update_overlays) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	struct drm_overlay_config config = {0};
+	bool prepared = update_overlays && prepare_overlays(drm, conn, &config);
+	bool overlays_changed = crtc->overlays_changed;
+	if (prepared) {
+		crtc->overlays_changed = true;
+	}
+
+	bool ok = drm->iface->crtc_pageflip(drm, conn, crtc, fb_id, NULL);
+	if (!ok && prepared && config.n > 0) {
+		// The TEST_ONLY commit doesn't include the primary plane, the
+		// combination may still be rejected
+		wlr_log(WLR_DEBUG, "Page-flip with overlays failed on output '%s', "
+			"retrying without overlays", conn->output.name);
+		drop_overlays(crtc, &config);
+		ok = drm->iface->crtc_pageflip(drm, conn, crtc, fb_id, NULL);
+	}
+
+	if (!ok) {
+		if (prepared) {
+			finish_overlays(crtc, &config, false);
+			crtc->overlays_changed = overlays_changed;
+		}
+		return false;
+	}
+
+	if (prepared) {
+		finish_overlays(crtc, &config, true);
+	}
+	crtc->overlays_changed = false;
+	return true;
+}
@@ -60,8 +60,10 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, backend);
 
-	wlr_renderer_destroy(backend->renderer);
-	wlr_egl_finish(&backend->egl);
+	if (!backend->software) {
+		wlr_renderer_destroy(backend->renderer);
+		wlr_egl_finish(&backend->egl);
+	}
 	free(backend);
 }
 
@@ -128,6 +130,29 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display,
 	return &backend->backend;
 }
 
+struct wlr_backend *wlr_headless_backend_create_with_renderer(
+		struct wl_display *display, struct wlr_renderer *renderer) {
+	wlr_log(WLR_INFO, "Creating headless backend with software framebuffers");
+
+	struct wlr_headless_backend *backend =
+		calloc(1, sizeof(struct wlr_headless_backend));
+	if (!backend) {
+		wlr_log(WLR_ERROR, "Failed to allocate wlr_headless_backend");
+		return NULL;
+	}
+	wlr_backend_init(&backend->backend, &backend_impl);
+	backend->display = display;
+	backend->renderer = renderer;
+	backend->software = true;
+	wl_list_init(&backend->outputs);
+	wl_list_init(&backend->input_devices);
+
+	backend->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &backend->display_destroy);
+
+	return &backend->backend;
+}
+
 bool wlr_backend_is_headless(struct wlr_backend *backend) {
 	return backend->impl == &backend_impl;
 }
@@ -1,11 +1,17 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
+#include "util/shm.h"
 #include "util/signal.h"
 
+#define HEADLESS_FB_FORMAT WL_SHM_FORMAT_XRGB8888
+
 static struct wlr_headless_output *headless_output_from_output(
 		struct wlr_output *wlr_output) {
 	assert(wlr_output_is_headless(wlr_output));
@@ -24,6 +30,51 @@ static EGLSurface egl_create_surface(struct wlr_egl *egl, unsigned int width,
 	return surf;
 }
 
+static void output_finish_framebuffer(struct wlr_headless_output *output) {
+	if (output->fb_data != MAP_FAILED) {
+		munmap(output->fb_data, output->fb_size);
+		output->fb_data = MAP_FAILED;
+	}
+	if (output->fb_fd >= 0) {
+		close(output->fb_fd);
+		output->fb_fd = -1;
+	}
+}
+
+static bool output_init_framebuffer(struct wlr_headless_output *output,
+		unsigned int width, unsigned int height) {
+	uint32_t stride = width * 4;
+	size_t size = (size_t)stride * height;
+	if (output->fb_data != MAP_FAILED && output->fb_stride == stride &&
+			output->fb_size == size) {
+		return true;
+	}
+
+	output_finish_framebuffer(output);
+
+	int fd = allocate_shm_file(size);
+	if (fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to allocate framebuffer");
+		return false;
+	}
+
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "mmap failed");
+		close(fd);
+		return false;
+	}
+
+	// Same initial contents as EGL outputs
+	memset(data, 0xFF, size);
+
+	output->fb_fd = fd;
+	output->fb_data = data;
+	output->fb_stride = stride;
+	output->fb_size = size;
+	return true;
+}
+
 static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		int32_t height, int32_t refresh) {
 	struct wlr_headless_output *output =
@@ -34,13 +85,21 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		refresh = HEADLESS_DEFAULT_REFRESH;
 	}
 
-	wlr_egl_destroy_surface(&backend->egl, output->egl_surface);
+	if (backend->software) {
+		if (!output_init_framebuffer(output, width, height)) {
+			wlr_log(WLR_ERROR, "Failed to recreate framebuffer");
+			wlr_output_destroy(wlr_output);
+			return false;
+		}
+	} else {
+		wlr_egl_destroy_surface(&backend->egl, output->egl_surface);
 
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
-	if (output->egl_surface == EGL_NO_SURFACE) {
-		wlr_log(WLR_ERROR, "Failed to recreate EGL surface");
-		wlr_output_destroy(wlr_output);
-		return false;
+		output->egl_surface = egl_create_surface(&backend->egl, width, height);
+		if (output->egl_surface == EGL_NO_SURFACE) {
+			wlr_log(WLR_ERROR, "Failed to recreate EGL surface");
+			wlr_output_destroy(wlr_output);
+			return false;
+		}
 	}
 
 	output->frame_delay = 1000000 / refresh;
@@ -53,10 +112,36 @@ static bool output_attach_render(struct wlr_output *wlr_output,
 		int *buffer_age) {
 	struct wlr_headless_output *output =
 		headless_output_from_output(wlr_output);
-	return wlr_egl_make_current(&output->backend->egl, output->egl_surface,
+	struct wlr_headless_backend *backend = output->backend;
+
+	if (backend->software) {
+		if (!wlr_renderer_bind_pixels(backend->renderer, HEADLESS_FB_FORMAT,
+				output->fb_stride, wlr_output->width, wlr_output->height,
+				output->fb_data)) {
+			wlr_log(WLR_ERROR, "Renderer doesn't support software framebuffers");
+			return false;
+		}
+		// There is a single framebuffer, its contents are always preserved
+		if (buffer_age != NULL) {
+			*buffer_age = 1;
+		}
+		return true;
+	}
+
+	return wlr_egl_make_current(&backend->egl, output->egl_surface,
 		buffer_age);
 }
 
+static void output_unbind(struct wlr_headless_output *output) {
+	struct wlr_headless_backend *backend = output->backend;
+	if (backend->software) {
+		wlr_renderer_bind_pixels(backend->renderer, HEADLESS_FB_FORMAT,
+			0, 0, 0, NULL);
+	} else {
+		wlr_egl_make_current(&backend->egl, EGL_NO_SURFACE, NULL);
+	}
+}
+
 static bool output_test(struct wlr_output *wlr_output) {
 	if (wlr_output->pending.committed & WLR_OUTPUT_STATE_ENABLED) {
 		wlr_log(WLR_DEBUG, "Cannot disable a headless output");
@@ -88,11 +173,11 @@ static bool output_commit(struct wlr_output *wlr_output) {
 	}
 
 	if (wlr_output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
-		// Nothing needs to be done for pbuffers
+		// Nothing needs to be done for pbuffers and software framebuffers
 		wlr_output_send_present(wlr_output, NULL);
 	}
 
-	wlr_egl_make_current(&output->backend->egl, EGL_NO_SURFACE, NULL);
+	output_unbind(output);
 
 	return true;
 }
@@ -100,7 +185,7 @@ static bool output_commit(struct wlr_output *wlr_output) {
 static void output_rollback(struct wlr_output *wlr_output) {
 	struct wlr_headless_output *output =
 		headless_output_from_output(wlr_output);
-	wlr_egl_make_current(&output->backend->egl, EGL_NO_SURFACE, NULL);
+	output_unbind(output);
 }
 
 static void output_destroy(struct wlr_output *wlr_output) {
@@ -111,7 +196,11 @@ static void output_destroy(struct wlr_output *wlr_output) {
 
 	wl_event_source_remove(output->frame_timer);
 
-	wlr_egl_destroy_surface(&output->backend->egl, output->egl_surface);
+	if (output->backend->software) {
+		output_finish_framebuffer(output);
+	} else {
+		wlr_egl_destroy_surface(&output->backend->egl, output->egl_surface);
+	}
 	free(output);
 }
 
@@ -145,14 +234,22 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+	output->fb_fd = -1;
+	output->fb_data = MAP_FAILED;
 	wlr_output_init(&output->wlr_output, &backend->backend, &output_impl,
 		backend->display);
 	struct wlr_output *wlr_output = &output->wlr_output;
 
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
-	if (output->egl_surface == EGL_NO_SURFACE) {
-		wlr_log(WLR_ERROR, "Failed to create EGL surface");
-		goto error;
+	if (backend->software) {
+		if (!output_init_framebuffer(output, width, height)) {
+			goto error;
+		}
+	} else {
+		output->egl_surface = egl_create_surface(&backend->egl, width, height);
+		if (output->egl_surface == EGL_NO_SURFACE) {
+			wlr_log(WLR_ERROR, "Failed to create EGL surface");
+			goto error;
+		}
 	}
 
 	output_set_custom_mode(wlr_output, width, height, 0);
@@ -166,14 +263,17 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		"Headless output %zd", backend->last_output_num);
 	wlr_output_set_description(wlr_output, description);
 
-	if (!wlr_egl_make_current(&output->backend->egl, output->egl_surface,
-			NULL)) {
-		goto error;
-	}
+	if (!backend->software) {
+		if (!wlr_egl_make_current(&output->backend->egl, output->egl_surface,
+				NULL)) {
+			goto error;
+		}
 
-	wlr_renderer_begin(backend->renderer, wlr_output->width, wlr_output->height);
-	wlr_renderer_clear(backend->renderer, (float[]){ 1.0, 1.0, 1.0, 1.0 });
-	wlr_renderer_end(backend->renderer);
+		wlr_renderer_begin(backend->renderer, wlr_output->width,
+			wlr_output->height);
+		wlr_renderer_clear(backend->renderer, (float[]){ 1.0, 1.0, 1.0, 1.0 });
+		wlr_renderer_end(backend->renderer);
+	}
 
 	struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
 	output->frame_timer = wl_event_loop_add_timer(ev, signal_frame, output);
@@ -0,0 +1,274 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "backend/replay.h"
+#include "util/signal.h"
+
+// Maximum number of events emitted in one event loop iteration, so that the
+// compositor gets a chance to process clients when replay is behind schedule
+#define REPLAY_EVENT_BUDGET 256
+
+struct wlr_replay_backend *replay_backend_from_backend(
+		struct wlr_backend *wlr_backend) {
+	assert(wlr_backend_is_replay(wlr_backend));
+	return (struct wlr_replay_backend *)wlr_backend;
+}
+
+static uint64_t get_elapsed_nsec(struct wlr_replay_backend *backend) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)(now.tv_sec - backend->start.tv_sec) * 1000000000 +
+		(now.tv_nsec - backend->start.tv_nsec);
+}
+
+/**
+ * Move the time of an input event from the recording's clock to the current
+ * one, keeping the intervals between events.
+ */
+static void rebase_event_time(struct wlr_replay_backend *backend,
+		const struct input_trace_record *record, void *payload) {
+	if (record->type == INPUT_TRACE_DEVICE_ADD ||
+			record->type == INPUT_TRACE_TOOL_ADD ||
+			record->size < sizeof(uint32_t)) {
+		return;
+	}
+
+	uint32_t time_msec;
+	memcpy(&time_msec, payload, sizeof(time_msec));
+	if (!backend->time_offset_set) {
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		uint32_t now_msec = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+		backend->time_offset_msec = now_msec - time_msec;
+		backend->time_offset_set = true;
+	}
+	time_msec += backend->time_offset_msec;
+	memcpy(payload, &time_msec, sizeof(time_msec));
+}
+
+/**
+ * Apply all records due at the current time, then arm the timer for the next
+ * one.
+ */
+static void replay_dispatch(struct wlr_replay_backend *backend) {
+	uint64_t now = get_elapsed_nsec(backend);
+
+	size_t n = 0;
+	while (backend->offset < backend->trace_size) {
+		// Records aren't aligned in the trace
+		struct input_trace_record record;
+		memcpy(&record, backend->trace + backend->offset, sizeof(record));
+
+		uint64_t due = 0;
+		if (backend->speed > 0) {
+			due = record.time_nsec / backend->speed;
+		}
+		if (due > now) {
+			uint64_t delay_msec = (due - now + 999999) / 1000000;
+			wl_event_source_timer_update(backend->timer, delay_msec);
+			return;
+		}
+		if (n == REPLAY_EVENT_BUDGET) {
+			wl_event_source_timer_update(backend->timer, 1);
+			return;
+		}
+
+		uint64_t payload[32];
+		assert(record.size <= sizeof(payload));
+		memcpy(payload, backend->trace + backend->offset + sizeof(record),
+			record.size);
+		backend->offset += sizeof(record) + record.size;
+
+		uint64_t lag = now - due;
+		backend->stats.total_lag_nsec += lag;
+		if (lag > backend->stats.max_lag_nsec) {
+			backend->stats.max_lag_nsec = lag;
+		}
+
+		rebase_event_time(backend, &record, payload);
+		replay_apply_record(backend, &record, payload);
+		n++;
+	}
+
+	backend->stats.finished = true;
+	wlr_log(WLR_INFO, "Replayed %"PRIu64" input events, max lag %"PRIu64" us",
+		backend->stats.events, backend->stats.max_lag_nsec / 1000);
+}
+
+static int handle_timer(void *data) {
+	struct wlr_replay_backend *backend = data;
+	replay_dispatch(backend);
+	return 0;
+}
+
+static bool backend_start(struct wlr_backend *wlr_backend) {
+	struct wlr_replay_backend *backend =
+		replay_backend_from_backend(wlr_backend);
+	wlr_log(WLR_INFO, "Starting replay backend");
+
+	backend->started = true;
+	clock_gettime(CLOCK_MONOTONIC, &backend->start);
+	// Creates the devices present when the recording started
+	replay_dispatch(backend);
+	return true;
+}
+
+static void backend_destroy(struct wlr_backend *wlr_backend) {
+	if (!wlr_backend) {
+		return;
+	}
+
+	struct wlr_replay_backend *backend =
+		replay_backend_from_backend(wlr_backend);
+
+	wl_list_remove(&backend->display_destroy.link);
+	wl_event_source_remove(backend->timer);
+
+	replay_destroy_input_devices(backend);
+
+	wlr_signal_emit_safe(&wlr_backend->events.destroy, backend);
+
+	free(backend->trace);
+	free(backend);
+}
+
+static const struct wlr_backend_impl backend_impl = {
+	.start = backend_start,
+	.destroy = backend_destroy,
+};
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_replay_backend *backend =
+		wl_container_of(listener, backend, display_destroy);
+	backend_destroy(&backend->backend);
+}
+
+static uint8_t *read_trace(const char *path, size_t *size) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to open input trace %s", path);
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to stat input trace %s", path);
+		close(fd);
+		return NULL;
+	}
+
+	uint8_t *data = malloc(st.st_size > 0 ? st.st_size : 1);
+	if (data == NULL) {
+		close(fd);
+		return NULL;
+	}
+
+	size_t n = 0;
+	while (n < (size_t)st.st_size) {
+		ssize_t ret = read(fd, data + n, st.st_size - n);
+		if (ret <= 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to read input trace %s", path);
+			free(data);
+			close(fd);
+			return NULL;
+		}
+		n += ret;
+	}
+
+	close(fd);
+	*size = n;
+	return data;
+}
+
+/**
+ * Check that the trace is well-formed, so that replaying it doesn't need to.
+ */
+static bool validate_trace(const uint8_t *data, size_t size) {
+	const struct input_trace_header *header = (const void *)data;
+	if (size < sizeof(*header) ||
+			memcmp(header->magic, INPUT_TRACE_MAGIC, sizeof(header->magic)) != 0) {
+		return false;
+	}
+
+	size_t offset = sizeof(*header);
+	uint64_t last_time = 0;
+	while (offset < size) {
+		struct input_trace_record record;
+		if (size - offset < sizeof(record)) {
+			return false;
+		}
+		memcpy(&record, data + offset, sizeof(record));
+		offset += sizeof(record);
+
+		ssize_t payload_size = replay_record_payload_size(record.type);
+		if (payload_size < 0 || record.size != payload_size ||
+				size - offset < record.size ||
+				record.time_nsec < last_time) {
+			return false;
+		}
+		offset += record.size;
+		last_time = record.time_nsec;
+	}
+
+	return true;
+}
+
+struct wlr_backend *wlr_replay_backend_create(struct wl_display *display,
+		const char *path, double speed) {
+	wlr_log(WLR_INFO, "Creating replay backend");
+
+	struct wlr_replay_backend *backend =
+		calloc(1, sizeof(struct wlr_replay_backend));
+	if (!backend) {
+		wlr_log(WLR_ERROR, "Failed to allocate wlr_replay_backend");
+		return NULL;
+	}
+	wlr_backend_init(&backend->backend, &backend_impl);
+	backend->display = display;
+	backend->speed = speed;
+	wl_list_init(&backend->input_devices);
+	wl_list_init(&backend->tools);
+
+	backend->trace = read_trace(path, &backend->trace_size);
+	if (backend->trace == NULL) {
+		free(backend);
+		return NULL;
+	}
+	if (!validate_trace(backend->trace, backend->trace_size)) {
+		wlr_log(WLR_ERROR, "Invalid input trace %s", path);
+		free(backend->trace);
+		free(backend);
+		return NULL;
+	}
+	backend->offset = sizeof(struct input_trace_header);
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	backend->timer = wl_event_loop_add_timer(loop, handle_timer, backend);
+	if (backend->timer == NULL) {
+		free(backend->trace);
+		free(backend);
+		return NULL;
+	}
+
+	backend->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &backend->display_destroy);
+
+	return &backend->backend;
+}
+
+bool wlr_backend_is_replay(struct wlr_backend *backend) {
+	return backend->impl == &backend_impl;
+}
+
+void wlr_replay_backend_get_stats(struct wlr_backend *wlr_backend,
+		struct wlr_replay_stats *stats) {
+	struct wlr_replay_backend *backend =
+		replay_backend_from_backend(wlr_backend);
+	*stats = backend->stats;
+}
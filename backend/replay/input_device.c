@@ -0,0 +1,500 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/interfaces/wlr_input_device.h>
+#include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
+#include <wlr/interfaces/wlr_tablet_tool.h>
+#include <wlr/interfaces/wlr_touch.h>
+#include <wlr/util/log.h>
+#include "backend/replay.h"
+#include "util/signal.h"
+
+static void input_device_destroy(struct wlr_input_device *wlr_dev) {
+	struct wlr_replay_input_device *device =
+		(struct wlr_replay_input_device *)wlr_dev;
+	wl_list_remove(&device->link);
+	free(device);
+}
+
+static const struct wlr_input_device_impl input_device_impl = {
+	.destroy = input_device_destroy,
+};
+
+bool wlr_input_device_is_replay(struct wlr_input_device *wlr_dev) {
+	return wlr_dev->impl == &input_device_impl;
+}
+
+static struct wlr_replay_input_device *get_input_device(
+		struct wlr_replay_backend *backend, uint32_t id) {
+	struct wlr_replay_input_device *device;
+	wl_list_for_each(device, &backend->input_devices, link) {
+		if (device->id == id) {
+			return device;
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_tablet_tool *get_tool(struct wlr_replay_backend *backend,
+		uint32_t id) {
+	struct wlr_replay_tool *tool;
+	wl_list_for_each(tool, &backend->tools, link) {
+		if (tool->id == id) {
+			return &tool->wlr_tool;
+		}
+	}
+	return NULL;
+}
+
+static void add_input_device(struct wlr_replay_backend *backend, uint32_t id,
+		const struct input_trace_device *payload) {
+	if (get_input_device(backend, id) != NULL) {
+		wlr_log(WLR_ERROR, "Duplicate input device %"PRIu32" in trace", id);
+		return;
+	}
+
+	struct wlr_replay_input_device *device =
+		calloc(1, sizeof(struct wlr_replay_input_device));
+	if (device == NULL) {
+		return;
+	}
+	device->backend = backend;
+	device->id = id;
+
+	char name[INPUT_TRACE_NAME_LEN];
+	memcpy(name, payload->name, sizeof(name));
+	name[sizeof(name) - 1] = '\0';
+
+	enum wlr_input_device_type type = payload->type;
+	struct wlr_input_device *wlr_device = &device->wlr_input_device;
+	wlr_input_device_init(wlr_device, type, &input_device_impl, name,
+		payload->vendor, payload->product);
+
+	switch (type) {
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		wlr_device->keyboard = calloc(1, sizeof(struct wlr_keyboard));
+		if (wlr_device->keyboard == NULL) {
+			wlr_log(WLR_ERROR, "Unable to allocate wlr_keyboard");
+			goto error;
+		}
+		wlr_keyboard_init(wlr_device->keyboard, NULL);
+		break;
+	case WLR_INPUT_DEVICE_POINTER:
+		wlr_device->pointer = calloc(1, sizeof(struct wlr_pointer));
+		if (wlr_device->pointer == NULL) {
+			wlr_log(WLR_ERROR, "Unable to allocate wlr_pointer");
+			goto error;
+		}
+		wlr_pointer_init(wlr_device->pointer, NULL);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		wlr_device->touch = calloc(1, sizeof(struct wlr_touch));
+		if (wlr_device->touch == NULL) {
+			wlr_log(WLR_ERROR, "Unable to allocate wlr_touch");
+			goto error;
+		}
+		wlr_touch_init(wlr_device->touch, NULL);
+		break;
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		wlr_device->tablet = calloc(1, sizeof(struct wlr_tablet));
+		if (wlr_device->tablet == NULL) {
+			wlr_log(WLR_ERROR, "Unable to allocate wlr_tablet");
+			goto error;
+		}
+		wlr_tablet_init(wlr_device->tablet, NULL);
+		break;
+	default:
+		wlr_log(WLR_ERROR, "Unsupported input device type %d in trace", type);
+		goto error;
+	}
+
+	wl_list_insert(&backend->input_devices, &device->link);
+	wlr_signal_emit_safe(&backend->backend.events.new_input, wlr_device);
+	return;
+
+error:
+	free(wlr_device->name);
+	free(device);
+}
+
+static void add_tool(struct wlr_replay_backend *backend,
+		const struct input_trace_tool *payload) {
+	if (get_tool(backend, payload->id) != NULL) {
+		return;
+	}
+
+	struct wlr_replay_tool *tool = calloc(1, sizeof(struct wlr_replay_tool));
+	if (tool == NULL) {
+		return;
+	}
+	tool->id = payload->id;
+	tool->wlr_tool.type = payload->type;
+	tool->wlr_tool.hardware_serial = payload->hardware_serial;
+	tool->wlr_tool.hardware_wacom = payload->hardware_wacom;
+	tool->wlr_tool.tilt = payload->capabilities & INPUT_TRACE_TOOL_TILT;
+	tool->wlr_tool.pressure = payload->capabilities & INPUT_TRACE_TOOL_PRESSURE;
+	tool->wlr_tool.distance = payload->capabilities & INPUT_TRACE_TOOL_DISTANCE;
+	tool->wlr_tool.rotation = payload->capabilities & INPUT_TRACE_TOOL_ROTATION;
+	tool->wlr_tool.slider = payload->capabilities & INPUT_TRACE_TOOL_SLIDER;
+	tool->wlr_tool.wheel = payload->capabilities & INPUT_TRACE_TOOL_WHEEL;
+	wl_signal_init(&tool->wlr_tool.events.destroy);
+	wl_list_insert(&backend->tools, &tool->link);
+}
+
+void replay_destroy_input_devices(struct wlr_replay_backend *backend) {
+	struct wlr_replay_input_device *device, *device_tmp;
+	wl_list_for_each_safe(device, device_tmp, &backend->input_devices, link) {
+		wlr_input_device_destroy(&device->wlr_input_device);
+	}
+
+	struct wlr_replay_tool *tool, *tool_tmp;
+	wl_list_for_each_safe(tool, tool_tmp, &backend->tools, link) {
+		wlr_signal_emit_safe(&tool->wlr_tool.events.destroy, &tool->wlr_tool);
+		wl_list_remove(&tool->link);
+		free(tool);
+	}
+}
+
+ssize_t replay_record_payload_size(uint16_t type) {
+	switch ((enum input_trace_record_type)type) {
+	case INPUT_TRACE_DEVICE_ADD:
+		return sizeof(struct input_trace_device);
+	case INPUT_TRACE_DEVICE_REMOVE:
+	case INPUT_TRACE_POINTER_FRAME:
+		return 0;
+	case INPUT_TRACE_TOOL_ADD:
+		return sizeof(struct input_trace_tool);
+	case INPUT_TRACE_POINTER_MOTION:
+		return sizeof(struct input_trace_pointer_motion);
+	case INPUT_TRACE_POINTER_MOTION_ABSOLUTE:
+	case INPUT_TRACE_TOUCH_DOWN:
+	case INPUT_TRACE_TOUCH_UP:
+	case INPUT_TRACE_TOUCH_MOTION:
+	case INPUT_TRACE_TOUCH_CANCEL:
+	case INPUT_TRACE_TABLET_TOOL_PROXIMITY:
+	case INPUT_TRACE_TABLET_TOOL_TIP:
+		return sizeof(struct input_trace_position);
+	case INPUT_TRACE_POINTER_BUTTON:
+	case INPUT_TRACE_TABLET_TOOL_BUTTON:
+		return sizeof(struct input_trace_button);
+	case INPUT_TRACE_POINTER_AXIS:
+		return sizeof(struct input_trace_pointer_axis);
+	case INPUT_TRACE_POINTER_SWIPE_BEGIN:
+	case INPUT_TRACE_POINTER_SWIPE_UPDATE:
+	case INPUT_TRACE_POINTER_SWIPE_END:
+	case INPUT_TRACE_POINTER_PINCH_BEGIN:
+	case INPUT_TRACE_POINTER_PINCH_UPDATE:
+	case INPUT_TRACE_POINTER_PINCH_END:
+		return sizeof(struct input_trace_gesture);
+	case INPUT_TRACE_KEYBOARD_KEY:
+		return sizeof(struct input_trace_keyboard_key);
+	case INPUT_TRACE_TABLET_TOOL_AXIS:
+		return sizeof(struct input_trace_tablet_tool_axis);
+	}
+	return -1;
+}
+
+static void emit_pointer_event(struct wlr_input_device *wlr_dev,
+		uint16_t type, const void *payload) {
+	struct wlr_pointer *pointer = wlr_dev->pointer;
+	switch (type) {
+	case INPUT_TRACE_POINTER_MOTION:;
+		const struct input_trace_pointer_motion *motion = payload;
+		struct wlr_event_pointer_motion motion_event = {
+			.device = wlr_dev,
+			.time_msec = motion->time_msec,
+			.delta_x = motion->delta_x,
+			.delta_y = motion->delta_y,
+			.unaccel_dx = motion->unaccel_dx,
+			.unaccel_dy = motion->unaccel_dy,
+		};
+		wlr_signal_emit_safe(&pointer->events.motion, &motion_event);
+		break;
+	case INPUT_TRACE_POINTER_MOTION_ABSOLUTE:;
+		const struct input_trace_position *absolute = payload;
+		struct wlr_event_pointer_motion_absolute absolute_event = {
+			.device = wlr_dev,
+			.time_msec = absolute->time_msec,
+			.x = absolute->x,
+			.y = absolute->y,
+		};
+		wlr_signal_emit_safe(&pointer->events.motion_absolute,
+			&absolute_event);
+		break;
+	case INPUT_TRACE_POINTER_BUTTON:;
+		const struct input_trace_button *button = payload;
+		struct wlr_event_pointer_button button_event = {
+			.device = wlr_dev,
+			.time_msec = button->time_msec,
+			.button = button->button,
+			.state = button->state,
+		};
+		wlr_signal_emit_safe(&pointer->events.button, &button_event);
+		break;
+	case INPUT_TRACE_POINTER_AXIS:;
+		const struct input_trace_pointer_axis *axis = payload;
+		struct wlr_event_pointer_axis axis_event = {
+			.device = wlr_dev,
+			.time_msec = axis->time_msec,
+			.source = axis->source,
+			.orientation = axis->orientation,
+			.delta = axis->delta,
+			.delta_discrete = axis->delta_discrete,
+		};
+		wlr_signal_emit_safe(&pointer->events.axis, &axis_event);
+		break;
+	case INPUT_TRACE_POINTER_FRAME:
+		wlr_signal_emit_safe(&pointer->events.frame, pointer);
+		break;
+	case INPUT_TRACE_POINTER_SWIPE_BEGIN:;
+		const struct input_trace_gesture *swipe_begin = payload;
+		struct wlr_event_pointer_swipe_begin swipe_begin_event = {
+			.device = wlr_dev,
+			.time_msec = swipe_begin->time_msec,
+			.fingers = swipe_begin->fingers,
+		};
+		wlr_signal_emit_safe(&pointer->events.swipe_begin,
+			&swipe_begin_event);
+		break;
+	case INPUT_TRACE_POINTER_SWIPE_UPDATE:;
+		const struct input_trace_gesture *swipe_update = payload;
+		struct wlr_event_pointer_swipe_update swipe_update_event = {
+			.device = wlr_dev,
+			.time_msec = swipe_update->time_msec,
+			.fingers = swipe_update->fingers,
+			.dx = swipe_update->dx,
+			.dy = swipe_update->dy,
+		};
+		wlr_signal_emit_safe(&pointer->events.swipe_update,
+			&swipe_update_event);
+		break;
+	case INPUT_TRACE_POINTER_SWIPE_END:;
+		const struct input_trace_gesture *swipe_end = payload;
+		struct wlr_event_pointer_swipe_end swipe_end_event = {
+			.device = wlr_dev,
+			.time_msec = swipe_end->time_msec,
+			.cancelled = swipe_end->cancelled,
+		};
+		wlr_signal_emit_safe(&pointer->events.swipe_end, &swipe_end_event);
+		break;
+	case INPUT_TRACE_POINTER_PINCH_BEGIN:;
+		const struct input_trace_gesture *pinch_begin = payload;
+		struct wlr_event_pointer_pinch_begin pinch_begin_event = {
+			.device = wlr_dev,
+			.time_msec = pinch_begin->time_msec,
+			.fingers = pinch_begin->fingers,
+		};
+		wlr_signal_emit_safe(&pointer->events.pinch_begin,
+			&pinch_begin_event);
+		break;
+	case INPUT_TRACE_POINTER_PINCH_UPDATE:;
+		const struct input_trace_gesture *pinch_update = payload;
+		struct wlr_event_pointer_pinch_update pinch_update_event = {
+			.device = wlr_dev,
+			.time_msec = pinch_update->time_msec,
+			.fingers = pinch_update->fingers,
+			.dx = pinch_update->dx,
+			.dy = pinch_update->dy,
+			.scale = pinch_update->scale,
+			.rotation = pinch_update->rotation,
+		};
+		wlr_signal_emit_safe(&pointer->events.pinch_update,
+			&pinch_update_event);
+		break;
+	case INPUT_TRACE_POINTER_PINCH_END:;
+		const struct input_trace_gesture *pinch_end = payload;
+		struct wlr_event_pointer_pinch_end pinch_end_event = {
+			.device = wlr_dev,
+			.time_msec = pinch_end->time_msec,
+			.cancelled = pinch_end->cancelled,
+		};
+		wlr_signal_emit_safe(&pointer->events.pinch_end, &pinch_end_event);
+		break;
+	default:
+		wlr_log(WLR_ERROR, "Invalid event for a pointer in trace");
+	}
+}
+
+static void emit_touch_event(struct wlr_input_device *wlr_dev,
+		uint16_t type, const struct input_trace_position *payload) {
+	struct wlr_touch *touch = wlr_dev->touch;
+	switch (type) {
+	case INPUT_TRACE_TOUCH_DOWN:;
+		struct wlr_event_touch_down down_event = {
+			.device = wlr_dev,
+			.time_msec = payload->time_msec,
+			.touch_id = payload->id,
+			.x = payload->x,
+			.y = payload->y,
+		};
+		wlr_signal_emit_safe(&touch->events.down, &down_event);
+		break;
+	case INPUT_TRACE_TOUCH_UP:;
+		struct wlr_event_touch_up up_event = {
+			.device = wlr_dev,
+			.time_msec = payload->time_msec,
+			.touch_id = payload->id,
+		};
+		wlr_signal_emit_safe(&touch->events.up, &up_event);
+		break;
+	case INPUT_TRACE_TOUCH_MOTION:;
+		struct wlr_event_touch_motion motion_event = {
+			.device = wlr_dev,
+			.time_msec = payload->time_msec,
+			.touch_id = payload->id,
+			.x = payload->x,
+			.y = payload->y,
+		};
+		wlr_signal_emit_safe(&touch->events.motion, &motion_event);
+		break;
+	case INPUT_TRACE_TOUCH_CANCEL:;
+		struct wlr_event_touch_cancel cancel_event = {
+			.device = wlr_dev,
+			.time_msec = payload->time_msec,
+			.touch_id = payload->id,
+		};
+		wlr_signal_emit_safe(&touch->events.cancel, &cancel_event);
+		break;
+	default:
+		wlr_log(WLR_ERROR, "Invalid event for a touch device in trace");
+	}
+}
+
+static void emit_tablet_tool_event(struct wlr_replay_backend *backend,
+		struct wlr_input_device *wlr_dev, uint16_t type,
+		const void *payload) {
+	struct wlr_tablet *tablet = wlr_dev->tablet;
+	struct wlr_tablet_tool *tool;
+	switch (type) {
+	case INPUT_TRACE_TABLET_TOOL_AXIS:;
+		const struct input_trace_tablet_tool_axis *axis = payload;
+		if ((tool = get_tool(backend, axis->tool)) == NULL) {
+			break;
+		}
+		struct wlr_event_tablet_tool_axis axis_event = {
+			.device = wlr_dev,
+			.tool = tool,
+			.time_msec = axis->time_msec,
+			.updated_axes = axis->updated_axes,
+			.x = axis->x,
+			.y = axis->y,
+			.dx = axis->dx,
+			.dy = axis->dy,
+			.pressure = axis->pressure,
+			.distance = axis->distance,
+			.tilt_x = axis->tilt_x,
+			.tilt_y = axis->tilt_y,
+			.rotation = axis->rotation,
+			.slider = axis->slider,
+			.wheel_delta = axis->wheel_delta,
+		};
+		wlr_signal_emit_safe(&tablet->events.axis, &axis_event);
+		return;
+	case INPUT_TRACE_TABLET_TOOL_PROXIMITY:;
+		const struct input_trace_position *proximity = payload;
+		if ((tool = get_tool(backend, proximity->id)) == NULL) {
+			break;
+		}
+		struct wlr_event_tablet_tool_proximity proximity_event = {
+			.device = wlr_dev,
+			.tool = tool,
+			.time_msec = proximity->time_msec,
+			.x = proximity->x,
+			.y = proximity->y,
+			.state = proximity->state,
+		};
+		wlr_signal_emit_safe(&tablet->events.proximity, &proximity_event);
+		return;
+	case INPUT_TRACE_TABLET_TOOL_TIP:;
+		const struct input_trace_position *tip = payload;
+		if ((tool = get_tool(backend, tip->id)) == NULL) {
+			break;
+		}
+		struct wlr_event_tablet_tool_tip tip_event = {
+			.device = wlr_dev,
+			.tool = tool,
+			.time_msec = tip->time_msec,
+			.x = tip->x,
+			.y = tip->y,
+			.state = tip->state,
+		};
+		wlr_signal_emit_safe(&tablet->events.tip, &tip_event);
+		return;
+	case INPUT_TRACE_TABLET_TOOL_BUTTON:;
+		const struct input_trace_button *button = payload;
+		if ((tool = get_tool(backend, button->tool)) == NULL) {
+			break;
+		}
+		struct wlr_event_tablet_tool_button button_event = {
+			.device = wlr_dev,
+			.tool = tool,
+			.time_msec = button->time_msec,
+			.button = button->button,
+			.state = button->state,
+		};
+		wlr_signal_emit_safe(&tablet->events.button, &button_event);
+		return;
+	default:
+		wlr_log(WLR_ERROR, "Invalid event for a tablet tool in trace");
+		return;
+	}
+	wlr_log(WLR_ERROR, "Unknown tablet tool in trace");
+}
+
+void replay_apply_record(struct wlr_replay_backend *backend,
+		const struct input_trace_record *record, const void *payload) {
+	switch (record->type) {
+	case INPUT_TRACE_DEVICE_ADD:
+		add_input_device(backend, record->device, payload);
+		return;
+	case INPUT_TRACE_TOOL_ADD:
+		add_tool(backend, payload);
+		return;
+	}
+
+	struct wlr_replay_input_device *device =
+		get_input_device(backend, record->device);
+	if (device == NULL) {
+		wlr_log(WLR_ERROR, "Unknown input device %"PRIu32" in trace",
+			record->device);
+		return;
+	}
+	struct wlr_input_device *wlr_dev = &device->wlr_input_device;
+
+	if (record->type == INPUT_TRACE_DEVICE_REMOVE) {
+		wlr_input_device_destroy(wlr_dev);
+		return;
+	}
+
+	backend->stats.events++;
+
+	switch (wlr_dev->type) {
+	case WLR_INPUT_DEVICE_POINTER:
+		emit_pointer_event(wlr_dev, record->type, payload);
+		break;
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		if (record->type != INPUT_TRACE_KEYBOARD_KEY) {
+			wlr_log(WLR_ERROR, "Invalid event for a keyboard in trace");
+			break;
+		}
+		const struct input_trace_keyboard_key *key = payload;
+		struct wlr_event_keyboard_key key_event = {
+			.time_msec = key->time_msec,
+			.keycode = key->keycode,
+			.state = key->state,
+			.update_state = key->update_state,
+		};
+		wlr_keyboard_notify_key(wlr_dev->keyboard, &key_event);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		emit_touch_event(wlr_dev, record->type, payload);
+		break;
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		emit_tablet_tool_event(backend, wlr_dev, record->type, payload);
+		break;
+	default:
+		assert(false);
+	}
+}
@@ -0,0 +1,801 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+
+/*
+ * Measures the compositing hot path: N synthetic clients commit wl_shm
+ * buffers with a configurable damage pattern, a headless output composites
+ * them with damage tracking.
+ *
+ * The clients live in the same process and talk to the compositor over a
+ * socketpair, so the whole wl_surface commit path is exercised.
+ */
+
+enum damage_pattern {
+	DAMAGE_FULL,
+	DAMAGE_RECT,
+	DAMAGE_SCATTER,
+};
+
+static const char *damage_pattern_names[] = {
+	[DAMAGE_FULL] = "full",
+	[DAMAGE_RECT] = "rect",
+	[DAMAGE_SCATTER] = "scatter",
+};
+
+struct bench_options {
+	int n_surfaces;
+	int surface_width, surface_height;
+	int output_width, output_height;
+	int refresh; // mHz
+	int n_frames;
+	enum damage_pattern damage;
+	bool software;
+};
+
+struct bench_stats {
+	int frames, skipped_frames;
+	uint64_t damage_ns; // spent in wlr_output_damage
+	uint64_t render_ns;
+	uint64_t client_cpu_ns; // spent painting buffers
+	double *latencies; // commit-to-present, in ms
+	size_t latencies_len, latencies_cap;
+};
+
+struct bench_server_surface {
+	struct bench_state *state;
+	struct wlr_surface *wlr_surface;
+	int x, y;
+
+	struct timespec committed; // last commit not rendered yet
+	bool dirty;
+	struct timespec inflight; // commit rendered in the last output commit
+	uint32_t inflight_seq;
+	bool has_inflight;
+
+	struct wl_listener commit;
+	struct wl_listener destroy;
+	struct wl_list link;
+};
+
+struct bench_client_buffer {
+	struct wl_buffer *buffer;
+	void *data;
+};
+
+struct bench_client_surface {
+	struct bench_state *state;
+	int index;
+	struct wl_surface *surface;
+	struct bench_client_buffer buffers[2];
+	int current_buffer;
+	struct wl_callback *frame_callback;
+	uint32_t frame;
+};
+
+struct bench_state {
+	struct bench_options options;
+	struct bench_stats stats;
+
+	// Compositor
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+	struct wlr_output *output;
+	struct wlr_output_damage *output_damage;
+	struct wl_list surfaces; // bench_server_surface::link
+	int n_server_surfaces;
+	bool done;
+
+	struct wl_listener new_output;
+	struct wl_listener new_surface;
+	struct wl_listener damage_frame;
+	struct wl_listener output_present;
+
+	// Clients
+	struct wl_display *client_display;
+	struct wl_compositor *client_compositor;
+	struct wl_shm *client_shm;
+	struct bench_client_surface *client_surfaces;
+};
+
+static uint64_t timespec_to_nsec(const struct timespec *t) {
+	return (uint64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+static uint64_t get_time_nsec(clockid_t clock) {
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return timespec_to_nsec(&now);
+}
+
+static void stats_add_latency(struct bench_stats *stats, double ms) {
+	if (stats->latencies_len == stats->latencies_cap) {
+		size_t cap = stats->latencies_cap == 0 ? 1024 :
+			stats->latencies_cap * 2;
+		double *latencies = realloc(stats->latencies, cap * sizeof(double));
+		if (latencies == NULL) {
+			return;
+		}
+		stats->latencies = latencies;
+		stats->latencies_cap = cap;
+	}
+	stats->latencies[stats->latencies_len++] = ms;
+}
+
+static int compare_double(const void *a, const void *b) {
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static double percentile(const double *sorted, size_t len, double p) {
+	if (len == 0) {
+		return 0;
+	}
+	size_t i = (size_t)ceil(p / 100 * len);
+	if (i > 0) {
+		i--;
+	}
+	return sorted[i < len ? i : len - 1];
+}
+
+/* Compositor */
+
+static void server_surface_handle_commit(struct wl_listener *listener,
+		void *data) {
+	struct bench_server_surface *surface =
+		wl_container_of(listener, surface, commit);
+	struct bench_state *state = surface->state;
+
+	clock_gettime(CLOCK_MONOTONIC, &surface->committed);
+	surface->dirty = true;
+
+	if (state->output_damage == NULL) {
+		return;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface->wlr_surface, &damage);
+	pixman_region32_translate(&damage, surface->x, surface->y);
+
+	uint64_t start = get_time_nsec(CLOCK_MONOTONIC);
+	wlr_output_damage_add(state->output_damage, &damage);
+	state->stats.damage_ns += get_time_nsec(CLOCK_MONOTONIC) - start;
+
+	pixman_region32_fini(&damage);
+}
+
+static void server_surface_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct bench_server_surface *surface =
+		wl_container_of(listener, surface, destroy);
+	wl_list_remove(&surface->commit.link);
+	wl_list_remove(&surface->destroy.link);
+	wl_list_remove(&surface->link);
+	free(surface);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_state *state =
+		wl_container_of(listener, state, new_surface);
+	struct wlr_surface *wlr_surface = data;
+
+	struct bench_server_surface *surface =
+		calloc(1, sizeof(struct bench_server_surface));
+	if (surface == NULL) {
+		return;
+	}
+	surface->state = state;
+	surface->wlr_surface = wlr_surface;
+
+	// Lay out surfaces in a grid, overlapping if the output is too small
+	int cols = ceil(sqrt(state->options.n_surfaces));
+	int i = state->n_server_surfaces++;
+	int step_x = state->options.output_width / cols;
+	int step_y = state->options.output_height / cols;
+	surface->x = (i % cols) * step_x;
+	surface->y = (i / cols) * step_y;
+
+	surface->commit.notify = server_surface_handle_commit;
+	wl_signal_add(&wlr_surface->events.commit, &surface->commit);
+	surface->destroy.notify = server_surface_handle_destroy;
+	wl_signal_add(&wlr_surface->events.destroy, &surface->destroy);
+	wl_list_insert(state->surfaces.prev, &surface->link);
+}
+
+static void render_surfaces(struct bench_state *state,
+		pixman_region32_t *damage) {
+	struct wlr_output *output = state->output;
+	struct wlr_renderer *renderer = state->renderer;
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
+	for (int i = 0; i < n; ++i) {
+		struct wlr_box box = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		wlr_renderer_scissor(renderer, &box);
+		wlr_renderer_clear(renderer, (float[]){ 0.2, 0.2, 0.2, 1.0 });
+
+		struct bench_server_surface *surface;
+		wl_list_for_each(surface, &state->surfaces, link) {
+			struct wlr_texture *texture =
+				wlr_surface_get_texture(surface->wlr_surface);
+			if (texture == NULL) {
+				continue;
+			}
+			wlr_render_texture(renderer, texture, output->transform_matrix,
+				surface->x, surface->y, 1.0);
+		}
+	}
+	wlr_renderer_scissor(renderer, NULL);
+}
+
+static void handle_damage_frame(struct wl_listener *listener, void *data) {
+	struct bench_state *state =
+		wl_container_of(listener, state, damage_frame);
+	struct wlr_output *output = state->output;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	bool needs_frame;
+	pixman_region32_t buffer_damage;
+	pixman_region32_init(&buffer_damage);
+
+	uint64_t start = get_time_nsec(CLOCK_MONOTONIC);
+	bool ok = wlr_output_damage_attach_render(state->output_damage,
+		&needs_frame, &buffer_damage);
+	state->stats.damage_ns += get_time_nsec(CLOCK_MONOTONIC) - start;
+	if (!ok) {
+		pixman_region32_fini(&buffer_damage);
+		return;
+	}
+
+	if (!needs_frame) {
+		wlr_output_rollback(output);
+		state->stats.skipped_frames++;
+	} else {
+		start = get_time_nsec(CLOCK_MONOTONIC);
+		wlr_renderer_begin(state->renderer, output->width, output->height);
+		render_surfaces(state, &buffer_damage);
+		wlr_renderer_end(state->renderer);
+		state->stats.render_ns += get_time_nsec(CLOCK_MONOTONIC) - start;
+
+		struct bench_server_surface *surface;
+		wl_list_for_each(surface, &state->surfaces, link) {
+			if (surface->dirty) {
+				surface->inflight = surface->committed;
+				surface->inflight_seq = output->commit_seq + 1;
+				surface->has_inflight = true;
+				surface->dirty = false;
+			}
+		}
+
+		wlr_output_set_damage(output, &state->output_damage->current);
+		if (wlr_output_commit(output)) {
+			state->stats.frames++;
+		}
+	}
+	pixman_region32_fini(&buffer_damage);
+
+	struct bench_server_surface *surface;
+	wl_list_for_each(surface, &state->surfaces, link) {
+		wlr_surface_send_frame_done(surface->wlr_surface, &now);
+	}
+
+	if (state->stats.frames >= state->options.n_frames) {
+		state->done = true;
+	}
+}
+
+static void handle_output_present(struct wl_listener *listener, void *data) {
+	struct bench_state *state =
+		wl_container_of(listener, state, output_present);
+	struct wlr_output_event_present *event = data;
+
+	struct bench_server_surface *surface;
+	wl_list_for_each(surface, &state->surfaces, link) {
+		if (!surface->has_inflight ||
+				surface->inflight_seq != event->commit_seq) {
+			continue;
+		}
+		int64_t ns = (int64_t)timespec_to_nsec(event->when) -
+			(int64_t)timespec_to_nsec(&surface->inflight);
+		stats_add_latency(&state->stats, ns / 1000000.0);
+		surface->has_inflight = false;
+	}
+}
+
+static void handle_new_output(struct wl_listener *listener, void *data) {
+	struct bench_state *state = wl_container_of(listener, state, new_output);
+	struct wlr_output *output = data;
+
+	if (state->output != NULL) {
+		return;
+	}
+	state->output = output;
+
+	wlr_output_set_custom_mode(output, state->options.output_width,
+		state->options.output_height, state->options.refresh);
+	wlr_output_commit(output);
+
+	state->output_damage = wlr_output_damage_create(output);
+	state->damage_frame.notify = handle_damage_frame;
+	wl_signal_add(&state->output_damage->events.frame, &state->damage_frame);
+	state->output_present.notify = handle_output_present;
+	wl_signal_add(&output->events.present, &state->output_present);
+}
+
+/* Clients */
+
+static int create_shm_file(size_t size) {
+	char name[64];
+	snprintf(name, sizeof(name), "/wlroots-bench-%d", getpid());
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0) {
+		return -1;
+	}
+	shm_unlink(name);
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool client_surface_init_buffers(struct bench_client_surface *surface) {
+	struct bench_state *state = surface->state;
+	int width = state->options.surface_width;
+	int height = state->options.surface_height;
+	int stride = width * 4;
+	size_t buffer_size = (size_t)stride * height;
+	size_t size = buffer_size * 2;
+
+	int fd = create_shm_file(size);
+	if (fd < 0) {
+		return false;
+	}
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	memset(data, 0xFF, size);
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(state->client_shm, fd, size);
+	for (int i = 0; i < 2; ++i) {
+		surface->buffers[i].data = (char *)data + i * buffer_size;
+		surface->buffers[i].buffer = wl_shm_pool_create_buffer(pool,
+			i * buffer_size, width, height, stride, WL_SHM_FORMAT_XRGB8888);
+	}
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return true;
+}
+
+static void paint_rect(struct bench_client_surface *surface, uint32_t *data,
+		int x, int y, int width, int height, uint32_t color) {
+	struct bench_state *state = surface->state;
+	int surface_width = state->options.surface_width;
+	int surface_height = state->options.surface_height;
+	if (x + width > surface_width) {
+		width = surface_width - x;
+	}
+	if (y + height > surface_height) {
+		height = surface_height - y;
+	}
+	for (int j = y; j < y + height; ++j) {
+		for (int i = x; i < x + width; ++i) {
+			data[j * surface_width + i] = color;
+		}
+	}
+	wl_surface_damage_buffer(surface->surface, x, y, width, height);
+}
+
+static void client_surface_paint(struct bench_client_surface *surface) {
+	struct bench_state *state = surface->state;
+	int width = state->options.surface_width;
+	int height = state->options.surface_height;
+
+	struct bench_client_buffer *buffer =
+		&surface->buffers[surface->current_buffer];
+	surface->current_buffer = (surface->current_buffer + 1) % 2;
+
+	uint64_t start = get_time_nsec(CLOCK_THREAD_CPUTIME_ID);
+
+	uint32_t frame = surface->frame++;
+	uint32_t color = 0xFF000000 | (frame * 0x010203 + surface->index * 0x30);
+	switch (state->options.damage) {
+	case DAMAGE_FULL:
+		paint_rect(surface, buffer->data, 0, 0, width, height, color);
+		break;
+	case DAMAGE_RECT:;
+		// A box moving diagonally, repainted in both buffers
+		int box_size = width < height ? width / 8 : height / 8;
+		if (box_size < 1) {
+			box_size = 1;
+		}
+		int x = (frame * 4) % (width - box_size + 1);
+		int y = (frame * 4) % (height - box_size + 1);
+		paint_rect(surface, buffer->data, x, y, box_size, box_size, color);
+		break;
+	case DAMAGE_SCATTER:;
+		// Small boxes spread over the whole surface
+		uint32_t seed = frame * 2654435761u + surface->index;
+		for (int i = 0; i < 8; ++i) {
+			seed = seed * 1103515245 + 12345;
+			int x = (seed >> 8) % width;
+			seed = seed * 1103515245 + 12345;
+			int y = (seed >> 8) % height;
+			paint_rect(surface, buffer->data, x, y, 8, 8, color);
+		}
+		break;
+	}
+
+	state->stats.client_cpu_ns +=
+		get_time_nsec(CLOCK_THREAD_CPUTIME_ID) - start;
+
+	wl_surface_attach(surface->surface, buffer->buffer, 0, 0);
+}
+
+static const struct wl_callback_listener frame_listener;
+
+static void client_surface_commit(struct bench_client_surface *surface) {
+	client_surface_paint(surface);
+	surface->frame_callback = wl_surface_frame(surface->surface);
+	wl_callback_add_listener(surface->frame_callback, &frame_listener, surface);
+	wl_surface_commit(surface->surface);
+}
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time) {
+	struct bench_client_surface *surface = data;
+	wl_callback_destroy(callback);
+	surface->frame_callback = NULL;
+	if (!surface->state->done) {
+		client_surface_commit(surface);
+	}
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct bench_state *state = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		state->client_compositor = wl_registry_bind(registry, name,
+			&wl_compositor_interface, 1);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		state->client_shm = wl_registry_bind(registry, name,
+			&wl_shm_interface, 1);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// Who cares
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+/**
+ * Exchanges pending messages between the clients and the compositor, waiting
+ * for at most `timeout` milliseconds.
+ */
+static void dispatch(struct bench_state *state, int timeout) {
+	struct wl_event_loop *loop = wl_display_get_event_loop(state->display);
+
+	wl_display_flush(state->client_display);
+	wl_event_loop_dispatch(loop, timeout);
+	wl_display_flush_clients(state->display);
+
+	while (wl_display_prepare_read(state->client_display) != 0) {
+		wl_display_dispatch_pending(state->client_display);
+	}
+	// The socket is non-blocking, this returns immediately if there is
+	// nothing to read
+	if (wl_display_read_events(state->client_display) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to read client events");
+		state->done = true;
+	}
+	wl_display_dispatch_pending(state->client_display);
+}
+
+static void sync_handle_done(void *data, struct wl_callback *callback,
+		uint32_t serial) {
+	bool *done = data;
+	*done = true;
+	wl_callback_destroy(callback);
+}
+
+static const struct wl_callback_listener sync_listener = {
+	.done = sync_handle_done,
+};
+
+static void roundtrip(struct bench_state *state) {
+	bool done = false;
+	struct wl_callback *callback = wl_display_sync(state->client_display);
+	wl_callback_add_listener(callback, &sync_listener, &done);
+	while (!done) {
+		dispatch(state, 0);
+	}
+}
+
+static bool clients_init(struct bench_state *state) {
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+		return false;
+	}
+	if (wl_client_create(state->display, fds[0]) == NULL) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	state->client_display = wl_display_connect_to_fd(fds[1]);
+	if (state->client_display == NULL) {
+		close(fds[1]);
+		return false;
+	}
+
+	struct wl_registry *registry =
+		wl_display_get_registry(state->client_display);
+	wl_registry_add_listener(registry, &registry_listener, state);
+	roundtrip(state);
+	if (state->client_compositor == NULL || state->client_shm == NULL) {
+		wlr_log(WLR_ERROR, "Missing wl_compositor or wl_shm");
+		return false;
+	}
+
+	int n = state->options.n_surfaces;
+	state->client_surfaces = calloc(n, sizeof(struct bench_client_surface));
+	if (state->client_surfaces == NULL) {
+		return false;
+	}
+	for (int i = 0; i < n; ++i) {
+		struct bench_client_surface *surface = &state->client_surfaces[i];
+		surface->state = state;
+		surface->index = i;
+		surface->surface = wl_compositor_create_surface(
+			state->client_compositor);
+		if (!client_surface_init_buffers(surface)) {
+			wlr_log(WLR_ERROR, "Failed to create buffers");
+			return false;
+		}
+	}
+	roundtrip(state);
+
+	for (int i = 0; i < n; ++i) {
+		client_surface_commit(&state->client_surfaces[i]);
+	}
+	return true;
+}
+
+/* Main */
+
+static void print_report(struct bench_state *state, uint64_t wall_ns,
+		uint64_t cpu_ns) {
+	struct bench_stats *stats = &state->stats;
+	struct bench_options *options = &state->options;
+	int frames = stats->frames > 0 ? stats->frames : 1;
+
+	uint64_t upload_bytes = 0, full_upload_bytes = 0, recycled = 0;
+	struct bench_server_surface *surface;
+	wl_list_for_each(surface, &state->surfaces, link) {
+		upload_bytes += surface->wlr_surface->upload_stats.upload_bytes;
+		full_upload_bytes +=
+			surface->wlr_surface->upload_stats.full_upload_bytes;
+		recycled += surface->wlr_surface->upload_stats.textures_recycled;
+	}
+
+	qsort(stats->latencies, stats->latencies_len, sizeof(double),
+		compare_double);
+
+	printf("renderer: %s, surfaces: %d (%dx%d), damage: %s, output: %dx%d\n",
+		options->software ? "pixman" : "gles2", options->n_surfaces,
+		options->surface_width, options->surface_height,
+		damage_pattern_names[options->damage], options->output_width,
+		options->output_height);
+	printf("frames: %d (%d without damage) in %.1f ms\n", stats->frames,
+		stats->skipped_frames, wall_ns / 1e6);
+	printf("commit-to-present: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+		percentile(stats->latencies, stats->latencies_len, 50),
+		percentile(stats->latencies, stats->latencies_len, 99),
+		percentile(stats->latencies, stats->latencies_len, 100));
+	printf("output damage: %.3f ms/frame, %" PRIu64 "/%" PRIu64 " frames "
+		"fully repainted (max buffer age %d)\n",
+		stats->damage_ns / 1e6 / frames,
+		state->output_damage->stats.full_damage_frames,
+		state->output_damage->stats.frames,
+		state->output_damage->stats.max_buffer_age);
+	printf("render: %.3f ms/frame\n", stats->render_ns / 1e6 / frames);
+	printf("upload: %.1f KiB/frame (%.1f KiB/frame without damage "
+		"tracking), %" PRIu64 " textures recycled\n",
+		upload_bytes / 1024.0 / frames, full_upload_bytes / 1024.0 / frames,
+		recycled);
+	printf("CPU: %.3f ms/frame (%.3f ms/frame painting client buffers)\n",
+		cpu_ns / 1e6 / frames, stats->client_cpu_ns / 1e6 / frames);
+}
+
+static bool parse_size(const char *str, int *width, int *height) {
+	return sscanf(str, "%dx%d", width, height) == 2 &&
+		*width > 0 && *height > 0;
+}
+
+static const char usage[] =
+	"usage: bench-compositing [options]\n"
+	"  -n <count>       number of surfaces (default: 16)\n"
+	"  -s <W>x<H>       surface size (default: 256x256)\n"
+	"  -o <W>x<H>       output size (default: 1920x1080)\n"
+	"  -r <mHz>         output refresh rate (default: 60000)\n"
+	"  -f <count>       number of frames (default: 600)\n"
+	"  -d full|rect|scatter  damage pattern (default: rect)\n"
+	"  -p               use the pixman renderer instead of GLES2\n"
+	"  -v               enable debug logging\n";
+
+int main(int argc, char *argv[]) {
+	struct bench_state state = {
+		.options = {
+			.n_surfaces = 16,
+			.surface_width = 256,
+			.surface_height = 256,
+			.output_width = 1920,
+			.output_height = 1080,
+			.refresh = 60000,
+			.n_frames = 600,
+			.damage = DAMAGE_RECT,
+		},
+	};
+	struct bench_options *options = &state.options;
+	enum wlr_log_importance log_level = WLR_ERROR;
+
+	int c;
+	while ((c = getopt(argc, argv, "n:s:o:r:f:d:pvh")) != -1) {
+		switch (c) {
+		case 'n':
+			options->n_surfaces = atoi(optarg);
+			break;
+		case 's':
+			if (!parse_size(optarg, &options->surface_width,
+					&options->surface_height)) {
+				fprintf(stderr, "invalid surface size: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'o':
+			if (!parse_size(optarg, &options->output_width,
+					&options->output_height)) {
+				fprintf(stderr, "invalid output size: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			options->refresh = atoi(optarg);
+			break;
+		case 'f':
+			options->n_frames = atoi(optarg);
+			break;
+		case 'd':;
+			bool found = false;
+			for (size_t i = 0; i < sizeof(damage_pattern_names) /
+					sizeof(damage_pattern_names[0]); ++i) {
+				if (strcmp(optarg, damage_pattern_names[i]) == 0) {
+					options->damage = i;
+					found = true;
+				}
+			}
+			if (!found) {
+				fprintf(stderr, "invalid damage pattern: %s\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'p':
+			options->software = true;
+			break;
+		case 'v':
+			log_level = WLR_DEBUG;
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (options->n_surfaces <= 0 || options->n_frames <= 0) {
+		fprintf(stderr, "%s", usage);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(log_level, NULL);
+
+	state.display = wl_display_create();
+	wl_list_init(&state.surfaces);
+
+	if (options->software) {
+		state.renderer = wlr_pixman_renderer_create();
+		if (state.renderer == NULL) {
+			return EXIT_FAILURE;
+		}
+		state.backend = wlr_headless_backend_create_with_renderer(
+			state.display, state.renderer);
+	} else {
+		state.backend = wlr_headless_backend_create(state.display, NULL);
+	}
+	if (state.backend == NULL) {
+		return EXIT_FAILURE;
+	}
+	if (!options->software) {
+		state.renderer = wlr_backend_get_renderer(state.backend);
+	}
+	wlr_renderer_init_wl_display(state.renderer, state.display);
+
+	state.compositor = wlr_compositor_create(state.display, state.renderer);
+	state.new_surface.notify = handle_new_surface;
+	wl_signal_add(&state.compositor->events.new_surface, &state.new_surface);
+
+	state.new_output.notify = handle_new_output;
+	wl_signal_add(&state.backend->events.new_output, &state.new_output);
+	wlr_headless_add_output(state.backend, options->output_width,
+		options->output_height);
+
+	if (!wlr_backend_start(state.backend) || state.output == NULL) {
+		wlr_log(WLR_ERROR, "Failed to start backend");
+		return EXIT_FAILURE;
+	}
+
+	if (!clients_init(&state)) {
+		wlr_log(WLR_ERROR, "Failed to create clients");
+		return EXIT_FAILURE;
+	}
+
+	uint64_t wall_start = get_time_nsec(CLOCK_MONOTONIC);
+	uint64_t cpu_start = get_time_nsec(CLOCK_PROCESS_CPUTIME_ID);
+	state.stats.client_cpu_ns = 0;
+
+	while (!state.done) {
+		dispatch(&state, -1);
+	}
+
+	uint64_t wall_ns = get_time_nsec(CLOCK_MONOTONIC) - wall_start;
+	uint64_t cpu_ns = get_time_nsec(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+	print_report(&state, wall_ns, cpu_ns);
+
+	wl_display_disconnect(state.client_display);
+	wl_display_destroy_clients(state.display);
+	wl_display_destroy(state.display);
+	if (options->software) {
+		wlr_renderer_destroy(state.renderer);
+	}
+	free(state.client_surfaces);
+	free(state.stats.latencies);
+	return EXIT_SUCCESS;
+}
@@ -13,11 +13,29 @@
 #include <wlr/backend/session.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/render/egl.h>
+#include <wlr/types/wlr_box.h>
 #include <xf86drmMode.h>
 #include "iface.h"
 #include "properties.h"
 #include "renderer.h"
 
+#define DRM_CURSOR_IMAGE_CACHE_SIZE 16
+
+/**
+ * A cursor texture already rendered into a buffer suitable for the cursor
+ * plane, so that switching back to it doesn't need any rendering.
+ */
+struct wlr_drm_cursor_image {
+	struct wlr_drm_surface surf;
+
+	// Reference to a renderer cursor texture, NULL if the slot is unused
+	struct wlr_texture *texture;
+	float scale, output_scale;
+	enum wl_output_transform transform, output_transform;
+
+	uint64_t last_used;
+};
+
 struct wlr_drm_plane {
 	uint32_t type;
 	uint32_t id;
@@ -32,6 +50,28 @@ struct wlr_drm_plane {
 	float matrix[9];
 	bool cursor_enabled;
 	int32_t cursor_hotspot_x, cursor_hotspot_y;
+	struct gbm_bo *cursor_bo; // buffer holding the current image
+	struct wlr_drm_cursor_image cursor_images[DRM_CURSOR_IMAGE_CACHE_SIZE];
+	uint64_t cursor_images_seq;
+	struct {
+		uint64_t hits, misses;
+	} cursor_image_stats;
+
+	// Only used by overlays
+	struct {
+		// State applied with the next page-flip, if the CRTC's overlays have
+		// changed
+		uint32_t fb_id; // 0 if disabled
+		struct wlr_box box; // in CRTC coordinates
+		bool flip_pending;
+
+		// Buffer submitted to the kernel but not yet displayed
+		struct wlr_buffer *pending_buffer;
+		struct gbm_bo *pending_bo;
+		// Buffer currently being displayed
+		struct wlr_buffer *current_buffer;
+		struct gbm_bo *current_bo;
+	} overlay;
 
 	union wlr_drm_plane_props props;
 };
@@ -50,12 +90,10 @@ struct wlr_drm_crtc {
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
 
-	/*
-	 * We don't support overlay planes yet, but we keep track of them to
-	 * give to DRM lease clients.
-	 */
+	// Overlay planes, used for wlr_output_overlay
 	size_t num_overlays;
-	uint32_t *overlays;
+	struct wlr_drm_plane **overlays;
+	bool overlays_changed; // apply overlay planes' state on next page-flip
 
 	union wlr_drm_crtc_props props;
 
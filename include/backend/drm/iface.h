@@ -33,6 +33,9 @@ struct wlr_drm_interface {
 	// Get the gamma lut size of a crtc
 	size_t (*crtc_get_gamma_size)(struct wlr_drm_backend *drm,
 		struct wlr_drm_crtc *crtc);
+	// Check whether the overlay planes' state of crtc can be applied
+	bool (*crtc_test_overlays)(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc);
 };
 
 extern const struct wlr_drm_interface atomic_iface;
@@ -0,0 +1,30 @@
+#ifndef BACKEND_DRM_OVERLAY_H
+#define BACKEND_DRM_OVERLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "backend/drm/drm.h"
+
+/**
+ * Release the buffers displayed or about to be displayed by an overlay plane,
+ * and reset its state.
+ */
+void drm_plane_release_overlay(struct wlr_drm_plane *plane);
+/**
+ * Mark the output's overlays which can be put on overlay planes as accepted,
+ * without changing the configuration of the next page-flip.
+ */
+void drm_connector_test_overlays(struct wlr_drm_backend *drm,
+	struct wlr_drm_connector *conn);
+/**
+ * Page-flip the connector's CRTC to the provided framebuffer. If
+ * `update_overlays` is set, the output's overlays are assigned overlay planes,
+ * applied with the page-flip. If the page-flip fails with overlays, it's
+ * retried without them: the frame is displayed and the overlays aren't
+ * accepted, so the compositor composites them from then on. On failure, the
+ * overlay planes' state is left unchanged.
+ */
+bool drm_connector_pageflip_overlays(struct wlr_drm_backend *drm,
+	struct wlr_drm_connector *conn, uint32_t fb_id, bool update_overlays);
+
+#endif
@@ -10,6 +10,9 @@ struct wlr_headless_backend {
 	struct wlr_backend backend;
 	struct wlr_egl egl;
 	struct wlr_renderer *renderer;
+	// Outputs use CPU framebuffers instead of EGL surfaces. The renderer is
+	// owned by the compositor.
+	bool software;
 	struct wl_display *display;
 	struct wl_list outputs;
 	size_t last_output_num;
@@ -26,6 +29,12 @@ struct wlr_headless_output {
 
 	void *egl_surface;
 	struct wl_event_source *frame_timer;
+
+	// Only used by software outputs
+	int fb_fd;
+	void *fb_data; // MAP_FAILED if unset
+	uint32_t fb_stride;
+	size_t fb_size;
 	int frame_delay; // ms
 };
 
@@ -0,0 +1,66 @@
+#ifndef BACKEND_REPLAY_H
+#define BACKEND_REPLAY_H
+
+#include <sys/types.h>
+#include <time.h>
+#include <wlr/backend/interface.h>
+#include <wlr/backend/replay.h>
+#include <wlr/types/wlr_tablet_tool.h>
+#include "util/input_trace.h"
+
+struct wlr_replay_backend {
+	struct wlr_backend backend;
+	struct wl_display *display;
+	struct wl_listener display_destroy;
+	bool started;
+
+	// The whole trace is read upfront, so that replaying doesn't do any I/O
+	uint8_t *trace;
+	size_t trace_size;
+	size_t offset; // of the next record
+	double speed;
+
+	struct timespec start;
+	struct wl_event_source *timer;
+	// Added to recorded event times to move them to the current clock
+	uint32_t time_offset_msec;
+	bool time_offset_set;
+
+	struct wl_list input_devices; // wlr_replay_input_device::link
+	struct wl_list tools; // wlr_replay_tool::link
+
+	struct wlr_replay_stats stats;
+};
+
+struct wlr_replay_input_device {
+	struct wlr_input_device wlr_input_device;
+
+	struct wlr_replay_backend *backend;
+	uint32_t id; // in the trace
+	struct wl_list link;
+};
+
+struct wlr_replay_tool {
+	struct wlr_tablet_tool wlr_tool;
+
+	uint32_t id; // in the trace
+	struct wl_list link;
+};
+
+struct wlr_replay_backend *replay_backend_from_backend(
+	struct wlr_backend *wlr_backend);
+
+/**
+ * Returns the size of the payload of a trace record, or -1 if the record type
+ * is invalid.
+ */
+ssize_t replay_record_payload_size(uint16_t type);
+/**
+ * Apply a trace record: create or destroy a device, or emit an event. The
+ * payload has been checked to have the expected size.
+ */
+void replay_apply_record(struct wlr_replay_backend *backend,
+	const struct input_trace_record *record, const void *payload);
+void replay_destroy_input_devices(struct wlr_replay_backend *backend);
+
+#endif
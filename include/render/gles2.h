@@ -14,12 +14,19 @@
 #include <wlr/render/wlr_texture.h>
 #include <wlr/util/log.h>
 
+// GLES 3 only
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+
 struct wlr_gles2_procs {
 	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 	PFNGLDEBUGMESSAGECALLBACKKHRPROC glDebugMessageCallbackKHR;
 	PFNGLDEBUGMESSAGECONTROLKHRPROC glDebugMessageControlKHR;
 	PFNGLPOPDEBUGGROUPKHRPROC glPopDebugGroupKHR;
 	PFNGLPUSHDEBUGGROUPKHRPROC glPushDebugGroupKHR;
+	PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange; // core or EXT
+	PFNGLUNMAPBUFFEROESPROC glUnmapBuffer; // core or OES
 };
 
 extern struct wlr_gles2_procs gles2_procs;
@@ -48,8 +55,12 @@ struct wlr_gles2_renderer {
 		bool read_format_bgra_ext;
 		bool debug_khr;
 		bool egl_image_external_oes;
+		bool pixel_buffer_object; // GLES 3 or GL_NV_pixel_buffer_object
 	} exts;
 
+	// Usage hint for pixel pack buffers, GLES 2 only knows about draw usages
+	GLenum pbo_usage;
+
 	struct {
 		struct {
 			GLuint program;
@@ -67,6 +78,12 @@ struct wlr_gles2_renderer {
 	} shaders;
 
 	uint32_t viewport_width, viewport_height;
+
+	// Defer texture uploads until the next wlr_renderer_begin
+	bool deferred_upload;
+	struct wl_list pending_uploads; // wlr_gles2_texture.staging.link
+
+	struct wl_list textures; // wlr_gles2_texture.link
 };
 
 struct wlr_gles2_texture {
@@ -87,6 +104,36 @@ struct wlr_gles2_texture {
 
 	// Only affects target == GL_TEXTURE_2D
 	enum wl_shm_format wl_format; // used to interpret upload data
+
+	// The renderer which created the texture, if any
+	struct wlr_gles2_renderer *renderer;
+	struct wl_list link; // wlr_gles2_renderer.textures
+	// Pixels written with deferred uploads enabled, not yet uploaded. Only the
+	// written rectangles are staged, and released once uploaded.
+	struct {
+		// Mapped pixel unpack buffer if pbo isn't zero, heap memory otherwise.
+		// NULL if nothing is staged.
+		unsigned char *data;
+		GLuint pbo;
+		size_t size, cap; // in bytes
+		struct wlr_gles2_staged_rect *rects; // in write order
+		size_t rects_len, rects_cap;
+		struct wl_list link; // wlr_gles2_renderer.pending_uploads
+	} staging;
+};
+
+struct wlr_gles2_staged_rect {
+	uint32_t x, y, width, height;
+	size_t offset; // of the tightly packed rows in the staging data
+};
+
+struct wlr_gles2_readback {
+	struct wlr_renderer_readback wlr_readback;
+	struct wlr_gles2_renderer *renderer;
+	const struct wlr_gles2_pixel_format *format;
+
+	GLuint pbo; // rows are stored bottom-up
+	int fence_fd; // -1 if native fences aren't supported
 };
 
 const struct wlr_gles2_pixel_format *get_gles2_format_from_wl(
@@ -97,6 +144,11 @@ const enum wl_shm_format *get_gles2_wl_formats(size_t *len);
 
 struct wlr_gles2_texture *gles2_get_texture(
 	struct wlr_texture *wlr_texture);
+void gles2_texture_flush_upload(struct wlr_gles2_texture *texture);
+
+struct wlr_renderer_readback *gles2_readback_create(
+	struct wlr_gles2_renderer *renderer, enum wl_shm_format fmt,
+	uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y);
 
 void push_gles2_marker(const char *file, const char *func);
 void pop_gles2_marker(void);
@@ -0,0 +1,49 @@
+#ifndef RENDER_PIXMAN_H
+#define RENDER_PIXMAN_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+
+struct wlr_pixman_pixel_format {
+	enum wl_shm_format wl_format;
+	pixman_format_code_t pixman_format;
+	int bpp;
+	bool has_alpha;
+};
+
+struct wlr_pixman_renderer {
+	struct wlr_renderer wlr_renderer;
+
+	// Buffer bound with wlr_renderer_bind_pixels, NULL if none
+	pixman_image_t *image;
+	const struct wlr_pixman_pixel_format *format;
+
+	uint32_t viewport_width, viewport_height;
+
+	// 1x1 opaque mask, used to draw transformed quads
+	pixman_image_t *unit_mask;
+};
+
+struct wlr_pixman_texture {
+	struct wlr_texture wlr_texture;
+
+	pixman_image_t *image;
+	const struct wlr_pixman_pixel_format *format;
+	int width, height;
+};
+
+const struct wlr_pixman_pixel_format *get_pixman_format_from_wl(
+	enum wl_shm_format fmt);
+const enum wl_shm_format *get_pixman_wl_formats(size_t *len);
+
+struct wlr_pixman_texture *pixman_get_texture(
+	struct wlr_texture *wlr_texture);
+struct wlr_texture *pixman_texture_from_pixels(enum wl_shm_format wl_fmt,
+	uint32_t stride, uint32_t width, uint32_t height, const void *data);
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef UTIL_INPUT_TRACE_H
+#define UTIL_INPUT_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Input traces are written by wlr_input_recorder and read by the replay
+ * backend. A trace is a header followed by records. Each record is a
+ * struct input_trace_record followed by a payload whose layout depends on
+ * the record type. Integers are stored in native byte order: traces are
+ * meant to be replayed on the machine which recorded them.
+ *
+ * The payload of every input event record with a payload starts with the
+ * event's uint32_t time_msec, as reported by the recorded device.
+ */
+
+#define INPUT_TRACE_MAGIC "WLRINPT\x01"
+#define INPUT_TRACE_NAME_LEN 64
+
+struct input_trace_header {
+	char magic[8];
+};
+
+enum input_trace_record_type {
+	INPUT_TRACE_DEVICE_ADD = 1, // input_trace_device
+	INPUT_TRACE_DEVICE_REMOVE, // no payload
+	INPUT_TRACE_TOOL_ADD, // input_trace_tool
+
+	INPUT_TRACE_POINTER_MOTION, // input_trace_pointer_motion
+	INPUT_TRACE_POINTER_MOTION_ABSOLUTE, // input_trace_position
+	INPUT_TRACE_POINTER_BUTTON, // input_trace_button
+	INPUT_TRACE_POINTER_AXIS, // input_trace_pointer_axis
+	INPUT_TRACE_POINTER_FRAME, // no payload
+	INPUT_TRACE_POINTER_SWIPE_BEGIN, // input_trace_gesture
+	INPUT_TRACE_POINTER_SWIPE_UPDATE, // input_trace_gesture
+	INPUT_TRACE_POINTER_SWIPE_END, // input_trace_gesture
+	INPUT_TRACE_POINTER_PINCH_BEGIN, // input_trace_gesture
+	INPUT_TRACE_POINTER_PINCH_UPDATE, // input_trace_gesture
+	INPUT_TRACE_POINTER_PINCH_END, // input_trace_gesture
+
+	INPUT_TRACE_KEYBOARD_KEY, // input_trace_keyboard_key
+
+	INPUT_TRACE_TOUCH_DOWN, // input_trace_position
+	INPUT_TRACE_TOUCH_UP, // input_trace_position
+	INPUT_TRACE_TOUCH_MOTION, // input_trace_position
+	INPUT_TRACE_TOUCH_CANCEL, // input_trace_position
+
+	INPUT_TRACE_TABLET_TOOL_AXIS, // input_trace_tablet_tool_axis
+	INPUT_TRACE_TABLET_TOOL_PROXIMITY, // input_trace_position
+	INPUT_TRACE_TABLET_TOOL_TIP, // input_trace_position
+	INPUT_TRACE_TABLET_TOOL_BUTTON, // input_trace_button
+};
+
+struct input_trace_record {
+	uint16_t type; // enum input_trace_record_type
+	uint16_t size; // of the payload
+	uint32_t device; // device ID, assigned by INPUT_TRACE_DEVICE_ADD
+	uint64_t time_nsec; // since the start of the recording
+};
+
+struct input_trace_device {
+	uint32_t type; // enum wlr_input_device_type
+	int32_t vendor, product;
+	char name[INPUT_TRACE_NAME_LEN]; // NUL-terminated
+};
+
+enum input_trace_tool_capability {
+	INPUT_TRACE_TOOL_TILT = 1 << 0,
+	INPUT_TRACE_TOOL_PRESSURE = 1 << 1,
+	INPUT_TRACE_TOOL_DISTANCE = 1 << 2,
+	INPUT_TRACE_TOOL_ROTATION = 1 << 3,
+	INPUT_TRACE_TOOL_SLIDER = 1 << 4,
+	INPUT_TRACE_TOOL_WHEEL = 1 << 5,
+};
+
+struct input_trace_tool {
+	uint32_t id; // referred to by tablet tool events
+	uint32_t type; // enum wlr_tablet_tool_type
+	uint64_t hardware_serial, hardware_wacom;
+	uint32_t capabilities; // enum input_trace_tool_capability
+	uint32_t pad;
+};
+
+struct input_trace_pointer_motion {
+	uint32_t time_msec;
+	uint32_t pad;
+	double delta_x, delta_y;
+	double unaccel_dx, unaccel_dy;
+};
+
+/**
+ * Used by events carrying a position and a state: absolute pointer motion,
+ * touch, tablet tool proximity and tip. Unused fields are zero.
+ */
+struct input_trace_position {
+	uint32_t time_msec;
+	int32_t id; // touch point or tablet tool ID
+	uint32_t state;
+	uint32_t pad;
+	double x, y;
+};
+
+struct input_trace_button {
+	uint32_t time_msec;
+	uint32_t tool; // tablet tool ID, zero for pointers
+	uint32_t button;
+	uint32_t state; // enum wlr_button_state
+};
+
+struct input_trace_pointer_axis {
+	uint32_t time_msec;
+	uint32_t source; // enum wlr_axis_source
+	uint32_t orientation; // enum wlr_axis_orientation
+	int32_t delta_discrete;
+	double delta;
+};
+
+/**
+ * Used by all swipe and pinch events. Unused fields are zero.
+ */
+struct input_trace_gesture {
+	uint32_t time_msec;
+	uint32_t fingers;
+	uint32_t cancelled;
+	uint32_t pad;
+	double dx, dy;
+	double scale, rotation;
+};
+
+struct input_trace_keyboard_key {
+	uint32_t time_msec;
+	uint32_t keycode;
+	uint32_t state; // enum wlr_key_state
+	uint32_t update_state;
+};
+
+struct input_trace_tablet_tool_axis {
+	uint32_t time_msec;
+	uint32_t tool;
+	uint32_t updated_axes; // enum wlr_tablet_tool_axes
+	uint32_t pad;
+	double x, y;
+	double dx, dy;
+	double pressure;
+	double distance;
+	double tilt_x, tilt_y;
+	double rotation;
+	double slider;
+	double wheel_delta;
+};
+
+#endif
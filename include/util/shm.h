@@ -1,7 +1,14 @@
 #ifndef UTIL_SHM_H
 #define UTIL_SHM_H
 
+#include <stddef.h>
+
 int create_shm_file(void);
 int allocate_shm_file(size_t size);
+/**
+ * Creates a file filled with `size` bytes from `data`, which can be shared
+ * with clients: the returned file descriptor can't be used to modify it.
+ */
+int create_readonly_shm_file(const void *data, size_t size);
 
 #endif
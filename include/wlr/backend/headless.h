@@ -20,9 +20,19 @@
 struct wlr_backend *wlr_headless_backend_create(struct wl_display *display,
 	wlr_renderer_create_func_t create_renderer_func);
 /**
- * Create a new headless output backed by an in-memory EGL framebuffer. You can
- * read pixels from this framebuffer via wlr_renderer_read_pixels but it is
- * otherwise not displayed.
+ * Creates a headless backend which doesn't use EGL. Outputs are backed by
+ * framebuffers in shared memory, `renderer` draws into them via
+ * wlr_renderer_bind_pixels. This is suitable for machines without a GPU.
+ *
+ * The renderer must outlive the backend.
+ */
+struct wlr_backend *wlr_headless_backend_create_with_renderer(
+	struct wl_display *display, struct wlr_renderer *renderer);
+/**
+ * Create a new headless output backed by an in-memory EGL framebuffer, or a
+ * shared memory framebuffer if the backend doesn't use EGL. You can read pixels
+ * from this framebuffer via wlr_renderer_read_pixels but it is otherwise not
+ * displayed.
  */
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
 	unsigned int width, unsigned int height);
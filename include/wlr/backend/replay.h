@@ -0,0 +1,53 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_BACKEND_REPLAY_H
+#define WLR_BACKEND_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/backend.h>
+#include <wlr/types/wlr_input_device.h>
+
+struct wlr_replay_stats {
+	uint64_t events; // number of events replayed so far
+	// Delay between the time an event was due and the time it was emitted,
+	// including up to 1 ms of timer granularity
+	uint64_t total_lag_nsec, max_lag_nsec;
+	bool finished; // whether the whole trace has been replayed
+};
+
+/**
+ * Creates a replay backend. The replay backend has no outputs. It creates
+ * the input devices of a trace recorded by wlr_input_recorder, and emits
+ * their events with the recorded timings once started. It's meant to be used
+ * in a multi-backend together with a backend providing outputs, e.g. the
+ * headless backend.
+ *
+ * speed scales the recorded timings: 1 replays the trace at its original
+ * speed, 2 twice as fast. If speed is zero, events are emitted as fast as
+ * the event loop allows.
+ *
+ * Event timestamps are shifted so that the first replayed event is stamped
+ * with the current CLOCK_MONOTONIC time. The intervals between timestamps
+ * are kept as recorded, whatever the speed.
+ */
+struct wlr_backend *wlr_replay_backend_create(struct wl_display *display,
+	const char *path, double speed);
+
+bool wlr_backend_is_replay(struct wlr_backend *backend);
+bool wlr_input_device_is_replay(struct wlr_input_device *device);
+
+/**
+ * Get statistics about the replay, e.g. to measure how late the compositor
+ * processes input events under load.
+ */
+void wlr_replay_backend_get_stats(struct wlr_backend *backend,
+	struct wlr_replay_stats *stats);
+
+#endif
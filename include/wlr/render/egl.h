@@ -40,6 +40,7 @@ struct wlr_egl {
 		bool image_dmabuf_import_ext;
 		bool image_dmabuf_import_modifiers_ext;
 		bool swap_buffers_with_damage;
+		bool native_fence_sync_android;
 	} exts;
 
 	struct {
@@ -56,6 +57,9 @@ struct wlr_egl {
 		PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC eglExportDMABUFImageQueryMESA;
 		PFNEGLEXPORTDMABUFIMAGEMESAPROC eglExportDMABUFImageMESA;
 		PFNEGLDEBUGMESSAGECONTROLKHRPROC eglDebugMessageControlKHR;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
 	} procs;
 
 	struct wl_display *wl_display;
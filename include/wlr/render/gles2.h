@@ -19,6 +19,16 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl);
 
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *renderer);
 
+/**
+ * Enable or disable deferred texture uploads. When enabled, pixels written to
+ * textures created by this renderer are copied to a staging buffer and only
+ * uploaded on the next wlr_renderer_begin, so that wl_surface commits don't
+ * block on the GPU and multiple commits within a frame are coalesced into a
+ * single upload.
+ */
+void wlr_gles2_renderer_set_deferred_upload(struct wlr_renderer *renderer,
+	bool deferred);
+
 struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
 	enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width, uint32_t height,
 	const void *data);
@@ -64,11 +64,28 @@ struct wlr_renderer_impl {
 	void (*destroy)(struct wlr_renderer *renderer);
 	bool (*init_wl_display)(struct wlr_renderer *renderer,
 		struct wl_display *wl_display);
+	bool (*bind_pixels)(struct wlr_renderer *renderer,
+		enum wl_shm_format fmt, uint32_t stride, uint32_t width,
+		uint32_t height, void *data);
+	struct wlr_renderer_readback *(*read_pixels_async)(
+		struct wlr_renderer *renderer, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y);
 };
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
 	const struct wlr_renderer_impl *impl);
 
+struct wlr_renderer_readback_impl {
+	int (*get_fd)(struct wlr_renderer_readback *readback);
+	bool (*finish)(struct wlr_renderer_readback *readback, uint32_t stride,
+		uint32_t dst_x, uint32_t dst_y, void *data);
+	void (*destroy)(struct wlr_renderer_readback *readback);
+};
+
+void wlr_renderer_readback_init(struct wlr_renderer_readback *readback,
+	const struct wlr_renderer_readback_impl *impl, enum wl_shm_format fmt,
+	uint32_t width, uint32_t height);
+
 struct wlr_texture_impl {
 	void (*get_size)(struct wlr_texture *texture, int *width, int *height);
 	bool (*is_opaque)(struct wlr_texture *texture);
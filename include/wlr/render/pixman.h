@@ -0,0 +1,33 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_RENDER_PIXMAN_H
+#define WLR_RENDER_PIXMAN_H
+
+#include <pixman.h>
+#include <wlr/render/wlr_renderer.h>
+
+/**
+ * Creates a software renderer based on pixman. It doesn't need a GPU.
+ *
+ * The renderer draws into buffers in CPU memory, bound with
+ * wlr_renderer_bind_pixels.
+ */
+struct wlr_renderer *wlr_pixman_renderer_create(void);
+
+bool wlr_renderer_is_pixman(struct wlr_renderer *wlr_renderer);
+bool wlr_texture_is_pixman(struct wlr_texture *texture);
+
+/**
+ * Returns the image of the buffer currently bound, or NULL if none.
+ */
+pixman_image_t *wlr_pixman_renderer_get_current_image(
+	struct wlr_renderer *wlr_renderer);
+pixman_image_t *wlr_pixman_texture_get_image(struct wlr_texture *wlr_texture);
+
+#endif
@@ -20,6 +20,7 @@ enum wlr_renderer_read_pixels_flags {
 };
 
 struct wlr_renderer_impl;
+struct wlr_renderer_readback_impl;
 struct wlr_drm_format_set;
 
 struct wlr_renderer {
@@ -27,11 +28,37 @@ struct wlr_renderer {
 
 	bool rendering;
 
+	// Released wl_shm textures kept for recycling, most recent first
+	struct wl_list texture_pool; // wlr_texture_pool_entry::link
+	size_t texture_pool_len;
+	// Empties the pool once it's been idle for a while, NULL until
+	// wlr_renderer_init_wl_display is called
+	struct wl_event_source *texture_pool_timer;
+	struct wl_listener display_destroy;
+
+	// Cursor image textures, keyed by content, most recently used first
+	struct wl_list cursor_textures; // wlr_cursor_texture_entry::link
+	size_t cursor_textures_len;
+	struct {
+		uint64_t hits, misses;
+	} cursor_texture_stats;
+
 	struct {
 		struct wl_signal destroy;
 	} events;
 };
 
+/**
+ * A read-back of pixels started with wlr_renderer_read_pixels_async, which
+ * may still be in progress on the GPU.
+ */
+struct wlr_renderer_readback {
+	const struct wlr_renderer_readback_impl *impl;
+
+	enum wl_shm_format fmt;
+	uint32_t width, height;
+};
+
 struct wlr_renderer *wlr_renderer_autocreate(struct wlr_egl *egl, EGLenum platform,
 	void *remote_display, EGLint *config_attribs, EGLint visual_id);
 
@@ -104,6 +131,41 @@ const struct wlr_drm_format_set *wlr_renderer_get_dmabuf_formats(
 bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 	uint32_t *flags, uint32_t stride, uint32_t width, uint32_t height,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
+/**
+ * Makes the renderer draw into a buffer in CPU memory. Subsequent rendering
+ * operations and wlr_renderer_read_pixels will use this buffer until another
+ * buffer is bound. Passing a NULL `data` unbinds the current buffer.
+ *
+ * Only software renderers support this, other renderers return false.
+ */
+bool wlr_renderer_bind_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
+	uint32_t stride, uint32_t width, uint32_t height, void *data);
+/**
+ * Starts reading out pixels of the currently bound surface without waiting
+ * for rendering to complete. The pixels can be retrieved with
+ * wlr_renderer_readback_finish once the read-back has completed.
+ *
+ * Returns NULL if the renderer doesn't support asynchronous read-backs, in
+ * which case wlr_renderer_read_pixels should be used instead. The read-back
+ * must be destroyed before the renderer.
+ */
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+	struct wlr_renderer *r, enum wl_shm_format fmt, uint32_t width,
+	uint32_t height, uint32_t src_x, uint32_t src_y);
+/**
+ * Get a file descriptor which becomes readable when the read-back has
+ * completed. Returns -1 if the renderer can't signal completion, in which case
+ * wlr_renderer_readback_finish may block. The file descriptor remains owned
+ * by the read-back.
+ */
+int wlr_renderer_readback_get_fd(struct wlr_renderer_readback *readback);
+/**
+ * Copies the read-back pixels into data, top row first. `stride` is in bytes.
+ * Blocks until the read-back has completed.
+ */
+bool wlr_renderer_readback_finish(struct wlr_renderer_readback *readback,
+	uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data);
+void wlr_renderer_readback_destroy(struct wlr_renderer_readback *readback);
 /**
  * Checks if a format is supported.
  */
@@ -118,7 +180,54 @@ bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
 	struct wl_display *wl_display);
 
 /**
- * Destroys this wlr_renderer. Textures must be destroyed separately.
+ * Hands a mutable texture created with wlr_texture_from_pixels back to the
+ * renderer instead of destroying it, so that a later upload with the same
+ * format and size can recycle it. `seq` is an opaque tag describing the
+ * texture contents, zero if unknown. The renderer takes ownership of the
+ * texture and may destroy it at any time.
+ *
+ * Textures are only recycled for buffers of the exact same size: resizing
+ * surfaces don't benefit from the pool. Once wlr_renderer_init_wl_display has
+ * been called, the pool is emptied when no texture has been released for a
+ * second, so that textures left over by a resize don't stay around.
+ */
+void wlr_renderer_texture_pool_release(struct wlr_renderer *r,
+	struct wlr_texture *texture, enum wl_shm_format fmt, uint64_t seq);
+/**
+ * Takes a texture with the provided format and size out of the renderer's
+ * texture pool. If `seq` is non-zero, only a texture released with this tag is
+ * returned. The caller owns the returned texture. Returns NULL if there is no
+ * such texture.
+ */
+struct wlr_texture *wlr_renderer_texture_pool_acquire(struct wlr_renderer *r,
+	enum wl_shm_format fmt, int width, int height, uint64_t seq);
+
+/**
+ * Get a texture with the provided ARGB8888 cursor image. Textures are cached
+ * by content and shared by all callers, so that switching back and forth
+ * between cursor images doesn't upload them again. The returned reference
+ * must be released with wlr_renderer_cursor_texture_unref.
+ */
+struct wlr_texture *wlr_renderer_cursor_texture_get(struct wlr_renderer *r,
+	const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height);
+/**
+ * Take another reference to a texture returned by
+ * wlr_renderer_cursor_texture_get. Returns false if the texture doesn't come
+ * from the cursor texture cache. While a reference is held, the texture is
+ * guaranteed to keep its contents.
+ */
+bool wlr_renderer_cursor_texture_ref(struct wlr_renderer *r,
+	struct wlr_texture *texture);
+/**
+ * Release a reference to a cursor texture. Unused textures stay in the cache
+ * until evicted.
+ */
+void wlr_renderer_cursor_texture_unref(struct wlr_renderer *r,
+	struct wlr_texture *texture);
+
+/**
+ * Destroys this wlr_renderer. Textures must be destroyed separately, except
+ * for the ones handed back to the texture pool.
  */
 void wlr_renderer_destroy(struct wlr_renderer *renderer);
 
@@ -11,6 +11,7 @@
 
 #include <pixman.h>
 #include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
 #include <wlr/render/dmabuf.h>
 
 struct wlr_buffer;
@@ -92,6 +93,20 @@ struct wlr_client_buffer {
 	 * client destroys the buffer before it has been released.
 	 */
 	struct wlr_texture *texture;
+	/**
+	 * Whether the texture has been created from a wl_shm buffer. In this case
+	 * the texture is mutable, uses `shm_format` and is handed back to the
+	 * renderer's texture pool when the buffer is destroyed.
+	 */
+	bool shm_texture;
+	enum wl_shm_format shm_format;
+	/**
+	 * Tag describing the texture contents, set by the consumer. It is passed
+	 * along when the texture is handed back to the texture pool.
+	 */
+	uint64_t content_seq;
+
+	struct wlr_renderer *renderer;
 
 	struct wl_listener resource_destroy;
 	struct wl_listener release;
@@ -115,13 +130,25 @@ bool wlr_resource_get_buffer_size(struct wl_resource *resource,
  */
 struct wlr_client_buffer *wlr_client_buffer_import(
 	struct wlr_renderer *renderer, struct wl_resource *resource);
+/**
+ * Import a wl_shm client buffer into a texture recycled from the renderer's
+ * texture pool and lock it. Only the `damage` region is uploaded, the caller
+ * is responsible for making sure the rest of the texture is up-to-date. The
+ * texture must have the same format and size as the buffer.
+ *
+ * Takes ownership of the texture, which is destroyed on error. Fails if the
+ * buffer isn't a wl_shm buffer.
+ */
+struct wlr_client_buffer *wlr_client_buffer_import_recycled(
+	struct wlr_renderer *renderer, struct wl_resource *resource,
+	struct wlr_texture *texture, pixman_region32_t *damage);
 /**
  * Try to update the buffer's content. On success, returns the updated buffer
  * and destroys the provided `buffer`. On error, `buffer` is intact and NULL is
  * returned.
  *
  * Fails if there's more than one reference to the buffer or if the texture
- * isn't mutable.
+ * isn't mutable. The previous wl_buffer doesn't need to be alive anymore.
  */
 struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 	struct wlr_client_buffer *buffer, struct wl_resource *resource,
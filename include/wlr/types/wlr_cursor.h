@@ -27,6 +27,7 @@
  */
 
 struct wlr_cursor_state;
+struct wlr_xcursor;
 
 struct wlr_cursor {
 	struct wlr_cursor_state *state;
@@ -142,6 +143,17 @@ void wlr_cursor_set_image(struct wlr_cursor *cur, const uint8_t *pixels,
 	int32_t stride, uint32_t width, uint32_t height, int32_t hotspot_x,
 	int32_t hotspot_y, float scale);
 
+/**
+ * Set the cursor image to an xcursor. If scale isn't zero, the image is only
+ * set on outputs having the provided scale.
+ *
+ * If the xcursor is animated, all of its images are uploaded once and the
+ * cursor flips between them on each output's frame events. The images are
+ * copied, so the xcursor can be freed once this function returns.
+ */
+void wlr_cursor_set_xcursor(struct wlr_cursor *cur,
+	struct wlr_xcursor *xcursor, float scale);
+
 /**
  * Set the cursor surface. The surface can be committed to update the cursor
  * image. The surface position is subtracted from the hotspot. A NULL surface
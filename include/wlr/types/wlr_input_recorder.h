@@ -0,0 +1,61 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_INPUT_RECORDER_H
+#define WLR_TYPES_WLR_INPUT_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_input_device.h>
+
+/**
+ * Records the events of input devices to a binary trace file, with their
+ * timestamps. Traces can be replayed with the replay backend, see
+ * wlr_replay_backend_create.
+ *
+ * Pointer, keyboard, touch and tablet tool events are recorded. Events are
+ * buffered in memory and written in large chunks, to keep the overhead on the
+ * input path low.
+ */
+struct wlr_input_recorder {
+	uint64_t events; // number of events recorded so far
+
+	// private state
+
+	FILE *file;
+	bool failed;
+	struct timespec start;
+	uint32_t last_device_id, last_tool_id;
+	struct wl_list devices; // wlr_input_recorder_device::link
+	struct wl_list tools; // wlr_input_recorder_tool::link
+};
+
+/**
+ * Create a recorder writing to the file at the provided path. The file is
+ * truncated.
+ */
+struct wlr_input_recorder *wlr_input_recorder_create(const char *path);
+/**
+ * Stop recording and write all pending events to the file.
+ */
+void wlr_input_recorder_destroy(struct wlr_input_recorder *recorder);
+/**
+ * Start recording the events of an input device. The device is
+ * automatically removed from the recorder when destroyed.
+ */
+bool wlr_input_recorder_add_device(struct wlr_input_recorder *recorder,
+	struct wlr_input_device *device);
+/**
+ * Write the pending events to the file.
+ */
+bool wlr_input_recorder_flush(struct wlr_input_recorder *recorder);
+
+#endif
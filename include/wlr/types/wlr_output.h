@@ -15,6 +15,7 @@
 #include <wayland-server-protocol.h>
 #include <wayland-util.h>
 #include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_buffer.h>
 
 struct wlr_output_mode {
@@ -46,6 +47,29 @@ struct wlr_output_cursor {
 	} events;
 };
 
+/**
+ * An overlay displays a buffer on top of the output's primary buffer, without
+ * composition. Overlays are stacked in creation order.
+ *
+ * Backends may display overlays with hardware planes. After attaching buffers
+ * to overlays, compositors can call `wlr_output_test` to find out which ones
+ * are accepted. Overlays which aren't accepted are not displayed, compositors
+ * need to render them into the primary buffer instead.
+ */
+struct wlr_output_overlay {
+	struct wlr_output *output;
+	struct wl_list link; // wlr_output.overlays, bottom to top
+
+	struct wlr_buffer *buffer; // NULL if hidden
+	struct wlr_box dst_box; // in output-buffer-local coordinates
+
+	// Whether the backend displays the overlay, updated by `wlr_output_test`
+	// and by `wlr_output_commit`
+	bool accepted;
+
+	void *data;
+};
+
 enum wlr_output_adaptive_sync_status {
 	WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED,
 	WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED,
@@ -60,6 +84,7 @@ enum wlr_output_state_field {
 	WLR_OUTPUT_STATE_SCALE = 1 << 4,
 	WLR_OUTPUT_STATE_TRANSFORM = 1 << 5,
 	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED = 1 << 6,
+	WLR_OUTPUT_STATE_OVERLAYS = 1 << 7,
 };
 
 enum wlr_output_state_buffer_type {
@@ -96,6 +121,41 @@ struct wlr_output_state {
 	} custom_mode;
 };
 
+#define WLR_OUTPUT_FRAME_TIMING_LEN 32
+
+enum wlr_output_frame_timing_state {
+	// The frame has been submitted and is waiting to be presented
+	WLR_OUTPUT_FRAME_TIMING_PENDING,
+	WLR_OUTPUT_FRAME_TIMING_PRESENTED,
+	// The frame has never been presented to the user
+	WLR_OUTPUT_FRAME_TIMING_DISCARDED,
+};
+
+/**
+ * Timing information for a single frame. Timestamps are zero if unknown.
+ * All timestamps use CLOCK_MONOTONIC, except `present` which uses the
+ * backend's presentation clock.
+ */
+struct wlr_output_frame_timing {
+	uint32_t commit_seq; // see wlr_output.commit_seq
+	enum wlr_output_frame_timing_state state;
+
+	// wlr_output_attach_render has been called
+	struct timespec render_start;
+	// wlr_output_commit has been called
+	struct timespec commit;
+	// the frame has been handed to the backend
+	struct timespec submit;
+	// the backend has been notified that the frame has been displayed
+	struct timespec flip;
+	// the frame has turned into light, as reported by the backend
+	struct timespec present;
+
+	unsigned present_seq; // vertical retrace counter, zero if unavailable
+	int present_refresh; // nsec, zero if unknown
+	uint32_t present_flags; // enum wlr_output_present_flag
+};
+
 struct wlr_output_impl;
 
 /**
@@ -146,6 +206,21 @@ struct wlr_output {
 	// Commit sequence number. Incremented on each commit, may overflow.
 	uint32_t commit_seq;
 
+	// Timing of the last frames, see wlr_output_get_frame_timings
+	struct {
+		struct wlr_output_frame_timing records[WLR_OUTPUT_FRAME_TIMING_LEN];
+		size_t len, idx; // idx is the next record to be written
+		struct timespec render_start; // of the pending frame
+		uint64_t presented, discarded;
+	} frame_timings;
+
+	// Delayed `frame` events, see wlr_output_enable_frame_delay
+	struct {
+		bool enabled;
+		bool pending; // a `frame` event is waiting for the timer
+		struct wl_event_source *timer;
+	} frame_delay;
+
 	struct {
 		// Request to render a frame
 		struct wl_signal frame;
@@ -161,6 +236,9 @@ struct wlr_output {
 		struct wl_signal commit;
 		// Emitted right after the buffer has been presented to the user
 		struct wl_signal present; // wlr_output_event_present
+		// Emitted when the timing record of a frame is complete, ie. when the
+		// frame has been presented or discarded
+		struct wl_signal frame_stats; // wlr_output_event_frame_stats
 		struct wl_signal enable;
 		struct wl_signal mode;
 		struct wl_signal scale;
@@ -178,6 +256,8 @@ struct wlr_output {
 	struct wlr_output_cursor *hardware_cursor;
 	int software_cursor_locks; // number of locks forcing software cursors
 
+	struct wl_list overlays; // wlr_output_overlay::link
+
 	struct wl_listener display_destroy;
 
 	void *data;
@@ -222,6 +302,11 @@ struct wlr_output_event_present {
 	uint32_t flags; // enum wlr_output_present_flag
 };
 
+struct wlr_output_event_frame_stats {
+	struct wlr_output *output;
+	const struct wlr_output_frame_timing *timing;
+};
+
 struct wlr_surface;
 
 /**
@@ -365,6 +450,22 @@ void wlr_output_rollback(struct wlr_output *output);
  * it is a no-op.
  */
 void wlr_output_schedule_frame(struct wlr_output *output);
+/**
+ * Enables or disables delaying `frame` events. When enabled, `frame` events
+ * are delayed so that rendering and committing finish just before the next
+ * vertical retrace, based on the duration of the last frames. This reduces
+ * latency, but frames which take longer than predicted miss the retrace.
+ *
+ * This is disabled by default.
+ */
+void wlr_output_enable_frame_delay(struct wlr_output *output, bool enabled);
+/**
+ * Copies the timing records of the most recent frames into `timings`, oldest
+ * first. At most `max` records are copied. Returns the number of records
+ * copied. The last records may still be pending.
+ */
+size_t wlr_output_get_frame_timings(struct wlr_output *output,
+	struct wlr_output_frame_timing *timings, size_t max);
 /**
  * Returns the maximum length of each gamma ramp, or 0 if unsupported.
  */
@@ -416,6 +517,14 @@ struct wlr_output_cursor *wlr_output_cursor_create(struct wlr_output *output);
 bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 	const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height,
 	int32_t hotspot_x, int32_t hotspot_y);
+/**
+ * Sets the cursor image to a texture returned by
+ * wlr_renderer_cursor_texture_get, without looking the pixels up in the
+ * renderer's cache again. The cursor takes its own reference to the texture.
+ * A NULL texture hides the cursor.
+ */
+bool wlr_output_cursor_set_texture(struct wlr_output_cursor *cursor,
+	struct wlr_texture *texture, int32_t hotspot_x, int32_t hotspot_y);
 void wlr_output_cursor_set_surface(struct wlr_output_cursor *cursor,
 	struct wlr_surface *surface, int32_t hotspot_x, int32_t hotspot_y);
 bool wlr_output_cursor_move(struct wlr_output_cursor *cursor,
@@ -423,6 +532,23 @@ bool wlr_output_cursor_move(struct wlr_output_cursor *cursor,
 void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor);
 
 
+/**
+ * Create a new overlay on top of all of the output's existing overlays.
+ */
+struct wlr_output_overlay *wlr_output_overlay_create(struct wlr_output *output);
+/**
+ * Attach a buffer to the overlay, displayed at `dst_box` in
+ * output-buffer-local coordinates. The buffer isn't scaled: the box size needs
+ * to match the buffer size. Pass a NULL buffer to hide the overlay.
+ *
+ * Overlay changes are applied along with the next frame, ie. the next
+ * successful commit with a buffer attached.
+ */
+void wlr_output_overlay_attach_buffer(struct wlr_output_overlay *overlay,
+	struct wlr_buffer *buffer, const struct wlr_box *dst_box);
+void wlr_output_overlay_destroy(struct wlr_output_overlay *overlay);
+
+
 /**
  * Returns the transform that, when composed with `tr`, gives
  * `WL_OUTPUT_TRANSFORM_NORMAL`.
@@ -17,7 +17,8 @@
 /**
  * Damage tracking requires to keep track of previous frames' damage. To allow
  * damage tracking to work with triple buffering, a history of two frames is
- * required.
+ * required. This is the default history length, deeper swapchains need a
+ * longer history (see `wlr_output_damage_set_history_len`).
  */
 #define WLR_OUTPUT_DAMAGE_PREVIOUS_LEN 2
 
@@ -35,15 +36,29 @@
 struct wlr_output_damage {
 	struct wlr_output *output;
 	int max_rects; // max number of damaged rectangles
+	// grid damage is snapped to when simplifying it, 0 to disable
+	int tile_size;
 
 	pixman_region32_t current; // in output-local coordinates
 
 	// circular queue for previous damage
-	pixman_region32_t previous[WLR_OUTPUT_DAMAGE_PREVIOUS_LEN];
+	pixman_region32_t *previous;
+	size_t previous_len;
 	size_t previous_idx;
 
+	struct {
+		uint64_t frames; // successful wlr_output_damage_attach_render calls
+		// frames which damaged the whole output because the buffer was new
+		// or older than the damage history
+		uint64_t full_damage_frames;
+		int max_buffer_age; // oldest buffer age seen so far
+	} stats;
+
 	struct {
 		struct wl_signal frame;
+		// emitted when the render damage is simplified because it has more
+		// than `max_rects` rectangles, for debugging purposes
+		struct wl_signal simplify; // wlr_output_damage_event_simplify
 		struct wl_signal destroy;
 	} events;
 
@@ -57,8 +72,26 @@ struct wlr_output_damage {
 	struct wl_listener output_commit;
 };
 
+struct wlr_output_damage_event_simplify {
+	struct wlr_output_damage *output_damage;
+	pixman_region32_t *damage; // simplified damage which will be repainted
+	int damaged_rects, redrawn_rects;
+	uint64_t damaged_pixels, redrawn_pixels;
+};
+
 struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output);
 void wlr_output_damage_destroy(struct wlr_output_damage *output_damage);
+/**
+ * Set the number of previous frames whose damage is kept. Buffers with an age
+ * up to `len + 1` can be repainted partially, older buffers are repainted
+ * entirely. Compositors using swapchains deeper than three buffers should
+ * raise this. Defaults to WLR_OUTPUT_DAMAGE_PREVIOUS_LEN.
+ *
+ * Frames recorded before the change are preserved where they fit. Returns
+ * false on allocation failure, in which case the history is left untouched.
+ */
+bool wlr_output_damage_set_history_len(struct wlr_output_damage *output_damage,
+	size_t len);
 /**
  * Attach the renderer's buffer to the output. Compositors must call this
  * function before rendering. After they are done rendering, they should call
@@ -0,0 +1,126 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_PROTOCOL_PROFILER_H
+#define WLR_TYPES_WLR_PROTOCOL_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+/**
+ * Statistics about one request of an interface, e.g. wl_surface.commit.
+ */
+struct wlr_protocol_profiler_entry {
+	const char *interface; // e.g. "wl_surface"
+	const struct wl_message *message; // the request, e.g. "commit"
+	uint64_t count;
+	uint64_t total_nsec, max_nsec;
+};
+
+struct wlr_protocol_profiler_table {
+	struct wlr_protocol_profiler_entry *entries; // hash table
+	size_t cap, len;
+};
+
+struct wlr_protocol_profiler_client {
+	struct wl_client *client;
+	uint64_t requests;
+	uint64_t total_nsec;
+	struct wl_list link; // wlr_protocol_profiler::clients
+
+	// private state
+
+	struct wlr_protocol_profiler *profiler;
+	struct wlr_protocol_profiler_table table;
+	struct wl_listener destroy;
+};
+
+/**
+ * An opt-in profiler counting the requests dispatched for each client and
+ * interface, and the time spent handling them.
+ *
+ * libwayland only notifies before a request is dispatched, so a request's
+ * handler time is measured until the next request is dispatched. The last
+ * request of a batch can only be measured until the event loop iteration
+ * ends, which includes unrelated work done during the same iteration (e.g.
+ * page-flip, frame and timer handlers). At most tail_cap_nsec of it is
+ * charged to the request, the rest is counted in unattributed_nsec.
+ *
+ * The remaining error is thus bounded by tail_cap_nsec per batch: the last
+ * request of a batch may be charged up to tail_cap_nsec of unrelated work,
+ * and handler time beyond tail_cap_nsec is only reported as unattributed.
+ */
+struct wlr_protocol_profiler {
+	struct wl_list clients; // wlr_protocol_profiler_client::link
+	uint64_t requests;
+	uint64_t total_nsec;
+	// Time spent after the last request of a batch beyond tail_cap_nsec
+	uint64_t unattributed_nsec;
+
+	// Maximum time charged to the last request of a batch, can be changed
+	// at any time. Defaults to 1 ms.
+	uint64_t tail_cap_nsec;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	// private state
+
+	struct wl_display *display;
+	struct wl_protocol_logger *logger;
+	// All clients, including disconnected ones
+	struct wlr_protocol_profiler_table table;
+	struct wl_event_source *idle;
+	struct wl_event_source *signal;
+
+	// Request being dispatched
+	struct {
+		struct wlr_protocol_profiler_client *client; // NULL if none
+		const char *interface;
+		const struct wl_message *message;
+		uint64_t start_nsec;
+	} current;
+
+	struct wl_listener display_destroy;
+};
+
+typedef void (*wlr_protocol_profiler_iterator_func_t)(
+	const struct wlr_protocol_profiler_entry *entry, void *data);
+
+/**
+ * Start profiling requests dispatched by the display.
+ */
+struct wlr_protocol_profiler *wlr_protocol_profiler_create(
+	struct wl_display *display);
+void wlr_protocol_profiler_destroy(struct wlr_protocol_profiler *profiler);
+/**
+ * Clear all statistics.
+ */
+void wlr_protocol_profiler_reset(struct wlr_protocol_profiler *profiler);
+/**
+ * Call the iterator for the statistics of each request, for the provided
+ * client or for all clients if client is NULL.
+ */
+void wlr_protocol_profiler_for_each_entry(
+	struct wlr_protocol_profiler *profiler,
+	struct wlr_protocol_profiler_client *client,
+	wlr_protocol_profiler_iterator_func_t iterator, void *data);
+/**
+ * Write the statistics to the log, the most expensive requests first.
+ */
+void wlr_protocol_profiler_dump(struct wlr_protocol_profiler *profiler);
+/**
+ * Dump the statistics each time the compositor receives the provided signal,
+ * e.g. SIGUSR2. The signal is handled through the event loop.
+ */
+bool wlr_protocol_profiler_dump_on_signal(
+	struct wlr_protocol_profiler *profiler, int signal_number);
+
+#endif
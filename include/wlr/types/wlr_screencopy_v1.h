@@ -10,6 +10,7 @@
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_box.h>
 
@@ -46,6 +47,7 @@ struct wlr_screencopy_frame_v1 {
 	bool with_damage;
 
 	struct wl_shm_buffer *buffer;
+	struct wl_resource *buffer_resource;
 	struct wl_listener buffer_destroy;
 
 	struct wlr_output *output;
@@ -53,6 +55,11 @@ struct wlr_screencopy_frame_v1 {
 	struct wl_listener output_destroy;
 	struct wl_listener output_enable;
 
+	// Asynchronous read-backs in progress, if any
+	struct wl_array readbacks; // struct screencopy_readback
+	struct wl_event_source *readback_source;
+	struct timespec readback_when;
+
 	void *data;
 };
 
@@ -165,11 +165,28 @@ struct wlr_seat_pointer_state {
 	uint32_t grab_serial;
 	uint32_t grab_time;
 
+	// If enabled, motion is held back until the end of the current batch of
+	// input events and only the last position is sent
+	bool coalesce_motion;
+	struct {
+		uint64_t motion_events;
+		uint64_t coalesced_motion_events; // never sent to the client
+	} stats;
+
 	struct wl_listener surface_destroy;
 
 	struct {
 		struct wl_signal focus_change; // wlr_seat_pointer_focus_change_event
 	} events;
+
+	// private state
+
+	struct {
+		bool motion, frame;
+		uint32_t time_msec;
+		double sx, sy;
+	} pending;
+	struct wl_event_source *flush_idle;
 };
 
 // TODO: May be useful to be able to simulate keyboard input events
@@ -390,6 +407,17 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time_msec,
  */
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat);
 
+/**
+ * Enable or disable pointer motion coalescing. When enabled, motion events are
+ * not sent right away: they are merged until the end of the current batch of
+ * input events, so that each pointer frame carries at most one motion event.
+ * Button, axis and focus changes flush pending motion first, so event ordering
+ * is preserved. Relative pointer events aren't affected and keep their exact
+ * deltas.
+ */
+void wlr_seat_pointer_set_coalesce_motion(struct wlr_seat *wlr_seat,
+		bool coalesce);
+
 /**
  * Start a grab of the pointer of this seat. The grabber is responsible for
  * handling all pointer events until the grab ends.
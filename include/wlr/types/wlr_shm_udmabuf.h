@@ -0,0 +1,65 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_SHM_UDMABUF_H
+#define WLR_TYPES_WLR_SHM_UDMABUF_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/render/dmabuf.h>
+
+/**
+ * Zero-copy import of wl_shm buffers.
+ *
+ * libwayland doesn't expose the file descriptor backing a wl_shm pool, so this
+ * helper keeps track of the pools and buffers created by clients. When a pool
+ * is a memfd sealed against shrinking, its buffers can be wrapped into
+ * DMA-BUFs with udmabuf and imported by the renderer without copying any
+ * pixel. wlr_client_buffer_import falls back to copying for all other wl_shm
+ * buffers.
+ *
+ * Zero-copy wl_shm buffers are only released when the surface stops using
+ * them, just like DMA-BUF buffers.
+ */
+struct wlr_shm_udmabuf {
+	int udmabuf_fd; // /dev/udmabuf
+	struct wl_protocol_logger *logger;
+
+	struct wl_list clients; // shm_udmabuf_client::link
+	// Clients with creation requests which haven't been dispatched yet
+	struct wl_list pending_clients; // shm_udmabuf_client::pending_link
+
+	struct wl_listener display_destroy;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+};
+
+/**
+ * Start tracking wl_shm pools for zero-copy import. Returns NULL if udmabuf
+ * isn't available.
+ */
+struct wlr_shm_udmabuf *wlr_shm_udmabuf_create(struct wl_display *display);
+
+void wlr_shm_udmabuf_destroy(struct wlr_shm_udmabuf *shm_udmabuf);
+
+/**
+ * Get DMA-BUF attributes for a wl_shm buffer resource. The returned file
+ * descriptors remain owned by the wl_shm buffer. Returns false if the buffer
+ * can't be imported without a copy.
+ */
+bool wlr_shm_udmabuf_get_dmabuf(struct wl_resource *buffer_resource,
+	struct wlr_dmabuf_attributes *attribs);
+/**
+ * Notify that the DMA-BUF returned by wlr_shm_udmabuf_get_dmabuf couldn't be
+ * imported. The DMA-BUF is released, and the buffer is copied from then on.
+ */
+void wlr_shm_udmabuf_import_failed(struct wl_resource *buffer_resource);
+
+#endif
@@ -44,6 +44,8 @@ struct wlr_surface_state {
 	struct wl_listener buffer_destroy;
 };
 
+#define WLR_SURFACE_BUFFER_HISTORY_LEN 4
+
 struct wlr_surface_role {
 	const char *name;
 	void (*commit)(struct wlr_surface *surface);
@@ -95,6 +97,27 @@ struct wlr_surface {
 	 */
 	struct wlr_surface_state current, pending, previous;
 
+	/**
+	 * Buffer damage of the last commits which attached a buffer, tagged with
+	 * the sequence number given to the texture contents at that commit. Used
+	 * to bring recycled textures up-to-date by only uploading what changed.
+	 */
+	struct {
+		uint64_t seq;
+		pixman_region32_t damage;
+	} buffer_history[WLR_SURFACE_BUFFER_HISTORY_LEN];
+	size_t buffer_history_idx;
+
+	/**
+	 * Texture upload statistics for wl_shm buffers. `upload_bytes` is what has
+	 * actually been uploaded, `full_upload_bytes` is what uploading every
+	 * committed buffer in full would have cost.
+	 */
+	struct {
+		uint64_t upload_bytes, full_upload_bytes;
+		uint64_t textures_recycled;
+	} upload_stats;
+
 	const struct wlr_surface_role *role; // the lifetime-bound role or NULL
 	void *role_data; // role-specific data
 
@@ -111,6 +134,13 @@ struct wlr_surface {
 
 	struct wl_listener renderer_destroy;
 
+	// private state
+
+	// Bounding box of the surface and all of its subsurfaces, in surface
+	// coordinates. Invalidated when the surface or a descendant commits.
+	pixman_box32_t bounds;
+	bool bounds_valid;
+
 	void *data;
 };
 
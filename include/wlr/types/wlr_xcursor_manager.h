@@ -32,6 +32,8 @@ struct wlr_xcursor_manager {
 	char *name;
 	uint32_t size;
 	struct wl_list scaled_themes; // wlr_xcursor_manager_theme::link
+	char *cache_dir; // NULL if themes aren't cached
+	bool animated; // see wlr_xcursor_manager_set_animated
 };
 
 /**
@@ -43,6 +45,21 @@ struct wlr_xcursor_manager *wlr_xcursor_manager_create(const char *name,
 
 void wlr_xcursor_manager_destroy(struct wlr_xcursor_manager *manager);
 
+/**
+ * Keep cache files of decoded cursor images in the given directory, one per
+ * theme size, so that subsequent loads don't need to decode the theme files.
+ * Only affects themes loaded afterwards.
+ */
+void wlr_xcursor_manager_set_cache_dir(struct wlr_xcursor_manager *manager,
+	const char *cache_dir);
+
+/**
+ * Play animated cursors back in wlr_xcursor_manager_set_cursor_image. Disabled
+ * by default: only the first image of animated cursors is shown.
+ */
+void wlr_xcursor_manager_set_animated(struct wlr_xcursor_manager *manager,
+	bool animated);
+
 /**
  * Ensures an xcursor theme at the given scale factor is loaded in the manager.
  */
@@ -61,7 +78,11 @@ struct wlr_xcursor *wlr_xcursor_manager_get_xcursor(
  * Set a wlr_cursor's cursor image to the specified cursor name for all scale
  * factors. wlr_cursor will take over from this point and ensure the correct
  * cursor is used on each output, assuming a wlr_output_layout is attached to
- * it.
+ * it. If enabled with wlr_xcursor_manager_set_animated, animated cursors are
+ * played back, see wlr_cursor_set_xcursor.
+ *
+ * The cursor keeps its own copy of the images: the manager can load other
+ * scales or be destroyed while the cursor image is still shown.
  */
 void wlr_xcursor_manager_set_cursor_image(struct wlr_xcursor_manager *manager,
 	const char *name, struct wlr_cursor *cursor);
@@ -50,6 +50,18 @@ void wlr_region_expand(pixman_region32_t *dst, pixman_region32_t *src,
 void wlr_region_rotated_bounds(pixman_region32_t *dst, pixman_region32_t *src,
 	float rotation, int ox, int oy);
 
+/**
+ * Simplifies a region so that it's made of at most `max_rects` rectangles,
+ * while keeping the simplified region as close as possible to the original.
+ * The result always contains the original region.
+ *
+ * If `tile_size` is positive, rectangles are first snapped outwards to a grid
+ * of `tile_size` pixels. Then, the pair of rectangles whose bounding box
+ * wastes the least area is merged until the rectangle budget is met.
+ */
+void wlr_region_simplify(pixman_region32_t *dst, pixman_region32_t *src,
+	int max_rects, int tile_size);
+
 bool wlr_region_confine(pixman_region32_t *region, double x1, double y1, double x2,
 	double y2, double *x2_out, double *y2_out);
 
@@ -42,6 +42,8 @@
 #ifndef WLR_XCURSOR_H
 #define WLR_XCURSOR_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <wlr/util/edges.h>
 
@@ -61,14 +63,29 @@ struct wlr_xcursor {
 	uint32_t total_delay; /* length of the animation in ms */
 };
 
+struct wlr_xcursor_theme_entry;
+struct wlr_xcursor_cache;
+
 /**
- * Container for an Xcursor theme.
+ * Container for an Xcursor theme. Cursors are loaded from the theme files the
+ * first time they are requested.
  */
 struct wlr_xcursor_theme {
 	unsigned int cursor_count;
-	struct wlr_xcursor **cursors;
+	struct wlr_xcursor **cursors; // cursors loaded so far
 	char *name;
 	int size;
+
+	// private state
+
+	bool lazy; // whether cursors are loaded from the theme files
+	struct wlr_xcursor_theme_entry *index; // hash table, by cursor name
+	size_t index_cap, index_len;
+
+	char *cache_path; // NULL if no cache file is used
+	struct wlr_xcursor_cache *cache;
+	int64_t stamp;
+	bool cache_dirty;
 };
 
 /**
@@ -80,10 +97,23 @@ struct wlr_xcursor_theme {
  */
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size);
 
+/**
+ * Same as wlr_xcursor_theme_load, but backed by a cache file of decoded
+ * cursor images at the given path. Cursors are read from the cache file if it
+ * is up to date. When the theme is destroyed, the cache file is rewritten if
+ * cursors had to be loaded from the theme files.
+ *
+ * Built-in cursors are used if the theme has no cursors, and for cursors
+ * missing from the theme.
+ */
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_cached(const char *name,
+	int size, const char *cache_path);
+
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme);
 
 /**
  * Obtains a wlr_xcursor image for the specified cursor name (e.g. "left_ptr").
+ * The cursor is loaded if it wasn't already.
  */
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(
 	struct wlr_xcursor_theme *theme, const char *name);
@@ -94,6 +124,14 @@ struct wlr_xcursor *wlr_xcursor_theme_get_cursor(
  */
 int wlr_xcursor_frame(struct wlr_xcursor *cursor, uint32_t time);
 
+/**
+ * Same as wlr_xcursor_frame, and also returns in duration the time in
+ * milliseconds until the next frame. duration is set to zero if the cursor
+ * isn't animated.
+ */
+int wlr_xcursor_frame_and_duration(struct wlr_xcursor *cursor, uint32_t time,
+	uint32_t *duration);
+
 /**
  * Get the name of the resize cursor image for the given edges.
  */
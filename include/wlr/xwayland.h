@@ -20,6 +20,20 @@ struct wlr_xwm;
 struct wlr_xwayland_cursor;
 struct wlr_gtk_primary_selection_device_manager;
 
+#define WLR_XWAYLAND_EVENT_TYPE_COUNT 128
+
+/**
+ * Statistics about the X11 events dispatched by the window manager.
+ */
+struct wlr_xwayland_stats {
+	// indexed by event type, without the "sent" bit
+	uint64_t events[WLR_XWAYLAND_EVENT_TYPE_COUNT];
+	// events skipped because a later event of the same batch supersedes them
+	uint64_t coalesced_events[WLR_XWAYLAND_EVENT_TYPE_COUNT];
+	// number of times the per-iteration event budget was used up
+	uint64_t budget_exhausted;
+};
+
 struct wlr_xwayland {
 	pid_t pid;
 	struct wl_client *client;
@@ -106,6 +120,7 @@ struct wlr_xwayland_surface {
 	uint32_t surface_id;
 
 	struct wl_list link;
+	struct wl_list window_link;
 	struct wl_list unpaired_link;
 
 	struct wlr_surface *surface;
@@ -223,6 +238,13 @@ void wlr_xwayland_surface_set_maximized(struct wlr_xwayland_surface *surface,
 void wlr_xwayland_surface_set_fullscreen(struct wlr_xwayland_surface *surface,
 	bool fullscreen);
 
+/**
+ * Get the X11 event statistics of the window manager. They are reset when
+ * Xwayland is restarted, and zeroed if it isn't running.
+ */
+void wlr_xwayland_get_stats(struct wlr_xwayland *wlr_xwayland,
+	struct wlr_xwayland_stats *stats);
+
 void wlr_xwayland_set_seat(struct wlr_xwayland *xwayland,
 	struct wlr_seat *seat);
 
@@ -0,0 +1,37 @@
+#ifndef XCURSOR_CACHE_H
+#define XCURSOR_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wlr/xcursor.h>
+
+/**
+ * A read-only cache file holding decoded cursor images for one theme at one
+ * size. The file is mapped in memory, cursors are copied out of it on demand.
+ */
+struct wlr_xcursor_cache;
+
+/**
+ * Open a cache file. NULL is returned if the file doesn't exist, is invalid,
+ * or was written for another size or theme stamp.
+ */
+struct wlr_xcursor_cache *xcursor_cache_open(const char *path, int size,
+	int64_t stamp);
+void xcursor_cache_destroy(struct wlr_xcursor_cache *cache);
+/**
+ * Create a cursor from its images in the cache, or return NULL if the cache
+ * doesn't contain the cursor.
+ */
+struct wlr_xcursor *xcursor_cache_get_cursor(struct wlr_xcursor_cache *cache,
+	const char *name);
+size_t xcursor_cache_get_cursor_count(struct wlr_xcursor_cache *cache);
+const char *xcursor_cache_get_cursor_name(struct wlr_xcursor_cache *cache,
+	size_t index);
+/**
+ * Write a cache file with the given cursors. The file is replaced atomically.
+ */
+bool xcursor_cache_write(const char *path, int size, int64_t stamp,
+	struct wlr_xcursor **cursors, size_t cursors_len);
+
+#endif
@@ -26,6 +26,9 @@
 #ifndef XCURSOR_H
 #define XCURSOR_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef int		XcursorBool;
 typedef unsigned int	XcursorUInt;
 
@@ -62,4 +65,10 @@ void
 xcursor_load_theme(const char *theme, int size,
 		    void (*load_callback)(XcursorImages *, void *),
 		    void *user_data);
+
+int64_t
+xcursor_theme_stamp(const char *theme);
+
+bool
+xcursor_theme_has_cursors(const char *theme);
 #endif
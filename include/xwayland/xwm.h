@@ -91,9 +91,29 @@ enum net_wm_state_action {
 	NET_WM_STATE_TOGGLE = 2,
 };
 
+/**
+ * A hash table of Xwayland surfaces, with one list per bucket. The key of an
+ * element is read with get_key from the link the element has in its bucket.
+ */
+struct xwm_surface_map {
+	struct wl_list *buckets;
+	size_t buckets_len; // a power of two
+	size_t len;
+
+	uint32_t (*get_key)(struct wl_list *link);
+};
+
+struct wlr_xwm_property_request {
+	struct wl_list link; // wlr_xwm::pending_properties
+	struct wlr_xwayland_surface *surface;
+	xcb_atom_t property;
+	xcb_get_property_cookie_t cookie;
+};
+
 struct wlr_xwm {
 	struct wlr_xwayland *xwayland;
 	struct wl_event_source *event_source;
+	struct wl_event_source *dispatch_timer; // resumes event dispatch
 	struct wlr_seat *seat;
 	uint32_t ping_timeout;
 
@@ -116,7 +136,14 @@ struct wlr_xwm {
 	struct wlr_xwayland_surface *focus_surface;
 
 	struct wl_list surfaces; // wlr_xwayland_surface::link
-	struct wl_list unpaired_surfaces; // wlr_xwayland_surface::unpaired_link
+	// wlr_xwayland_surface::window_link, by window ID
+	struct xwm_surface_map surfaces_by_window;
+	// wlr_xwayland_surface::unpaired_link, by surface ID
+	struct xwm_surface_map unpaired_surfaces;
+	// wlr_xwm_property_request::link, in request order
+	struct wl_list pending_properties;
+
+	struct wlr_xwayland_stats stats;
 
 	struct wlr_drag *drag;
 	struct wlr_xwayland_surface *drag_focus;
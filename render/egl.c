@@ -228,6 +228,15 @@ bool wlr_egl_init(struct wlr_egl *egl, EGLenum platform, void *remote_display,
 			"eglExportDMABUFImageMESA");
 	}
 
+	if (check_egl_ext(exts_str, "EGL_KHR_fence_sync") &&
+			check_egl_ext(exts_str, "EGL_ANDROID_native_fence_sync")) {
+		egl->exts.native_fence_sync_android = true;
+		load_egl_proc(&egl->procs.eglCreateSyncKHR, "eglCreateSyncKHR");
+		load_egl_proc(&egl->procs.eglDestroySyncKHR, "eglDestroySyncKHR");
+		load_egl_proc(&egl->procs.eglDupNativeFenceFDANDROID,
+			"eglDupNativeFenceFDANDROID");
+	}
+
 	if (check_egl_ext(exts_str, "EGL_WL_bind_wayland_display")) {
 		egl->exts.bind_wayland_display_wl = true;
 		load_egl_proc(&egl->procs.eglBindWaylandDisplayWL,
@@ -0,0 +1,167 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+static const struct wlr_renderer_readback_impl readback_impl;
+
+static struct wlr_gles2_readback *gles2_get_readback(
+		struct wlr_renderer_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	return (struct wlr_gles2_readback *)wlr_readback;
+}
+
+static struct wlr_gles2_readback *gles2_get_readback_in_context(
+		struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	if (!wlr_egl_is_current(readback->renderer->egl)) {
+		wlr_egl_make_current(readback->renderer->egl, EGL_NO_SURFACE, NULL);
+	}
+	return readback;
+}
+
+static int gles2_readback_get_fd(struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	return readback->fence_fd;
+}
+
+static bool gles2_readback_finish(struct wlr_renderer_readback *wlr_readback,
+		uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data) {
+	struct wlr_gles2_readback *readback =
+		gles2_get_readback_in_context(wlr_readback);
+	const struct wlr_gles2_pixel_format *fmt = readback->format;
+	uint32_t width = wlr_readback->width;
+	uint32_t height = wlr_readback->height;
+	size_t row_size = (size_t)width * fmt->bpp / 8;
+
+	PUSH_GLES2_DEBUG;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	const unsigned char *src = gles2_procs.glMapBufferRange(
+		GL_PIXEL_PACK_BUFFER_NV, 0, row_size * height, GL_MAP_READ_BIT_EXT);
+	if (src != NULL) {
+		unsigned char *dst = (unsigned char *)data +
+			(size_t)dst_y * stride + dst_x * fmt->bpp / 8;
+		for (uint32_t i = 0; i < height; ++i) {
+			memcpy(dst + (size_t)i * stride,
+				src + (size_t)(height - i - 1) * row_size, row_size);
+		}
+		gles2_procs.glUnmapBuffer(GL_PIXEL_PACK_BUFFER_NV);
+	} else {
+		wlr_log(WLR_ERROR, "Failed to map pixel pack buffer");
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	POP_GLES2_DEBUG;
+
+	return src != NULL;
+}
+
+static void gles2_readback_destroy(struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback =
+		gles2_get_readback_in_context(wlr_readback);
+
+	PUSH_GLES2_DEBUG;
+	glDeleteBuffers(1, &readback->pbo);
+	POP_GLES2_DEBUG;
+
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+	}
+	free(readback);
+}
+
+static const struct wlr_renderer_readback_impl readback_impl = {
+	.get_fd = gles2_readback_get_fd,
+	.finish = gles2_readback_finish,
+	.destroy = gles2_readback_destroy,
+};
+
+static int create_fence_fd(struct wlr_egl *egl) {
+	if (!egl->exts.native_fence_sync_android) {
+		return -1;
+	}
+
+	EGLint attribs[] = {
+		EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID,
+		EGL_NONE,
+	};
+	EGLSyncKHR sync = egl->procs.eglCreateSyncKHR(egl->display,
+		EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+	if (sync == EGL_NO_SYNC_KHR) {
+		wlr_log(WLR_ERROR, "Failed to create EGL sync");
+		return -1;
+	}
+
+	// The native fence is only created once commands are flushed
+	glFlush();
+
+	int fd = egl->procs.eglDupNativeFenceFDANDROID(egl->display, sync);
+	egl->procs.eglDestroySyncKHR(egl->display, sync);
+	if (fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+		wlr_log(WLR_ERROR, "Failed to export EGL sync as native fence");
+		return -1;
+	}
+	return fd;
+}
+
+struct wlr_renderer_readback *gles2_readback_create(
+		struct wlr_gles2_renderer *renderer, enum wl_shm_format wl_fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y) {
+	const struct wlr_gles2_pixel_format *fmt = get_gles2_format_from_wl(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return NULL;
+	}
+
+	if (fmt->gl_format == GL_BGRA_EXT && !renderer->exts.read_format_bgra_ext) {
+		wlr_log(WLR_ERROR,
+			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
+		return NULL;
+	}
+
+	struct wlr_gles2_readback *readback =
+		calloc(1, sizeof(struct wlr_gles2_readback));
+	if (readback == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_renderer_readback_init(&readback->wlr_readback, &readback_impl,
+		wl_fmt, width, height);
+	readback->renderer = renderer;
+	readback->format = fmt;
+	readback->fence_fd = -1;
+
+	PUSH_GLES2_DEBUG;
+
+	glGetError(); // Clear the error flag
+
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER_NV,
+		(GLsizeiptr)width * height * fmt->bpp / 8, NULL, renderer->pbo_usage);
+	// This only queues the copy, rows are flipped when the buffer is mapped
+	glReadPixels(src_x, renderer->viewport_height - height - src_y,
+		width, height, fmt->gl_format, fmt->gl_type, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	bool ok = glGetError() == GL_NO_ERROR;
+
+	POP_GLES2_DEBUG;
+
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to start asynchronous read-back");
+		gles2_readback_destroy(&readback->wlr_readback);
+		return NULL;
+	}
+
+	readback->fence_fd = create_fence_fd(renderer->egl);
+	return &readback->wlr_readback;
+}
@@ -36,6 +36,12 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	struct wlr_gles2_texture *texture, *tmp;
+	wl_list_for_each_safe(texture, tmp, &renderer->pending_uploads,
+			staging.link) {
+		gles2_texture_flush_upload(texture);
+	}
+
 	PUSH_GLES2_DEBUG;
 
 	glViewport(0, 0, width, height);
@@ -120,6 +126,9 @@ static bool gles2_render_texture_with_matrix(struct wlr_renderer *wlr_renderer,
 	struct wlr_gles2_texture *texture =
 		gles2_get_texture(wlr_texture);
 
+	// The texture might have been written to since wlr_renderer_begin
+	gles2_texture_flush_upload(texture);
+
 	struct wlr_gles2_tex_shader *shader = NULL;
 
 	switch (texture->target) {
@@ -280,6 +289,17 @@ static enum wl_shm_format gles2_preferred_read_format(
 	return WL_SHM_FORMAT_XBGR8888;
 }
 
+static struct wlr_renderer_readback *gles2_read_pixels_async(
+		struct wlr_renderer *wlr_renderer, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	if (!renderer->exts.pixel_buffer_object) {
+		return NULL;
+	}
+	return gles2_readback_create(renderer, fmt, width, height, src_x, src_y);
+}
+
 static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 		enum wl_shm_format wl_fmt, uint32_t *flags, uint32_t stride,
 		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
@@ -331,12 +351,39 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 	return glGetError() == GL_NO_ERROR;
 }
 
+static void gles2_texture_set_renderer(struct wlr_texture *wlr_texture,
+		struct wlr_gles2_renderer *renderer) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	texture->renderer = renderer;
+	wl_list_insert(&renderer->textures, &texture->link);
+}
+
 static struct wlr_texture *gles2_texture_from_pixels(
 		struct wlr_renderer *wlr_renderer, enum wl_shm_format wl_fmt,
 		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
-	return wlr_gles2_texture_from_pixels(renderer->egl, wl_fmt, stride, width,
-		height, data);
+	if (!renderer->deferred_upload) {
+		struct wlr_texture *wlr_texture = wlr_gles2_texture_from_pixels(
+			renderer->egl, wl_fmt, stride, width, height, data);
+		if (wlr_texture != NULL) {
+			gles2_texture_set_renderer(wlr_texture, renderer);
+		}
+		return wlr_texture;
+	}
+
+	// Only allocate the texture storage now, the pixels are staged
+	struct wlr_texture *wlr_texture = wlr_gles2_texture_from_pixels(
+		renderer->egl, wl_fmt, stride, width, height, NULL);
+	if (wlr_texture == NULL) {
+		return NULL;
+	}
+	gles2_texture_set_renderer(wlr_texture, renderer);
+	if (!wlr_texture_write_pixels(wlr_texture, stride, width, height,
+			0, 0, 0, 0, data)) {
+		wlr_texture_destroy(wlr_texture);
+		return NULL;
+	}
+	return wlr_texture;
 }
 
 static struct wlr_texture *gles2_texture_from_wl_drm(
@@ -383,11 +430,30 @@ struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *wlr_renderer) {
 	return renderer->egl;
 }
 
+void wlr_gles2_renderer_set_deferred_upload(struct wlr_renderer *wlr_renderer,
+		bool deferred) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	renderer->deferred_upload = deferred;
+}
+
 static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
 
 	wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
 
+	// Textures may outlive the renderer, upload their staged pixels while
+	// the renderer still tracks them
+	struct wlr_gles2_texture *texture, *tmp;
+	wl_list_for_each_safe(texture, tmp, &renderer->pending_uploads,
+			staging.link) {
+		gles2_texture_flush_upload(texture);
+	}
+	wl_list_for_each_safe(texture, tmp, &renderer->textures, link) {
+		wl_list_remove(&texture->link);
+		wl_list_init(&texture->link);
+		texture->renderer = NULL;
+	}
+
 	PUSH_GLES2_DEBUG;
 	glDeleteProgram(renderer->shaders.quad.program);
 	glDeleteProgram(renderer->shaders.ellipse.program);
@@ -420,6 +486,7 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.get_dmabuf_formats = gles2_get_dmabuf_formats,
 	.preferred_read_format = gles2_preferred_read_format,
 	.read_pixels = gles2_read_pixels,
+	.read_pixels_async = gles2_read_pixels_async,
 	.texture_from_pixels = gles2_texture_from_pixels,
 	.texture_from_wl_drm = gles2_texture_from_wl_drm,
 	.texture_from_dmabuf = gles2_texture_from_dmabuf,
@@ -568,6 +635,8 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 		return NULL;
 	}
 	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl);
+	wl_list_init(&renderer->pending_uploads);
+	wl_list_init(&renderer->textures);
 
 	renderer->egl = egl;
 	if (!wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL)) {
@@ -603,6 +672,22 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			"glEGLImageTargetTexture2DOES");
 	}
 
+	int gles_major = 0;
+	sscanf((const char *)glGetString(GL_VERSION), "OpenGL ES %d", &gles_major);
+	if (gles_major >= 3) {
+		renderer->exts.pixel_buffer_object = true;
+		renderer->pbo_usage = GL_STREAM_READ;
+		load_gl_proc(&gles2_procs.glMapBufferRange, "glMapBufferRange");
+		load_gl_proc(&gles2_procs.glUnmapBuffer, "glUnmapBuffer");
+	} else if (check_gl_ext(exts_str, "GL_NV_pixel_buffer_object") &&
+			check_gl_ext(exts_str, "GL_EXT_map_buffer_range") &&
+			check_gl_ext(exts_str, "GL_OES_mapbuffer")) {
+		renderer->exts.pixel_buffer_object = true;
+		renderer->pbo_usage = GL_STREAM_DRAW;
+		load_gl_proc(&gles2_procs.glMapBufferRange, "glMapBufferRangeEXT");
+		load_gl_proc(&gles2_procs.glUnmapBuffer, "glUnmapBufferOES");
+	}
+
 	if (renderer->exts.debug_khr) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -4,6 +4,7 @@
 #include <GLES2/gl2ext.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-server-protocol.h>
 #include <wayland-util.h>
 #include <wlr/render/egl.h>
@@ -47,6 +48,190 @@ static bool gles2_texture_is_opaque(struct wlr_texture *wlr_texture) {
 	return !texture->has_alpha;
 }
 
+/**
+ * Release the staging area of a texture, and take it off the pending uploads.
+ * Nothing must be staged in the buffer object if it's been unmapped.
+ */
+static void gles2_texture_finish_staging(struct wlr_gles2_texture *texture,
+		bool unmap) {
+	if (texture->staging.pbo != 0) {
+		if (unmap) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, texture->staging.pbo);
+			gles2_procs.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_NV);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, 0);
+		}
+		glDeleteBuffers(1, &texture->staging.pbo);
+	} else {
+		free(texture->staging.data);
+	}
+	free(texture->staging.rects);
+	wl_list_remove(&texture->staging.link);
+	memset(&texture->staging, 0, sizeof(texture->staging));
+}
+
+/**
+ * Allocate a staging area for `size` bytes of pixels, out of at most
+ * `max_size` for the whole texture. A pixel unpack buffer is used when
+ * available: staged pixels are then written straight into memory the GPU can
+ * upload from.
+ */
+static bool gles2_texture_begin_staging(struct wlr_gles2_texture *texture,
+		size_t size, size_t max_size) {
+	if (texture->renderer->exts.pixel_buffer_object) {
+		PUSH_GLES2_DEBUG;
+		GLuint pbo;
+		glGenBuffers(1, &pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER_NV, max_size, NULL,
+			GL_STREAM_DRAW);
+		void *data = gles2_procs.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER_NV,
+			0, max_size,
+			GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_BUFFER_BIT_EXT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, 0);
+		if (data != NULL) {
+			texture->staging.pbo = pbo;
+			texture->staging.data = data;
+			texture->staging.cap = max_size;
+		} else {
+			glDeleteBuffers(1, &pbo);
+		}
+		POP_GLES2_DEBUG;
+	}
+
+	if (texture->staging.data == NULL) {
+		texture->staging.data = malloc(size);
+		if (texture->staging.data == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate staging buffer, "
+				"uploading synchronously");
+			return false;
+		}
+		texture->staging.cap = size;
+	}
+
+	texture->staging.size = 0;
+	wl_list_insert(&texture->renderer->pending_uploads,
+		&texture->staging.link);
+	return true;
+}
+
+static bool gles2_texture_stage_pixels(struct wlr_gles2_texture *texture,
+		const struct wlr_gles2_pixel_format *fmt, uint32_t stride,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		uint32_t dst_x, uint32_t dst_y, const void *data) {
+	uint32_t bytes_per_pixel = fmt->bpp / 8;
+	size_t row_size = (size_t)width * bytes_per_pixel;
+	size_t size = row_size * height;
+	// Never stage more than a texture's worth of pixels
+	size_t max_size =
+		(size_t)texture->width * texture->height * bytes_per_pixel;
+
+	if (texture->staging.data != NULL &&
+			texture->staging.size + size > max_size) {
+		gles2_texture_flush_upload(texture);
+	}
+	if (texture->staging.data == NULL &&
+			!gles2_texture_begin_staging(texture, size, max_size)) {
+		return false;
+	}
+
+	if (texture->staging.size + size > texture->staging.cap) {
+		// Only heap memory grows, buffer objects are allocated at max_size
+		assert(texture->staging.pbo == 0);
+		size_t cap = texture->staging.cap * 2;
+		if (cap < texture->staging.size + size) {
+			cap = texture->staging.size + size;
+		}
+		if (cap > max_size) {
+			cap = max_size;
+		}
+		unsigned char *staging_data = realloc(texture->staging.data, cap);
+		if (staging_data == NULL) {
+			gles2_texture_flush_upload(texture);
+			return false;
+		}
+		texture->staging.data = staging_data;
+		texture->staging.cap = cap;
+	}
+
+	if (texture->staging.rects_len == texture->staging.rects_cap) {
+		size_t rects_cap = texture->staging.rects_cap > 0 ?
+			texture->staging.rects_cap * 2 : 4;
+		struct wlr_gles2_staged_rect *rects = realloc(texture->staging.rects,
+			rects_cap * sizeof(struct wlr_gles2_staged_rect));
+		if (rects == NULL) {
+			gles2_texture_flush_upload(texture);
+			return false;
+		}
+		texture->staging.rects = rects;
+		texture->staging.rects_cap = rects_cap;
+	}
+
+	size_t offset = texture->staging.size;
+	for (uint32_t y = 0; y < height; ++y) {
+		const unsigned char *src = (const unsigned char *)data +
+			(size_t)(src_y + y) * stride + (size_t)src_x * bytes_per_pixel;
+		memcpy(texture->staging.data + offset + y * row_size, src, row_size);
+	}
+	texture->staging.size += size;
+
+	texture->staging.rects[texture->staging.rects_len++] =
+		(struct wlr_gles2_staged_rect){
+			.x = dst_x,
+			.y = dst_y,
+			.width = width,
+			.height = height,
+			.offset = offset,
+		};
+
+	return true;
+}
+
+void gles2_texture_flush_upload(struct wlr_gles2_texture *texture) {
+	if (texture->staging.data == NULL) {
+		return;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_gles2_format_from_wl(texture->wl_format);
+	assert(fmt);
+
+	PUSH_GLES2_DEBUG;
+
+	glBindTexture(GL_TEXTURE_2D, texture->tex);
+
+	// Rectangles are uploaded in write order, later writes win
+	const unsigned char *base = texture->staging.data;
+	bool ok = true;
+	if (texture->staging.pbo != 0) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, texture->staging.pbo);
+		ok = gles2_procs.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_NV);
+		if (!ok) {
+			wlr_log(WLR_ERROR, "Staging buffer contents were lost");
+		}
+		// Pixels are read from the bound buffer object, at these offsets
+		base = NULL;
+	}
+
+	for (size_t i = 0; ok && i < texture->staging.rects_len; ++i) {
+		struct wlr_gles2_staged_rect *r = &texture->staging.rects[i];
+		const void *pixels = base != NULL ? base + r->offset :
+			(const void *)(uintptr_t)r->offset;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r->x, r->y, r->width, r->height,
+			fmt->gl_format, fmt->gl_type, pixels);
+	}
+
+	if (texture->staging.pbo != 0) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER_NV, 0);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Buffer objects are kept alive by the driver until the upload completes
+	gles2_texture_finish_staging(texture, false);
+
+	POP_GLES2_DEBUG;
+}
+
 static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 		uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
@@ -63,6 +248,15 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 		get_gles2_format_from_wl(texture->wl_format);
 	assert(fmt);
 
+	if (texture->renderer != NULL && texture->renderer->deferred_upload &&
+			gles2_texture_stage_pixels(texture, fmt, stride, width, height,
+			src_x, src_y, dst_x, dst_y, data)) {
+		return true;
+	}
+
+	// Pixels staged earlier must not override these
+	gles2_texture_flush_upload(texture);
+
 	// TODO: what if the unpack subimage extension isn't supported?
 	PUSH_GLES2_DEBUG;
 
@@ -89,6 +283,11 @@ static bool gles2_texture_to_dmabuf(struct wlr_texture *wlr_texture,
 		struct wlr_dmabuf_attributes *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
 
+	if (texture->staging.data != NULL) {
+		get_gles2_texture_in_context(wlr_texture);
+		gles2_texture_flush_upload(texture);
+	}
+
 	if (!texture->image) {
 		assert(texture->target == GL_TEXTURE_2D);
 
@@ -126,11 +325,15 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 
 	PUSH_GLES2_DEBUG;
 
+	if (texture->staging.data != NULL) {
+		gles2_texture_finish_staging(texture, true);
+	}
 	glDeleteTextures(1, &texture->tex);
 	wlr_egl_destroy_image(texture->egl, texture->image);
 
 	POP_GLES2_DEBUG;
 
+	wl_list_remove(&texture->link);
 	free(texture);
 }
 
@@ -162,6 +365,7 @@ struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
 		return NULL;
 	}
 	wlr_texture_init(&texture->wlr_texture, &texture_impl);
+	wl_list_init(&texture->link);
 	texture->egl = egl;
 	texture->width = width;
 	texture->height = height;
@@ -202,6 +406,7 @@ struct wlr_texture *wlr_gles2_texture_from_wl_drm(struct wlr_egl *egl,
 		return NULL;
 	}
 	wlr_texture_init(&texture->wlr_texture, &texture_impl);
+	wl_list_init(&texture->link);
 	texture->egl = egl;
 
 	EGLint fmt;
@@ -276,6 +481,7 @@ struct wlr_texture *wlr_gles2_texture_from_dmabuf(struct wlr_egl *egl,
 		return NULL;
 	}
 	wlr_texture_init(&texture->wlr_texture, &texture_impl);
+	wl_list_init(&texture->link);
 	texture->egl = egl;
 	texture->width = attribs->width;
 	texture->height = attribs->height;
@@ -306,6 +512,12 @@ struct wlr_texture *wlr_gles2_texture_from_dmabuf(struct wlr_egl *egl,
 void wlr_gles2_texture_get_attribs(struct wlr_texture *wlr_texture,
 		struct wlr_gles2_texture_attribs *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+
+	// The caller is about to use the texture directly
+	if (texture->staging.data != NULL) {
+		get_gles2_texture_in_context(wlr_texture);
+		gles2_texture_flush_upload(texture);
+	}
 	memset(attribs, 0, sizeof(*attribs));
 	attribs->target = texture->target;
 	attribs->tex = texture->tex;
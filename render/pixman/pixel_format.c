@@ -0,0 +1,58 @@
+#include "render/pixman.h"
+
+/*
+ * The wayland formats are little endian while the pixman formats are native
+ * endian 32-bit values, so WL_SHM_FORMAT_ARGB8888 matches PIXMAN_a8r8g8b8 on
+ * little endian machines.
+ */
+static const struct wlr_pixman_pixel_format formats[] = {
+	{
+		.wl_format = WL_SHM_FORMAT_ARGB8888,
+		.pixman_format = PIXMAN_a8r8g8b8,
+		.bpp = 32,
+		.has_alpha = true,
+	},
+	{
+		.wl_format = WL_SHM_FORMAT_XRGB8888,
+		.pixman_format = PIXMAN_x8r8g8b8,
+		.bpp = 32,
+		.has_alpha = false,
+	},
+	{
+		.wl_format = WL_SHM_FORMAT_ABGR8888,
+		.pixman_format = PIXMAN_a8b8g8r8,
+		.bpp = 32,
+		.has_alpha = true,
+	},
+	{
+		.wl_format = WL_SHM_FORMAT_XBGR8888,
+		.pixman_format = PIXMAN_x8b8g8r8,
+		.bpp = 32,
+		.has_alpha = false,
+	},
+	{
+		.wl_format = WL_SHM_FORMAT_RGB565,
+		.pixman_format = PIXMAN_r5g6b5,
+		.bpp = 16,
+		.has_alpha = false,
+	},
+};
+
+const struct wlr_pixman_pixel_format *get_pixman_format_from_wl(
+		enum wl_shm_format fmt) {
+	for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+		if (formats[i].wl_format == fmt) {
+			return &formats[i];
+		}
+	}
+	return NULL;
+}
+
+const enum wl_shm_format *get_pixman_wl_formats(size_t *len) {
+	static enum wl_shm_format wl_formats[sizeof(formats) / sizeof(formats[0])];
+	*len = sizeof(formats) / sizeof(formats[0]);
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		wl_formats[i] = formats[i].wl_format;
+	}
+	return wl_formats;
+}
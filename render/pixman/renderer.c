@@ -0,0 +1,429 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <wayland-server-protocol.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+static const struct wlr_renderer_impl renderer_impl;
+
+bool wlr_renderer_is_pixman(struct wlr_renderer *wlr_renderer) {
+	return wlr_renderer->impl == &renderer_impl;
+}
+
+static struct wlr_pixman_renderer *pixman_get_renderer(
+		struct wlr_renderer *wlr_renderer) {
+	assert(wlr_renderer_is_pixman(wlr_renderer));
+	return (struct wlr_pixman_renderer *)wlr_renderer;
+}
+
+static struct wlr_pixman_renderer *pixman_get_renderer_in_context(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = pixman_get_renderer(wlr_renderer);
+	assert(renderer->image != NULL);
+	return renderer;
+}
+
+static void color_to_pixman(const float color[static 4],
+		pixman_color_t *pixman_color) {
+	// Colors are already premultiplied
+	pixman_color->red = color[0] * 0xFFFF;
+	pixman_color->green = color[1] * 0xFFFF;
+	pixman_color->blue = color[2] * 0xFFFF;
+	pixman_color->alpha = color[3] * 0xFFFF;
+}
+
+/**
+ * Computes the transform from a source of the given size to the render
+ * buffer. `matrix` maps the unit square to normalized device coordinates, as
+ * for the GLES2 renderer.
+ */
+static void get_source_transform(struct wlr_pixman_renderer *renderer,
+		const float matrix[static 9], int src_width, int src_height,
+		struct pixman_f_transform *transform) {
+	struct pixman_f_transform src_to_unit = {{
+		{ 1.0 / src_width, 0, 0 },
+		{ 0, 1.0 / src_height, 0 },
+		{ 0, 0, 1 },
+	}};
+	struct pixman_f_transform unit_to_ndc = {{
+		{ matrix[0], matrix[1], matrix[2] },
+		{ matrix[3], matrix[4], matrix[5] },
+		{ matrix[6], matrix[7], matrix[8] },
+	}};
+	double w = renderer->viewport_width, h = renderer->viewport_height;
+	struct pixman_f_transform ndc_to_buffer = {{
+		{ w / 2, 0, w / 2 },
+		{ 0, -h / 2, h / 2 },
+		{ 0, 0, 1 },
+	}};
+
+	struct pixman_f_transform src_to_ndc;
+	pixman_f_transform_multiply(&src_to_ndc, &unit_to_ndc, &src_to_unit);
+	pixman_f_transform_multiply(transform, &ndc_to_buffer, &src_to_ndc);
+}
+
+/**
+ * Computes the render buffer area covered by a transformed source, clipped to
+ * the viewport. Returns false if the area is empty.
+ */
+static bool get_dest_box(struct wlr_pixman_renderer *renderer,
+		const struct pixman_f_transform *transform, int src_width,
+		int src_height, pixman_box32_t *box) {
+	double x1 = INFINITY, y1 = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+	const double corners[4][2] = {
+		{ 0, 0 },
+		{ src_width, 0 },
+		{ 0, src_height },
+		{ src_width, src_height },
+	};
+	for (size_t i = 0; i < 4; ++i) {
+		double v[3] = { corners[i][0], corners[i][1], 1 };
+		if (!pixman_f_transform_point(transform, v)) {
+			return false;
+		}
+		x1 = fmin(x1, v[0]);
+		y1 = fmin(y1, v[1]);
+		x2 = fmax(x2, v[0]);
+		y2 = fmax(y2, v[1]);
+	}
+
+	box->x1 = fmax(floor(x1), 0);
+	box->y1 = fmax(floor(y1), 0);
+	box->x2 = fmin(ceil(x2), renderer->viewport_width);
+	box->y2 = fmin(ceil(y2), renderer->viewport_height);
+	return box->x1 < box->x2 && box->y1 < box->y2;
+}
+
+static bool is_axis_aligned(const struct pixman_f_transform *t) {
+	return t->m[0][1] == 0 && t->m[1][0] == 0 &&
+		t->m[2][0] == 0 && t->m[2][1] == 0 && t->m[2][2] == 1;
+}
+
+static bool is_integer_translation(const struct pixman_f_transform *t) {
+	return is_axis_aligned(t) && t->m[0][0] == 1 && t->m[1][1] == 1 &&
+		t->m[0][2] == floor(t->m[0][2]) && t->m[1][2] == floor(t->m[1][2]);
+}
+
+/**
+ * Sets up `image` to be sampled at render buffer coordinates. Returns false
+ * if the transform isn't invertible.
+ */
+static bool set_image_transform(pixman_image_t *image,
+		const struct pixman_f_transform *transform, pixman_filter_t filter) {
+	struct pixman_f_transform inverse;
+	if (!pixman_f_transform_invert(&inverse, transform)) {
+		return false;
+	}
+
+	struct pixman_transform fixed;
+	if (!pixman_transform_from_pixman_f_transform(&fixed, &inverse)) {
+		return false;
+	}
+	pixman_image_set_transform(image, &fixed);
+	pixman_image_set_filter(image, filter, NULL, 0);
+	return true;
+}
+
+static void pixman_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
+		uint32_t height) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	renderer->viewport_width = width;
+	renderer->viewport_height = height;
+	pixman_image_set_clip_region32(renderer->image, NULL);
+}
+
+static void pixman_clear(struct wlr_renderer *wlr_renderer,
+		const float color[static 4]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	pixman_color_t pixman_color;
+	color_to_pixman(color, &pixman_color);
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+
+	// Compositing honors the scissor box
+	pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, renderer->image,
+		0, 0, 0, 0, 0, 0, renderer->viewport_width, renderer->viewport_height);
+
+	pixman_image_unref(src);
+}
+
+static void pixman_scissor(struct wlr_renderer *wlr_renderer,
+		struct wlr_box *box) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	if (box != NULL) {
+		pixman_region32_t region;
+		pixman_region32_init_rect(&region, box->x, box->y,
+			box->width, box->height);
+		pixman_image_set_clip_region32(renderer->image, &region);
+		pixman_region32_fini(&region);
+	} else {
+		pixman_image_set_clip_region32(renderer->image, NULL);
+	}
+}
+
+static bool pixman_render_texture_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const float matrix[static 9], float alpha) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+
+	struct pixman_f_transform transform;
+	get_source_transform(renderer, matrix, texture->width, texture->height,
+		&transform);
+
+	pixman_box32_t box;
+	if (!get_dest_box(renderer, &transform, texture->width, texture->height,
+			&box)) {
+		return true;
+	}
+
+	// Nearest sampling is exact and much faster for untransformed textures
+	pixman_filter_t filter = is_integer_translation(&transform) ?
+		PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR;
+	if (!set_image_transform(texture->image, &transform, filter)) {
+		wlr_log(WLR_ERROR, "Failed to render texture: invalid matrix");
+		return false;
+	}
+	// Clamp to the edges like GL does, instead of blending with transparent
+	// pixels
+	pixman_image_set_repeat(texture->image, is_axis_aligned(&transform) ?
+		PIXMAN_REPEAT_PAD : PIXMAN_REPEAT_NONE);
+
+	pixman_image_t *mask = NULL;
+	if (alpha < 1) {
+		pixman_color_t mask_color = { .alpha = alpha * 0xFFFF };
+		mask = pixman_image_create_solid_fill(&mask_color);
+	}
+
+	// The source transform uses render buffer coordinates
+	pixman_image_composite32(PIXMAN_OP_OVER, texture->image, mask,
+		renderer->image, box.x1, box.y1, 0, 0, box.x1, box.y1,
+		box.x2 - box.x1, box.y2 - box.y1);
+
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	pixman_image_set_transform(texture->image, NULL);
+	return true;
+}
+
+static void pixman_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
+		const float color[static 4], const float matrix[static 9]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	struct pixman_f_transform transform;
+	get_source_transform(renderer, matrix, 1, 1, &transform);
+
+	pixman_box32_t box;
+	// Bilinear filtering would fade the whole quad, not only its edges
+	if (!get_dest_box(renderer, &transform, 1, 1, &box) ||
+			!set_image_transform(renderer->unit_mask, &transform,
+				PIXMAN_FILTER_NEAREST)) {
+		return;
+	}
+
+	pixman_color_t pixman_color;
+	color_to_pixman(color, &pixman_color);
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+
+	pixman_image_composite32(PIXMAN_OP_OVER, src, renderer->unit_mask,
+		renderer->image, 0, 0, box.x1, box.y1, box.x1, box.y1,
+		box.x2 - box.x1, box.y2 - box.y1);
+
+	pixman_image_unref(src);
+}
+
+static void pixman_render_ellipse_with_matrix(
+		struct wlr_renderer *wlr_renderer, const float color[static 4],
+		const float matrix[static 9]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	struct pixman_f_transform transform, inverse;
+	get_source_transform(renderer, matrix, 1, 1, &transform);
+
+	pixman_box32_t box;
+	if (!get_dest_box(renderer, &transform, 1, 1, &box) ||
+			!pixman_f_transform_invert(&inverse, &transform)) {
+		return;
+	}
+
+	int width = box.x2 - box.x1, height = box.y2 - box.y1;
+	pixman_image_t *mask =
+		pixman_image_create_bits(PIXMAN_a8, width, height, NULL, 0);
+	if (mask == NULL) {
+		return;
+	}
+
+	// Rasterize the ellipse inscribed in the unit square
+	uint8_t *data = (uint8_t *)pixman_image_get_data(mask);
+	int stride = pixman_image_get_stride(mask);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			double v[3] = { box.x1 + x + 0.5, box.y1 + y + 0.5, 1 };
+			pixman_f_transform_point(&inverse, v);
+			double dx = v[0] - 0.5, dy = v[1] - 0.5;
+			if (dx * dx + dy * dy <= 0.25) {
+				data[y * stride + x] = 0xFF;
+			}
+		}
+	}
+
+	pixman_color_t pixman_color;
+	color_to_pixman(color, &pixman_color);
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+
+	pixman_image_composite32(PIXMAN_OP_OVER, src, mask, renderer->image,
+		0, 0, 0, 0, box.x1, box.y1, width, height);
+
+	pixman_image_unref(src);
+	pixman_image_unref(mask);
+}
+
+static const enum wl_shm_format *pixman_renderer_formats(
+		struct wlr_renderer *wlr_renderer, size_t *len) {
+	return get_pixman_wl_formats(len);
+}
+
+static bool pixman_format_supported(struct wlr_renderer *wlr_renderer,
+		enum wl_shm_format wl_fmt) {
+	return get_pixman_format_from_wl(wl_fmt) != NULL;
+}
+
+static enum wl_shm_format pixman_preferred_read_format(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = pixman_get_renderer(wlr_renderer);
+	if (renderer->format != NULL) {
+		return renderer->format->wl_format;
+	}
+	return WL_SHM_FORMAT_XRGB8888;
+}
+
+static bool pixman_read_pixels(struct wlr_renderer *wlr_renderer,
+		enum wl_shm_format wl_fmt, uint32_t *flags, uint32_t stride,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		uint32_t dst_x, uint32_t dst_y, void *data) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_get_renderer_in_context(wlr_renderer);
+
+	const struct wlr_pixman_pixel_format *fmt =
+		get_pixman_format_from_wl(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return false;
+	}
+
+	pixman_image_t *dst = pixman_image_create_bits_no_clear(
+		fmt->pixman_format, dst_x + width, dst_y + height, data, stride);
+	if (dst == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: failed to create image");
+		return false;
+	}
+
+	pixman_image_composite32(PIXMAN_OP_SRC, renderer->image, NULL, dst,
+		src_x, src_y, 0, 0, dst_x, dst_y, width, height);
+	pixman_image_unref(dst);
+
+	if (flags != NULL) {
+		*flags = 0;
+	}
+	return true;
+}
+
+static struct wlr_texture *pixman_texture_from_pixels_impl(
+		struct wlr_renderer *wlr_renderer, enum wl_shm_format wl_fmt,
+		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
+	return pixman_texture_from_pixels(wl_fmt, stride, width, height, data);
+}
+
+static bool pixman_bind_pixels(struct wlr_renderer *wlr_renderer,
+		enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width,
+		uint32_t height, void *data) {
+	struct wlr_pixman_renderer *renderer = pixman_get_renderer(wlr_renderer);
+
+	if (renderer->image != NULL) {
+		pixman_image_unref(renderer->image);
+		renderer->image = NULL;
+		renderer->format = NULL;
+	}
+
+	if (data == NULL) {
+		return true;
+	}
+
+	const struct wlr_pixman_pixel_format *fmt =
+		get_pixman_format_from_wl(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot bind buffer: unsupported pixel format");
+		return false;
+	}
+
+	renderer->image = pixman_image_create_bits_no_clear(fmt->pixman_format,
+		width, height, data, stride);
+	if (renderer->image == NULL) {
+		wlr_log(WLR_ERROR, "Cannot bind buffer: failed to create image");
+		return false;
+	}
+	renderer->format = fmt;
+	return true;
+}
+
+static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = pixman_get_renderer(wlr_renderer);
+	if (renderer->image != NULL) {
+		pixman_image_unref(renderer->image);
+	}
+	pixman_image_unref(renderer->unit_mask);
+	free(renderer);
+}
+
+static const struct wlr_renderer_impl renderer_impl = {
+	.destroy = pixman_destroy,
+	.begin = pixman_begin,
+	.clear = pixman_clear,
+	.scissor = pixman_scissor,
+	.render_texture_with_matrix = pixman_render_texture_with_matrix,
+	.render_quad_with_matrix = pixman_render_quad_with_matrix,
+	.render_ellipse_with_matrix = pixman_render_ellipse_with_matrix,
+	.formats = pixman_renderer_formats,
+	.format_supported = pixman_format_supported,
+	.preferred_read_format = pixman_preferred_read_format,
+	.read_pixels = pixman_read_pixels,
+	.texture_from_pixels = pixman_texture_from_pixels_impl,
+	.bind_pixels = pixman_bind_pixels,
+};
+
+struct wlr_renderer *wlr_pixman_renderer_create(void) {
+	struct wlr_pixman_renderer *renderer =
+		calloc(1, sizeof(struct wlr_pixman_renderer));
+	if (renderer == NULL) {
+		return NULL;
+	}
+	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl);
+
+	renderer->unit_mask = pixman_image_create_bits(PIXMAN_a8, 1, 1, NULL, 0);
+	if (renderer->unit_mask == NULL) {
+		free(renderer);
+		return NULL;
+	}
+	*(uint8_t *)pixman_image_get_data(renderer->unit_mask) = 0xFF;
+
+	return &renderer->wlr_renderer;
+}
+
+pixman_image_t *wlr_pixman_renderer_get_current_image(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = pixman_get_renderer(wlr_renderer);
+	return renderer->image;
+}
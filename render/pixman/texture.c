@@ -0,0 +1,118 @@
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+static const struct wlr_texture_impl texture_impl;
+
+bool wlr_texture_is_pixman(struct wlr_texture *wlr_texture) {
+	return wlr_texture->impl == &texture_impl;
+}
+
+struct wlr_pixman_texture *pixman_get_texture(
+		struct wlr_texture *wlr_texture) {
+	assert(wlr_texture_is_pixman(wlr_texture));
+	return (struct wlr_pixman_texture *)wlr_texture;
+}
+
+static void pixman_texture_get_size(struct wlr_texture *wlr_texture,
+		int *width, int *height) {
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+	*width = texture->width;
+	*height = texture->height;
+}
+
+static bool pixman_texture_is_opaque(struct wlr_texture *wlr_texture) {
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+	return !texture->format->has_alpha;
+}
+
+static bool pixman_texture_write_pixels(struct wlr_texture *wlr_texture,
+		uint32_t stride, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
+		const void *data) {
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+
+	if (dst_x + width > (uint32_t)texture->width ||
+			dst_y + height > (uint32_t)texture->height) {
+		wlr_log(WLR_ERROR, "Cannot write pixels: out of bounds");
+		return false;
+	}
+
+	uint32_t bytes_per_pixel = texture->format->bpp / 8;
+	uint32_t dst_stride = pixman_image_get_stride(texture->image);
+	unsigned char *dst = (unsigned char *)pixman_image_get_data(texture->image);
+	const unsigned char *src = data;
+
+	size_t row_size = (size_t)width * bytes_per_pixel;
+	for (uint32_t i = 0; i < height; ++i) {
+		memcpy(dst + (size_t)(dst_y + i) * dst_stride + dst_x * bytes_per_pixel,
+			src + (size_t)(src_y + i) * stride + src_x * bytes_per_pixel,
+			row_size);
+	}
+
+	return true;
+}
+
+static void pixman_texture_destroy(struct wlr_texture *wlr_texture) {
+	if (wlr_texture == NULL) {
+		return;
+	}
+
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+	pixman_image_unref(texture->image);
+	free(texture);
+}
+
+static const struct wlr_texture_impl texture_impl = {
+	.get_size = pixman_texture_get_size,
+	.is_opaque = pixman_texture_is_opaque,
+	.write_pixels = pixman_texture_write_pixels,
+	.destroy = pixman_texture_destroy,
+};
+
+struct wlr_texture *pixman_texture_from_pixels(enum wl_shm_format wl_fmt,
+		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
+	const struct wlr_pixman_pixel_format *fmt =
+		get_pixman_format_from_wl(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Unsupported pixel format %"PRIu32, wl_fmt);
+		return NULL;
+	}
+
+	struct wlr_pixman_texture *texture =
+		calloc(1, sizeof(struct wlr_pixman_texture));
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_init(&texture->wlr_texture, &texture_impl);
+	texture->width = width;
+	texture->height = height;
+	texture->format = fmt;
+
+	// Let pixman allocate the pixels, so that rows are suitably aligned
+	texture->image = pixman_image_create_bits_no_clear(fmt->pixman_format,
+		width, height, NULL, 0);
+	if (texture->image == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		free(texture);
+		return NULL;
+	}
+
+	if (data != NULL) {
+		pixman_texture_write_pixels(&texture->wlr_texture, stride, width,
+			height, 0, 0, 0, 0, data);
+	}
+
+	return &texture->wlr_texture;
+}
+
+pixman_image_t *wlr_pixman_texture_get_image(struct wlr_texture *wlr_texture) {
+	struct wlr_pixman_texture *texture = pixman_get_texture(wlr_texture);
+	return texture->image;
+}
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/render/gles2.h>
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_renderer.h>
@@ -8,6 +9,53 @@
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
+#define TEXTURE_POOL_CAPACITY 4
+#define TEXTURE_POOL_IDLE_TIMEOUT_MS 1000
+#define CURSOR_TEXTURE_CACHE_CAPACITY 16
+
+struct wlr_cursor_texture_entry {
+	struct wlr_texture *texture;
+	uint32_t width, height;
+	uint64_t hash;
+	uint8_t *pixels; // packed copy of the image, to tell collisions apart
+	int refs;
+
+	struct wl_list link; // wlr_renderer::cursor_textures
+};
+
+struct wlr_texture_pool_entry {
+	struct wlr_texture *texture;
+	enum wl_shm_format fmt;
+	int width, height;
+	uint64_t seq;
+
+	struct wl_list link; // wlr_renderer::texture_pool
+};
+
+static void texture_pool_entry_destroy(struct wlr_texture_pool_entry *entry,
+		struct wlr_renderer *r) {
+	wl_list_remove(&entry->link);
+	r->texture_pool_len--;
+	free(entry);
+}
+
+static void texture_pool_clear(struct wlr_renderer *r) {
+	struct wlr_texture_pool_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &r->texture_pool, link) {
+		wlr_texture_destroy(entry->texture);
+		texture_pool_entry_destroy(entry, r);
+	}
+}
+
+static void cursor_texture_entry_destroy(
+		struct wlr_cursor_texture_entry *entry, struct wlr_renderer *r) {
+	wlr_texture_destroy(entry->texture);
+	wl_list_remove(&entry->link);
+	r->cursor_textures_len--;
+	free(entry->pixels);
+	free(entry);
+}
+
 void wlr_renderer_init(struct wlr_renderer *renderer,
 		const struct wlr_renderer_impl *impl) {
 	assert(impl->begin);
@@ -21,6 +69,10 @@ void wlr_renderer_init(struct wlr_renderer *renderer,
 	assert(impl->texture_from_pixels);
 	renderer->impl = impl;
 
+	wl_list_init(&renderer->texture_pool);
+	renderer->texture_pool_timer = NULL;
+	wl_list_init(&renderer->display_destroy.link);
+	wl_list_init(&renderer->cursor_textures);
 	wl_signal_init(&renderer->events.destroy);
 }
 
@@ -30,6 +82,17 @@ void wlr_renderer_destroy(struct wlr_renderer *r) {
 	}
 	wlr_signal_emit_safe(&r->events.destroy, r);
 
+	texture_pool_clear(r);
+	if (r->texture_pool_timer != NULL) {
+		wl_event_source_remove(r->texture_pool_timer);
+	}
+	wl_list_remove(&r->display_destroy.link);
+
+	struct wlr_cursor_texture_entry *cursor_entry, *cursor_tmp;
+	wl_list_for_each_safe(cursor_entry, cursor_tmp, &r->cursor_textures, link) {
+		cursor_texture_entry_destroy(cursor_entry, r);
+	}
+
 	if (r->impl && r->impl->destroy) {
 		r->impl->destroy(r);
 	} else {
@@ -154,11 +217,125 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 		src_x, src_y, dst_x, dst_y, data);
 }
 
+bool wlr_renderer_bind_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
+		uint32_t stride, uint32_t width, uint32_t height, void *data) {
+	if (!r->impl->bind_pixels) {
+		return false;
+	}
+	return r->impl->bind_pixels(r, fmt, stride, width, height, data);
+}
+
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+		struct wlr_renderer *r, enum wl_shm_format fmt, uint32_t width,
+		uint32_t height, uint32_t src_x, uint32_t src_y) {
+	if (!r->impl->read_pixels_async) {
+		return NULL;
+	}
+	return r->impl->read_pixels_async(r, fmt, width, height, src_x, src_y);
+}
+
+void wlr_renderer_readback_init(struct wlr_renderer_readback *readback,
+		const struct wlr_renderer_readback_impl *impl, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height) {
+	assert(impl->finish);
+	assert(impl->destroy);
+	readback->impl = impl;
+	readback->fmt = fmt;
+	readback->width = width;
+	readback->height = height;
+}
+
+int wlr_renderer_readback_get_fd(struct wlr_renderer_readback *readback) {
+	if (!readback->impl->get_fd) {
+		return -1;
+	}
+	return readback->impl->get_fd(readback);
+}
+
+bool wlr_renderer_readback_finish(struct wlr_renderer_readback *readback,
+		uint32_t stride, uint32_t dst_x, uint32_t dst_y, void *data) {
+	return readback->impl->finish(readback, stride, dst_x, dst_y, data);
+}
+
+void wlr_renderer_readback_destroy(struct wlr_renderer_readback *readback) {
+	if (readback == NULL) {
+		return;
+	}
+	readback->impl->destroy(readback);
+}
+
 bool wlr_renderer_format_supported(struct wlr_renderer *r,
 		enum wl_shm_format fmt) {
 	return r->impl->format_supported(r, fmt);
 }
 
+void wlr_renderer_texture_pool_release(struct wlr_renderer *r,
+		struct wlr_texture *texture, enum wl_shm_format fmt, uint64_t seq) {
+	if (texture == NULL) {
+		return;
+	}
+
+	struct wlr_texture_pool_entry *entry =
+		calloc(1, sizeof(struct wlr_texture_pool_entry));
+	if (entry == NULL) {
+		wlr_texture_destroy(texture);
+		return;
+	}
+	entry->texture = texture;
+	entry->fmt = fmt;
+	entry->seq = seq;
+	wlr_texture_get_size(texture, &entry->width, &entry->height);
+
+	wl_list_insert(&r->texture_pool, &entry->link);
+	r->texture_pool_len++;
+
+	if (r->texture_pool_len > TEXTURE_POOL_CAPACITY) {
+		// Evict the least recently released texture
+		struct wlr_texture_pool_entry *last =
+			wl_container_of(r->texture_pool.prev, last, link);
+		wlr_texture_destroy(last->texture);
+		texture_pool_entry_destroy(last, r);
+	}
+
+	if (r->texture_pool_timer != NULL) {
+		wl_event_source_timer_update(r->texture_pool_timer,
+			TEXTURE_POOL_IDLE_TIMEOUT_MS);
+	}
+}
+
+struct wlr_texture *wlr_renderer_texture_pool_acquire(struct wlr_renderer *r,
+		enum wl_shm_format fmt, int width, int height, uint64_t seq) {
+	struct wlr_texture_pool_entry *entry;
+	wl_list_for_each(entry, &r->texture_pool, link) {
+		if (entry->fmt != fmt || entry->width != width ||
+				entry->height != height) {
+			continue;
+		}
+		if (seq != 0 && entry->seq != seq) {
+			continue;
+		}
+
+		struct wlr_texture *texture = entry->texture;
+		texture_pool_entry_destroy(entry, r);
+		return texture;
+	}
+	return NULL;
+}
+
+static int handle_texture_pool_timer(void *data) {
+	struct wlr_renderer *r = data;
+	texture_pool_clear(r);
+	return 0;
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_renderer *r = wl_container_of(listener, r, display_destroy);
+	wl_event_source_remove(r->texture_pool_timer);
+	r->texture_pool_timer = NULL;
+	wl_list_remove(&r->display_destroy.link);
+	wl_list_init(&r->display_destroy.link);
+}
+
 bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
 		struct wl_display *wl_display) {
 	if (wl_display_init_shm(wl_display)) {
@@ -187,6 +364,16 @@ bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
 		}
 	}
 
+	if (r->texture_pool_timer == NULL) {
+		struct wl_event_loop *loop = wl_display_get_event_loop(wl_display);
+		r->texture_pool_timer =
+			wl_event_loop_add_timer(loop, handle_texture_pool_timer, r);
+		if (r->texture_pool_timer != NULL) {
+			r->display_destroy.notify = handle_display_destroy;
+			wl_display_add_destroy_listener(wl_display, &r->display_destroy);
+		}
+	}
+
 	return true;
 }
 
@@ -228,3 +415,126 @@ struct wlr_renderer *wlr_renderer_autocreate(struct wlr_egl *egl,
 
 	return renderer;
 }
+
+static void cursor_texture_cache_evict(struct wlr_renderer *r) {
+	// Evict the least recently used textures which aren't in use
+	struct wlr_cursor_texture_entry *entry, *tmp;
+	wl_list_for_each_reverse_safe(entry, tmp, &r->cursor_textures, link) {
+		if (r->cursor_textures_len <= CURSOR_TEXTURE_CACHE_CAPACITY) {
+			break;
+		}
+		if (entry->refs == 0) {
+			cursor_texture_entry_destroy(entry, r);
+		}
+	}
+}
+
+static struct wlr_cursor_texture_entry *cursor_texture_entry_from_texture(
+		struct wlr_renderer *r, struct wlr_texture *texture) {
+	struct wlr_cursor_texture_entry *entry;
+	wl_list_for_each(entry, &r->cursor_textures, link) {
+		if (entry->texture == texture) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+struct wlr_texture *wlr_renderer_cursor_texture_get(struct wlr_renderer *r,
+		const uint8_t *pixels, int32_t stride, uint32_t width,
+		uint32_t height) {
+	size_t row_size = (size_t)width * 4;
+
+	// FNV-1a
+	uint64_t hash = 14695981039346656037u;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + (size_t)y * stride;
+		for (size_t x = 0; x < row_size; x++) {
+			hash ^= row[x];
+			hash *= 1099511628211u;
+		}
+	}
+
+	struct wlr_cursor_texture_entry *entry;
+	wl_list_for_each(entry, &r->cursor_textures, link) {
+		if (entry->hash != hash || entry->width != width ||
+				entry->height != height) {
+			continue;
+		}
+
+		bool equal = true;
+		for (uint32_t y = 0; y < height && equal; y++) {
+			equal = memcmp(entry->pixels + y * row_size,
+				pixels + (size_t)y * stride, row_size) == 0;
+		}
+		if (!equal) {
+			continue;
+		}
+
+		wl_list_remove(&entry->link);
+		wl_list_insert(&r->cursor_textures, &entry->link);
+		entry->refs++;
+		r->cursor_texture_stats.hits++;
+		return entry->texture;
+	}
+
+	r->cursor_texture_stats.misses++;
+
+	entry = calloc(1, sizeof(struct wlr_cursor_texture_entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+	entry->pixels = malloc(row_size * height);
+	if (entry->pixels == NULL) {
+		free(entry);
+		return NULL;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(entry->pixels + y * row_size, pixels + (size_t)y * stride,
+			row_size);
+	}
+
+	entry->texture = wlr_texture_from_pixels(r, WL_SHM_FORMAT_ARGB8888,
+		stride, width, height, pixels);
+	if (entry->texture == NULL) {
+		free(entry->pixels);
+		free(entry);
+		return NULL;
+	}
+	entry->width = width;
+	entry->height = height;
+	entry->hash = hash;
+	entry->refs = 1;
+
+	wl_list_insert(&r->cursor_textures, &entry->link);
+	r->cursor_textures_len++;
+	cursor_texture_cache_evict(r);
+
+	return entry->texture;
+}
+
+bool wlr_renderer_cursor_texture_ref(struct wlr_renderer *r,
+		struct wlr_texture *texture) {
+	struct wlr_cursor_texture_entry *entry =
+		cursor_texture_entry_from_texture(r, texture);
+	if (entry == NULL) {
+		return false;
+	}
+	entry->refs++;
+	return true;
+}
+
+void wlr_renderer_cursor_texture_unref(struct wlr_renderer *r,
+		struct wlr_texture *texture) {
+	if (texture == NULL) {
+		return;
+	}
+
+	struct wlr_cursor_texture_entry *entry =
+		cursor_texture_entry_from_texture(r, texture);
+	assert(entry != NULL && entry->refs > 0);
+	entry->refs--;
+	if (entry->refs == 0) {
+		cursor_texture_cache_evict(r);
+	}
+}
@@ -0,0 +1,300 @@
+/*
+ * Tests the assignment of wlr_output_overlays to DRM overlay planes against a
+ * mocked KMS interface. Buffer imports, framebuffers and the atomic TEST_ONLY
+ * and page-flip commits are replaced by the mocks below.
+ */
+#include <drm_fourcc.h>
+#include <gbm.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+#include "backend/drm/drm.h"
+#include "backend/drm/iface.h"
+#include "backend/drm/overlay.h"
+#include "backend/drm/renderer.h"
+#include "backend/drm/util.h"
+
+#define NUM_PLANES 2
+
+struct mock_bo {
+	uint32_t fb_id;
+};
+
+static struct {
+	// Live gbm_bos, to catch leaks
+	int bos;
+	uint32_t last_fb_id;
+
+	// Maximum number of overlay planes accepted by TEST_ONLY commits
+	size_t max_test_planes;
+	// Page-flips fail if they enable an overlay plane
+	bool fail_flip_with_overlays;
+	// Page-flips always fail
+	bool fail_flip;
+	int flips;
+} mock;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", \
+				__FILE__, __LINE__, #cond); \
+			failures++; \
+		} \
+	} while (0)
+
+void _wlr_log(enum wlr_log_importance verbosity, const char *fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+}
+
+struct wlr_buffer *wlr_buffer_lock(struct wlr_buffer *buffer) {
+	buffer->n_locks++;
+	return buffer;
+}
+
+void wlr_buffer_unlock(struct wlr_buffer *buffer) {
+	if (buffer != NULL) {
+		buffer->n_locks--;
+	}
+}
+
+bool wlr_buffer_get_dmabuf(struct wlr_buffer *buffer,
+		struct wlr_dmabuf_attributes *attribs) {
+	memset(attribs, 0, sizeof(*attribs));
+	attribs->width = buffer->width;
+	attribs->height = buffer->height;
+	attribs->format = DRM_FORMAT_ARGB8888;
+	attribs->modifier = DRM_FORMAT_MOD_LINEAR;
+	attribs->n_planes = 1;
+	return true;
+}
+
+bool wlr_drm_format_set_has(const struct wlr_drm_format_set *set,
+		uint32_t format, uint64_t modifier) {
+	return true;
+}
+
+struct gbm_bo *import_gbm_bo(struct wlr_drm_renderer *renderer,
+		struct wlr_dmabuf_attributes *attribs) {
+	struct mock_bo *bo = calloc(1, sizeof(struct mock_bo));
+	bo->fb_id = ++mock.last_fb_id;
+	mock.bos++;
+	return (struct gbm_bo *)bo;
+}
+
+uint32_t get_fb_for_bo(struct gbm_bo *bo, uint32_t drm_format,
+		bool with_modifiers) {
+	return ((struct mock_bo *)bo)->fb_id;
+}
+
+uint32_t gbm_bo_get_format(struct gbm_bo *bo) {
+	return DRM_FORMAT_ARGB8888;
+}
+
+void gbm_bo_destroy(struct gbm_bo *bo) {
+	free(bo);
+	mock.bos--;
+}
+
+static size_t count_enabled_planes(struct wlr_drm_crtc *crtc) {
+	size_t n = 0;
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		if (crtc->overlays[i]->overlay.fb_id != 0) {
+			n++;
+		}
+	}
+	return n;
+}
+
+static bool mock_crtc_test_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc) {
+	return count_enabled_planes(crtc) <= mock.max_test_planes;
+}
+
+static bool mock_crtc_pageflip(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, struct wlr_drm_crtc *crtc,
+		uint32_t fb_id, drmModeModeInfo *mode) {
+	mock.flips++;
+	if (mock.fail_flip) {
+		return false;
+	}
+	if (mock.fail_flip_with_overlays && crtc->overlays_changed &&
+			count_enabled_planes(crtc) > 0) {
+		return false;
+	}
+	return true;
+}
+
+static const struct wlr_drm_interface mock_iface = {
+	.crtc_pageflip = mock_crtc_pageflip,
+	.crtc_test_overlays = mock_crtc_test_overlays,
+};
+
+struct fixture {
+	struct wlr_session session;
+	struct wlr_drm_backend drm;
+	struct wlr_drm_crtc crtc;
+	struct wlr_drm_plane planes[NUM_PLANES];
+	struct wlr_drm_plane *plane_ptrs[NUM_PLANES];
+	struct wlr_drm_connector conn;
+	struct wlr_buffer buffers[2];
+	struct wlr_output_overlay overlays[2]; // bottom to top
+};
+
+static void fixture_init(struct fixture *f) {
+	memset(f, 0, sizeof(*f));
+	memset(&mock, 0, sizeof(mock));
+	mock.max_test_planes = NUM_PLANES;
+
+	f->session.active = true;
+	f->drm.session = &f->session;
+	f->drm.iface = &mock_iface;
+
+	for (size_t i = 0; i < NUM_PLANES; ++i) {
+		f->planes[i].id = 100 + i;
+		f->plane_ptrs[i] = &f->planes[i];
+	}
+	f->crtc.num_overlays = NUM_PLANES;
+	f->crtc.overlays = f->plane_ptrs;
+
+	f->conn.crtc = &f->crtc;
+	wl_list_init(&f->conn.output.overlays);
+	for (size_t i = 0; i < 2; ++i) {
+		f->buffers[i].width = 64;
+		f->buffers[i].height = 64;
+		f->buffers[i].n_locks = 1;
+
+		struct wlr_output_overlay *overlay = &f->overlays[i];
+		overlay->output = &f->conn.output;
+		overlay->buffer = &f->buffers[i];
+		overlay->dst_box = (struct wlr_box){
+			.x = 10 * i, .y = 10 * i, .width = 64, .height = 64,
+		};
+		wl_list_insert(f->conn.output.overlays.prev, &overlay->link);
+	}
+}
+
+static void fixture_finish(struct fixture *f) {
+	for (size_t i = 0; i < NUM_PLANES; ++i) {
+		drm_plane_release_overlay(&f->planes[i]);
+	}
+	CHECK(mock.bos == 0);
+	for (size_t i = 0; i < 2; ++i) {
+		CHECK(f->buffers[i].n_locks == 1);
+	}
+}
+
+static void reset_accepted(struct fixture *f) {
+	for (size_t i = 0; i < 2; ++i) {
+		f->overlays[i].accepted = false;
+	}
+}
+
+static void test_assignment(void) {
+	struct fixture f;
+	fixture_init(&f);
+
+	CHECK(drm_connector_pageflip_overlays(&f.drm, &f.conn, 1, true));
+	CHECK(mock.flips == 1);
+	CHECK(f.overlays[0].accepted && f.overlays[1].accepted);
+	// The top-most overlay gets the top-most plane
+	CHECK(f.planes[1].overlay.pending_buffer == &f.buffers[1]);
+	CHECK(f.planes[0].overlay.pending_buffer == &f.buffers[0]);
+	CHECK(f.planes[0].overlay.box.x == 0 && f.planes[1].overlay.box.x == 10);
+	CHECK(f.buffers[0].n_locks == 2 && f.buffers[1].n_locks == 2);
+	CHECK(mock.bos == 2);
+	CHECK(!f.crtc.overlays_changed);
+
+	fixture_finish(&f);
+}
+
+static void test_test_only_fallback(void) {
+	struct fixture f;
+	fixture_init(&f);
+	mock.max_test_planes = 1;
+
+	// Tests report accepted overlays without staging anything
+	drm_connector_test_overlays(&f.drm, &f.conn);
+	CHECK(!f.overlays[0].accepted && f.overlays[1].accepted);
+	CHECK(count_enabled_planes(&f.crtc) == 0);
+	CHECK(mock.bos == 0);
+
+	reset_accepted(&f);
+	CHECK(drm_connector_pageflip_overlays(&f.drm, &f.conn, 1, true));
+	// The bottom-most overlay is given up on
+	CHECK(!f.overlays[0].accepted && f.overlays[1].accepted);
+	CHECK(count_enabled_planes(&f.crtc) == 1);
+	CHECK(f.planes[1].overlay.pending_buffer == &f.buffers[1]);
+	CHECK(f.planes[0].overlay.pending_buffer == NULL);
+	CHECK(mock.bos == 1);
+
+	fixture_finish(&f);
+}
+
+static void test_pageflip_rollback(void) {
+	struct fixture f;
+	fixture_init(&f);
+
+	// Display the top-most overlay only
+	f.overlays[0].buffer = NULL;
+	CHECK(drm_connector_pageflip_overlays(&f.drm, &f.conn, 1, true));
+	uint32_t fb_id = f.planes[1].overlay.fb_id;
+	CHECK(fb_id != 0 && f.planes[0].overlay.fb_id == 0);
+
+	// A failed page-flip leaves the previous configuration untouched
+	reset_accepted(&f);
+	f.overlays[0].buffer = &f.buffers[0];
+	mock.fail_flip = true;
+	mock.flips = 0;
+	CHECK(!drm_connector_pageflip_overlays(&f.drm, &f.conn, 1, true));
+	CHECK(!f.overlays[0].accepted && !f.overlays[1].accepted);
+	CHECK(f.planes[1].overlay.fb_id == fb_id);
+	CHECK(f.planes[0].overlay.fb_id == 0);
+	CHECK(f.planes[0].overlay.pending_buffer == NULL);
+	CHECK(f.buffers[0].n_locks == 1);
+	CHECK(!f.crtc.overlays_changed);
+	CHECK(mock.bos == 1);
+
+	fixture_finish(&f);
+}
+
+static void test_pageflip_retry(void) {
+	struct fixture f;
+	fixture_init(&f);
+	mock.fail_flip_with_overlays = true;
+
+	// The frame is displayed without overlays
+	CHECK(drm_connector_pageflip_overlays(&f.drm, &f.conn, 1, true));
+	CHECK(mock.flips == 2);
+	CHECK(!f.overlays[0].accepted && !f.overlays[1].accepted);
+	CHECK(count_enabled_planes(&f.crtc) == 0);
+	CHECK(f.planes[0].overlay.pending_buffer == NULL);
+	CHECK(f.planes[1].overlay.pending_buffer == NULL);
+	CHECK(mock.bos == 0);
+
+	fixture_finish(&f);
+}
+
+int main(void) {
+	test_assignment();
+	test_test_only_fallback();
+	test_pageflip_rollback();
+	test_pageflip_retry();
+
+	if (failures > 0) {
+		fprintf(stderr, "%d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -163,6 +163,10 @@ void wlr_seat_destroy(struct wlr_seat *seat) {
 
 	wl_list_remove(&seat->display_destroy.link);
 
+	if (seat->pointer_state.flush_idle != NULL) {
+		wl_event_source_remove(seat->pointer_state.flush_idle);
+	}
+
 	wlr_data_source_destroy(seat->selection_source);
 	wlr_primary_selection_source_destroy(seat->primary_selection_source);
 
@@ -2,7 +2,6 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
@@ -12,7 +11,6 @@
 #include <wlr/util/log.h>
 #include "types/wlr_data_device.h"
 #include "types/wlr_seat.h"
-#include "util/shm.h"
 #include "util/signal.h"
 
 static void default_keyboard_enter(struct wlr_seat_keyboard_grab *grab,
@@ -341,7 +339,7 @@ void wlr_seat_keyboard_notify_key(struct wlr_seat *seat, uint32_t time,
 
 static void seat_client_send_keymap(struct wlr_seat_client *client,
 		struct wlr_keyboard *keyboard) {
-	if (!keyboard) {
+	if (!keyboard || keyboard->keymap_fd < 0) {
 		return;
 	}
 
@@ -353,28 +351,9 @@ static void seat_client_send_keymap(struct wlr_seat_client *client,
 			continue;
 		}
 
-		int keymap_fd = allocate_shm_file(keyboard->keymap_size);
-		if (keymap_fd < 0) {
-			wlr_log(WLR_ERROR, "creating a keymap file for %zu bytes failed", keyboard->keymap_size);
-			continue;
-		}
-
-		void *ptr = mmap(NULL, keyboard->keymap_size, PROT_READ | PROT_WRITE,
-				MAP_SHARED, keymap_fd, 0);
-		if (ptr == MAP_FAILED) {
-			wlr_log(WLR_ERROR, "failed to mmap() %zu bytes", keyboard->keymap_size);
-			close(keymap_fd);
-			continue;
-		}
-
-		strcpy(ptr, keyboard->keymap_string);
-		munmap(ptr, keyboard->keymap_size);
-
 		wl_keyboard_send_keymap(resource,
-			WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keymap_fd,
+			WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keyboard->keymap_fd,
 			keyboard->keymap_size);
-
-		close(keymap_fd);
 	}
 }
 
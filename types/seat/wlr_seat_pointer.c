@@ -59,6 +59,8 @@ static void pointer_send_frame(struct wl_resource *resource) {
 
 static const struct wl_pointer_interface pointer_impl;
 
+static void seat_pointer_flush_motion(struct wlr_seat *wlr_seat);
+
 struct wlr_seat_client *wlr_seat_client_from_pointer_resource(
 		struct wl_resource *resource) {
 	assert(wl_resource_instance_of(resource, &wl_pointer_interface,
@@ -150,6 +152,9 @@ void wlr_seat_pointer_enter(struct wlr_seat *wlr_seat,
 		return;
 	}
 
+	// pending motion is relative to the previously entered surface
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wlr_seat_client *client = NULL;
 	if (surface) {
 		struct wl_client *wl_client = wl_resource_get_client(surface->resource);
@@ -215,8 +220,8 @@ void wlr_seat_pointer_clear_focus(struct wlr_seat *wlr_seat) {
 	wlr_seat_pointer_enter(wlr_seat, NULL, 0, 0);
 }
 
-void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
-		double sx, double sy) {
+static void seat_pointer_send_motion(struct wlr_seat *wlr_seat,
+		uint32_t time, double sx, double sy) {
 	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
 	if (client == NULL) {
 		return;
@@ -240,8 +245,96 @@ void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 	wlr_seat->pointer_state.sy = sy;
 }
 
+static void seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
+	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
+	if (client == NULL) {
+		return;
+	}
+
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		pointer_send_frame(resource);
+	}
+}
+
+/**
+ * Send the coalesced motion event, and the frame which was held back with it.
+ */
+static void seat_pointer_flush_motion(struct wlr_seat *wlr_seat) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->flush_idle != NULL) {
+		wl_event_source_remove(state->flush_idle);
+		state->flush_idle = NULL;
+	}
+	if (!state->pending.motion) {
+		return;
+	}
+
+	bool frame = state->pending.frame;
+	state->pending.motion = state->pending.frame = false;
+
+	seat_pointer_send_motion(wlr_seat, state->pending.time_msec,
+		state->pending.sx, state->pending.sy);
+	if (frame) {
+		seat_pointer_send_frame(wlr_seat);
+	}
+}
+
+static void seat_pointer_handle_flush_idle(void *data) {
+	struct wlr_seat *wlr_seat = data;
+	wlr_seat->pointer_state.flush_idle = NULL;
+	seat_pointer_flush_motion(wlr_seat);
+}
+
+void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
+		double sx, double sy) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	state->stats.motion_events++;
+	if (!state->coalesce_motion) {
+		seat_pointer_send_motion(wlr_seat, time, sx, sy);
+		return;
+	}
+	if (state->focused_client == NULL) {
+		return;
+	}
+
+	if (state->pending.motion) {
+		state->stats.coalesced_motion_events++;
+	}
+	state->pending.motion = true;
+	state->pending.time_msec = time;
+	state->pending.sx = sx;
+	state->pending.sy = sy;
+
+	// All events read from the input devices in one go are dispatched before
+	// the event loop goes idle
+	if (state->flush_idle == NULL) {
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(wlr_seat->display);
+		state->flush_idle = wl_event_loop_add_idle(loop,
+			seat_pointer_handle_flush_idle, wlr_seat);
+		if (state->flush_idle == NULL) {
+			seat_pointer_flush_motion(wlr_seat);
+		}
+	}
+}
+
+void wlr_seat_pointer_set_coalesce_motion(struct wlr_seat *wlr_seat,
+		bool coalesce) {
+	if (!coalesce) {
+		seat_pointer_flush_motion(wlr_seat);
+	}
+	wlr_seat->pointer_state.coalesce_motion = coalesce;
+}
+
 uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 		uint32_t button, enum wlr_button_state state) {
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
 	if (client == NULL) {
 		return 0;
@@ -262,6 +355,8 @@ uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 		enum wlr_axis_orientation orientation, double value,
 		int32_t value_discrete, enum wlr_axis_source source) {
+	seat_pointer_flush_motion(wlr_seat);
+
 	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
 	if (client == NULL) {
 		return;
@@ -294,19 +389,14 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 }
 
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
-	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
-	if (client == NULL) {
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	if (state->pending.motion) {
+		// Frames which only carry motion are merged with the next ones
+		state->pending.frame = true;
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &client->pointers) {
-		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-			continue;
-		}
-
-		pointer_send_frame(resource);
-	}
+	seat_pointer_send_frame(wlr_seat);
 }
 
 void wlr_seat_pointer_start_grab(struct wlr_seat *wlr_seat,
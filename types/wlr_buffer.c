@@ -3,6 +3,7 @@
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_shm_udmabuf.h>
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
@@ -110,7 +111,12 @@ static void client_buffer_destroy(struct wlr_buffer *_buffer) {
 	}
 
 	wl_list_remove(&buffer->resource_destroy.link);
-	wlr_texture_destroy(buffer->texture);
+	if (buffer->shm_texture) {
+		wlr_renderer_texture_pool_release(buffer->renderer, buffer->texture,
+			buffer->shm_format, buffer->content_seq);
+	} else {
+		wlr_texture_destroy(buffer->texture);
+	}
 	free(buffer);
 }
 
@@ -123,6 +129,9 @@ static bool client_buffer_get_dmabuf(struct wlr_buffer *_buffer,
 	}
 
 	struct wl_resource *buffer_resource = buffer->resource;
+	if (wl_shm_buffer_get(buffer_resource) != NULL) {
+		return wlr_shm_udmabuf_get_dmabuf(buffer_resource, attribs);
+	}
 	if (!wlr_dmabuf_v1_resource_is_buffer(buffer_resource)) {
 		return false;
 	}
@@ -165,15 +174,70 @@ static void client_buffer_handle_release(struct wl_listener *listener,
 	}
 }
 
+static struct wlr_client_buffer *client_buffer_create(
+		struct wlr_renderer *renderer, struct wl_resource *resource,
+		struct wlr_texture *texture, bool resource_released,
+		bool shm_texture) {
+	int width, height;
+	wlr_resource_get_buffer_size(resource, renderer, &width, &height);
+
+	struct wlr_client_buffer *buffer =
+		calloc(1, sizeof(struct wlr_client_buffer));
+	if (buffer == NULL) {
+		wlr_texture_destroy(texture);
+		wl_resource_post_no_memory(resource);
+		return NULL;
+	}
+	wlr_buffer_init(&buffer->base, &client_buffer_impl, width, height);
+	buffer->resource = resource;
+	buffer->texture = texture;
+	buffer->resource_released = resource_released;
+	buffer->renderer = renderer;
+
+	if (shm_texture) {
+		struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+		buffer->shm_texture = true;
+		buffer->shm_format = wl_shm_buffer_get_format(shm_buf);
+	}
+
+	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
+	buffer->resource_destroy.notify = client_buffer_resource_handle_destroy;
+
+	buffer->release.notify = client_buffer_handle_release;
+	wl_signal_add(&buffer->base.events.release, &buffer->release);
+
+	// Ensure the buffer will be released before being destroyed
+	wlr_buffer_lock(&buffer->base);
+	wlr_buffer_drop(&buffer->base);
+
+	return buffer;
+}
+
 struct wlr_client_buffer *wlr_client_buffer_import(
 		struct wlr_renderer *renderer, struct wl_resource *resource) {
 	assert(wlr_resource_is_buffer(resource));
 
 	struct wlr_texture *texture = NULL;
 	bool resource_released = false;
+	bool shm_texture = false;
 
+	struct wlr_dmabuf_attributes shm_attribs;
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
-	if (shm_buf != NULL) {
+	if (shm_buf != NULL &&
+			wlr_shm_udmabuf_get_dmabuf(resource, &shm_attribs)) {
+		texture = wlr_texture_from_dmabuf(renderer, &shm_attribs);
+		if (texture == NULL) {
+			// Don't try again on the next commit
+			wlr_shm_udmabuf_import_failed(resource);
+		}
+
+		// Same as linux-dmabuf: the texture samples the client's memory
+		// directly, so the buffer can't be released yet
+	}
+
+	if (texture != NULL) {
+		// Imported without a copy
+	} else if (shm_buf != NULL) {
 		enum wl_shm_format fmt = wl_shm_buffer_get_format(shm_buf);
 		int32_t stride = wl_shm_buffer_get_stride(shm_buf);
 		int32_t width = wl_shm_buffer_get_width(shm_buf);
@@ -189,6 +253,7 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 		// anymore
 		wl_buffer_send_release(resource);
 		resource_released = true;
+		shm_texture = true;
 	} else if (wlr_renderer_resource_is_wl_drm_buffer(renderer, resource)) {
 		texture = wlr_texture_from_wl_drm(renderer, resource);
 	} else if (wlr_dmabuf_v1_resource_is_buffer(resource)) {
@@ -214,32 +279,66 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 		return NULL;
 	}
 
-	int width, height;
-	wlr_resource_get_buffer_size(resource, renderer, &width, &height);
+	return client_buffer_create(renderer, resource, texture,
+		resource_released, shm_texture);
+}
 
-	struct wlr_client_buffer *buffer =
-		calloc(1, sizeof(struct wlr_client_buffer));
-	if (buffer == NULL) {
+static bool shm_buffer_write_region(struct wl_shm_buffer *shm_buf,
+		struct wlr_texture *texture, pixman_region32_t *region) {
+	int32_t stride = wl_shm_buffer_get_stride(shm_buf);
+
+	wl_shm_buffer_begin_access(shm_buf);
+	void *data = wl_shm_buffer_get_data(shm_buf);
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &n);
+	for (int i = 0; i < n; ++i) {
+		pixman_box32_t *r = &rects[i];
+		if (!wlr_texture_write_pixels(texture, stride,
+				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
+				r->x1, r->y1, data)) {
+			wl_shm_buffer_end_access(shm_buf);
+			return false;
+		}
+	}
+
+	wl_shm_buffer_end_access(shm_buf);
+	return true;
+}
+
+struct wlr_client_buffer *wlr_client_buffer_import_recycled(
+		struct wlr_renderer *renderer, struct wl_resource *resource,
+		struct wlr_texture *texture, pixman_region32_t *damage) {
+	assert(wlr_resource_is_buffer(resource));
+
+	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+	if (shm_buf == NULL) {
 		wlr_texture_destroy(texture);
-		wl_resource_post_no_memory(resource);
 		return NULL;
 	}
-	wlr_buffer_init(&buffer->base, &client_buffer_impl, width, height);
-	buffer->resource = resource;
-	buffer->texture = texture;
-	buffer->resource_released = resource_released;
 
-	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
-	buffer->resource_destroy.notify = client_buffer_resource_handle_destroy;
+	int32_t width = wl_shm_buffer_get_width(shm_buf);
+	int32_t height = wl_shm_buffer_get_height(shm_buf);
 
-	buffer->release.notify = client_buffer_handle_release;
-	wl_signal_add(&buffer->base.events.release, &buffer->release);
+	int32_t texture_width, texture_height;
+	wlr_texture_get_size(texture, &texture_width, &texture_height);
+	assert(width == texture_width && height == texture_height);
+
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	pixman_region32_intersect_rect(&region, damage, 0, 0, width, height);
+	bool ok = shm_buffer_write_region(shm_buf, texture, &region);
+	pixman_region32_fini(&region);
+	if (!ok) {
+		wlr_texture_destroy(texture);
+		return NULL;
+	}
 
-	// Ensure the buffer will be released before being destroyed
-	wlr_buffer_lock(&buffer->base);
-	wlr_buffer_drop(&buffer->base);
+	// We have uploaded the data, we don't need to access the wl_buffer
+	// anymore
+	wl_buffer_send_release(resource);
 
-	return buffer;
+	return client_buffer_create(renderer, resource, texture, true, true);
 }
 
 struct wlr_client_buffer *wlr_client_buffer_apply_damage(
@@ -253,21 +352,18 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 	}
 
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
-	struct wl_shm_buffer *old_shm_buf = wl_shm_buffer_get(buffer->resource);
-	if (shm_buf == NULL || old_shm_buf == NULL) {
+	if (shm_buf == NULL || !buffer->shm_texture) {
 		// Uploading only damaged regions only works for wl_shm buffers and
 		// mutable textures (created from wl_shm buffer)
 		return NULL;
 	}
 
 	enum wl_shm_format new_fmt = wl_shm_buffer_get_format(shm_buf);
-	enum wl_shm_format old_fmt = wl_shm_buffer_get_format(old_shm_buf);
-	if (new_fmt != old_fmt) {
+	if (new_fmt != buffer->shm_format) {
 		// Uploading to textures can't change the format
 		return NULL;
 	}
 
-	int32_t stride = wl_shm_buffer_get_stride(shm_buf);
 	int32_t width = wl_shm_buffer_get_width(shm_buf);
 	int32_t height = wl_shm_buffer_get_height(shm_buf);
 
@@ -277,23 +373,10 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		return NULL;
 	}
 
-	wl_shm_buffer_begin_access(shm_buf);
-	void *data = wl_shm_buffer_get_data(shm_buf);
-
-	int n;
-	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
-	for (int i = 0; i < n; ++i) {
-		pixman_box32_t *r = &rects[i];
-		if (!wlr_texture_write_pixels(buffer->texture, stride,
-				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
-				r->x1, r->y1, data)) {
-			wl_shm_buffer_end_access(shm_buf);
-			return NULL;
-		}
+	if (!shm_buffer_write_region(shm_buf, buffer->texture, damage)) {
+		return NULL;
 	}
 
-	wl_shm_buffer_end_access(shm_buf);
-
 	// We have uploaded the data, we don't need to access the wl_buffer
 	// anymore
 	wl_buffer_send_release(resource);
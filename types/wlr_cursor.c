@@ -1,13 +1,19 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
+#include <wlr/xcursor.h>
 #include "util/signal.h"
 
 struct wlr_cursor_device {
@@ -42,12 +48,29 @@ struct wlr_cursor_device {
 	struct wl_listener destroy;
 };
 
+/**
+ * A copy of an animated xcursor, shared by the output cursors playing it back,
+ * so that the xcursor's owner can free it at any time.
+ */
+struct wlr_cursor_animation {
+	struct wlr_xcursor xcursor;
+	size_t n_refs;
+};
+
 struct wlr_cursor_output_cursor {
 	struct wlr_cursor *cursor;
 	struct wlr_output_cursor *output_cursor;
 	struct wl_list link;
 
+	// Animated xcursor, NULL if the image isn't animated
+	struct wlr_cursor_animation *animation;
+	struct wlr_texture **xcursor_textures; // one per image, kept uploaded
+	int xcursor_frame; // currently displayed image
+	uint32_t xcursor_start; // in ms
+	struct wl_event_source *xcursor_timer;
+
 	struct wl_listener layout_output_destroy;
+	struct wl_listener output_frame;
 };
 
 struct wlr_cursor_state {
@@ -114,8 +137,12 @@ struct wlr_cursor *wlr_cursor_create(void) {
 	return cur;
 }
 
+static void output_cursor_reset_xcursor(
+		struct wlr_cursor_output_cursor *output_cursor);
+
 static void output_cursor_destroy(
 		struct wlr_cursor_output_cursor *output_cursor) {
+	output_cursor_reset_xcursor(output_cursor);
 	wl_list_remove(&output_cursor->layout_output_destroy.link);
 	wl_list_remove(&output_cursor->link);
 	wlr_output_cursor_destroy(output_cursor->output_cursor);
@@ -334,15 +361,235 @@ void wlr_cursor_set_image(struct wlr_cursor *cur, const uint8_t *pixels,
 			continue;
 		}
 
+		output_cursor_reset_xcursor(output_cursor);
 		wlr_output_cursor_set_image(output_cursor->output_cursor, pixels,
 			stride, width, height, hotspot_x, hotspot_y);
 	}
 }
 
+static uint32_t get_current_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void animation_unref(struct wlr_cursor_animation *animation) {
+	if (animation == NULL) {
+		return;
+	}
+	assert(animation->n_refs > 0);
+	animation->n_refs--;
+	if (animation->n_refs > 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < animation->xcursor.image_count; i++) {
+		free(animation->xcursor.images[i]->buffer);
+		free(animation->xcursor.images[i]);
+	}
+	free(animation->xcursor.images);
+	free(animation);
+}
+
+static struct wlr_cursor_animation *animation_create(
+		struct wlr_xcursor *xcursor) {
+	struct wlr_cursor_animation *animation =
+		calloc(1, sizeof(struct wlr_cursor_animation));
+	if (animation == NULL) {
+		return NULL;
+	}
+	animation->n_refs = 1;
+	animation->xcursor.total_delay = xcursor->total_delay;
+	animation->xcursor.images =
+		calloc(xcursor->image_count, sizeof(struct wlr_xcursor_image *));
+	if (animation->xcursor.images == NULL) {
+		goto error;
+	}
+
+	for (size_t i = 0; i < xcursor->image_count; i++) {
+		struct wlr_xcursor_image *src = xcursor->images[i];
+		struct wlr_xcursor_image *image =
+			calloc(1, sizeof(struct wlr_xcursor_image));
+		if (image == NULL) {
+			goto error;
+		}
+		*image = *src;
+		size_t size = (size_t)src->width * src->height * 4;
+		image->buffer = malloc(size);
+		if (image->buffer == NULL) {
+			free(image);
+			goto error;
+		}
+		memcpy(image->buffer, src->buffer, size);
+		animation->xcursor.images[i] = image;
+		animation->xcursor.image_count++;
+	}
+
+	return animation;
+
+error:
+	wlr_log(WLR_ERROR, "Failed to copy animated xcursor");
+	animation_unref(animation);
+	return NULL;
+}
+
+static void output_cursor_reset_xcursor(
+		struct wlr_cursor_output_cursor *output_cursor) {
+	struct wlr_cursor_animation *animation = output_cursor->animation;
+	if (animation == NULL) {
+		return;
+	}
+
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(
+		output_cursor->output_cursor->output->backend);
+	for (size_t i = 0; i < animation->xcursor.image_count; i++) {
+		wlr_renderer_cursor_texture_unref(renderer,
+			output_cursor->xcursor_textures[i]);
+	}
+	free(output_cursor->xcursor_textures);
+	output_cursor->xcursor_textures = NULL;
+
+	wl_event_source_remove(output_cursor->xcursor_timer);
+	output_cursor->xcursor_timer = NULL;
+	wl_list_remove(&output_cursor->output_frame.link);
+	output_cursor->animation = NULL;
+	animation_unref(animation);
+}
+
+static void output_cursor_set_xcursor_image(
+		struct wlr_cursor_output_cursor *output_cursor,
+		struct wlr_xcursor_image *image) {
+	wlr_output_cursor_set_image(output_cursor->output_cursor, image->buffer,
+		image->width * 4, image->width, image->height, image->hotspot_x,
+		image->hotspot_y);
+}
+
+/**
+ * Show the image due at the current time and arm the timer for the next one.
+ */
+static void output_cursor_update_xcursor(
+		struct wlr_cursor_output_cursor *output_cursor) {
+	uint32_t elapsed = get_current_time_msec() - output_cursor->xcursor_start;
+	struct wlr_xcursor *xcursor = &output_cursor->animation->xcursor;
+	uint32_t duration;
+	int frame = wlr_xcursor_frame_and_duration(xcursor, elapsed, &duration);
+	if (frame != output_cursor->xcursor_frame) {
+		// The texture is already uploaded, this only flips the cursor image
+		struct wlr_xcursor_image *image = xcursor->images[frame];
+		wlr_output_cursor_set_texture(output_cursor->output_cursor,
+			output_cursor->xcursor_textures[frame], image->hotspot_x,
+			image->hotspot_y);
+		output_cursor->xcursor_frame = frame;
+	}
+
+	wl_event_source_timer_update(output_cursor->xcursor_timer, duration);
+}
+
+static void handle_output_frame(struct wl_listener *listener, void *data) {
+	struct wlr_cursor_output_cursor *output_cursor =
+		wl_container_of(listener, output_cursor, output_frame);
+	output_cursor_update_xcursor(output_cursor);
+}
+
+static int handle_xcursor_timer(void *data) {
+	struct wlr_cursor_output_cursor *output_cursor = data;
+	// The next image is due but the output hasn't rendered since the last
+	// one: ask for a frame, the image is updated on the frame event
+	wlr_output_schedule_frame(output_cursor->output_cursor->output);
+	return 0;
+}
+
+static bool output_cursor_start_xcursor(
+		struct wlr_cursor_output_cursor *output_cursor,
+		struct wlr_cursor_animation *animation, uint32_t now) {
+	struct wlr_xcursor *xcursor = &animation->xcursor;
+	struct wlr_output *output = output_cursor->output_cursor->output;
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	if (renderer == NULL) {
+		return false;
+	}
+
+	struct wlr_texture **textures =
+		calloc(xcursor->image_count, sizeof(struct wlr_texture *));
+	if (textures == NULL) {
+		return false;
+	}
+
+	// Upload all images now, and keep them referenced while animating so
+	// that flipping between them never uploads anything
+	for (size_t i = 0; i < xcursor->image_count; i++) {
+		struct wlr_xcursor_image *image = xcursor->images[i];
+		textures[i] = wlr_renderer_cursor_texture_get(renderer, image->buffer,
+			image->width * 4, image->width, image->height);
+		if (textures[i] == NULL) {
+			goto error_textures;
+		}
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(output->display);
+	output_cursor->xcursor_timer =
+		wl_event_loop_add_timer(loop, handle_xcursor_timer, output_cursor);
+	if (output_cursor->xcursor_timer == NULL) {
+		goto error_textures;
+	}
+
+	output_cursor->output_frame.notify = handle_output_frame;
+	wl_signal_add(&output->events.frame, &output_cursor->output_frame);
+
+	animation->n_refs++;
+	output_cursor->animation = animation;
+	output_cursor->xcursor_textures = textures;
+	output_cursor->xcursor_start = now;
+	output_cursor->xcursor_frame = -1;
+	output_cursor_update_xcursor(output_cursor);
+	return true;
+
+error_textures:
+	for (size_t i = 0; i < xcursor->image_count; i++) {
+		wlr_renderer_cursor_texture_unref(renderer, textures[i]);
+	}
+	free(textures);
+	return false;
+}
+
+void wlr_cursor_set_xcursor(struct wlr_cursor *cur,
+		struct wlr_xcursor *xcursor, float scale) {
+	uint32_t now = get_current_time_msec();
+
+	// Only created if an output cursor plays the animation back
+	struct wlr_cursor_animation *animation = NULL;
+	bool animation_failed = false;
+
+	struct wlr_cursor_output_cursor *output_cursor;
+	wl_list_for_each(output_cursor, &cur->state->output_cursors, link) {
+		float output_scale = output_cursor->output_cursor->output->scale;
+		if (scale > 0 && output_scale != scale) {
+			continue;
+		}
+
+		output_cursor_reset_xcursor(output_cursor);
+		if (xcursor->image_count > 1 && animation == NULL &&
+				!animation_failed) {
+			animation = animation_create(xcursor);
+			animation_failed = animation == NULL;
+		}
+		if (animation != NULL &&
+				output_cursor_start_xcursor(output_cursor, animation, now)) {
+			continue;
+		}
+
+		// Not animated, or animating failed: show the first image
+		output_cursor_set_xcursor_image(output_cursor, xcursor->images[0]);
+	}
+
+	animation_unref(animation);
+}
+
 void wlr_cursor_set_surface(struct wlr_cursor *cur, struct wlr_surface *surface,
 		int32_t hotspot_x, int32_t hotspot_y) {
 	struct wlr_cursor_output_cursor *output_cursor;
 	wl_list_for_each(output_cursor, &cur->state->output_cursors, link) {
+		output_cursor_reset_xcursor(output_cursor);
 		wlr_output_cursor_set_surface(output_cursor->output_cursor, surface,
 			hotspot_x, hotspot_y);
 	}
@@ -0,0 +1,655 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_input_recorder.h>
+#include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_tablet_tool.h>
+#include <wlr/types/wlr_touch.h>
+#include <wlr/util/log.h>
+#include "util/input_trace.h"
+
+#define RECORDER_BUFFER_SIZE (256 * 1024)
+
+struct wlr_input_recorder_device {
+	struct wlr_input_recorder *recorder;
+	struct wlr_input_device *device;
+	uint32_t id;
+	struct wl_list link; // wlr_input_recorder::devices
+
+	struct wl_listener destroy;
+
+	struct wl_listener pointer_motion;
+	struct wl_listener pointer_motion_absolute;
+	struct wl_listener pointer_button;
+	struct wl_listener pointer_axis;
+	struct wl_listener pointer_frame;
+	struct wl_listener pointer_swipe_begin;
+	struct wl_listener pointer_swipe_update;
+	struct wl_listener pointer_swipe_end;
+	struct wl_listener pointer_pinch_begin;
+	struct wl_listener pointer_pinch_update;
+	struct wl_listener pointer_pinch_end;
+
+	struct wl_listener keyboard_key;
+
+	struct wl_listener touch_down;
+	struct wl_listener touch_up;
+	struct wl_listener touch_motion;
+	struct wl_listener touch_cancel;
+
+	struct wl_listener tablet_tool_axis;
+	struct wl_listener tablet_tool_proximity;
+	struct wl_listener tablet_tool_tip;
+	struct wl_listener tablet_tool_button;
+};
+
+struct wlr_input_recorder_tool {
+	struct wlr_tablet_tool *tool;
+	uint32_t id;
+	struct wl_list link; // wlr_input_recorder::tools
+
+	struct wl_listener destroy;
+};
+
+static void recorder_write(struct wlr_input_recorder *recorder,
+		enum input_trace_record_type type, uint32_t device,
+		const void *payload, size_t size) {
+	if (recorder->failed) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t time_nsec =
+		(int64_t)(now.tv_sec - recorder->start.tv_sec) * 1000000000 +
+		(now.tv_nsec - recorder->start.tv_nsec);
+
+	struct input_trace_record record = {
+		.type = type,
+		.size = size,
+		.device = device,
+		.time_nsec = time_nsec,
+	};
+	if (fwrite(&record, sizeof(record), 1, recorder->file) != 1 ||
+			(size > 0 && fwrite(payload, size, 1, recorder->file) != 1)) {
+		wlr_log_errno(WLR_ERROR, "Failed to write input trace");
+		recorder->failed = true;
+		return;
+	}
+
+	if (type != INPUT_TRACE_DEVICE_ADD && type != INPUT_TRACE_DEVICE_REMOVE &&
+			type != INPUT_TRACE_TOOL_ADD) {
+		recorder->events++;
+	}
+}
+
+static void tool_destroy(struct wlr_input_recorder_tool *tool) {
+	wl_list_remove(&tool->destroy.link);
+	wl_list_remove(&tool->link);
+	free(tool);
+}
+
+static void tool_handle_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_tool *tool =
+		wl_container_of(listener, tool, destroy);
+	tool_destroy(tool);
+}
+
+/**
+ * Get the ID of a tablet tool, recording it if it's seen for the first time.
+ */
+static uint32_t recorder_get_tool_id(struct wlr_input_recorder *recorder,
+		uint32_t device, struct wlr_tablet_tool *wlr_tool) {
+	struct wlr_input_recorder_tool *tool;
+	wl_list_for_each(tool, &recorder->tools, link) {
+		if (tool->tool == wlr_tool) {
+			return tool->id;
+		}
+	}
+
+	tool = calloc(1, sizeof(struct wlr_input_recorder_tool));
+	if (tool == NULL) {
+		return 0;
+	}
+	tool->tool = wlr_tool;
+	tool->id = ++recorder->last_tool_id;
+	tool->destroy.notify = tool_handle_destroy;
+	wl_signal_add(&wlr_tool->events.destroy, &tool->destroy);
+	wl_list_insert(&recorder->tools, &tool->link);
+
+	struct input_trace_tool payload = {
+		.id = tool->id,
+		.type = wlr_tool->type,
+		.hardware_serial = wlr_tool->hardware_serial,
+		.hardware_wacom = wlr_tool->hardware_wacom,
+	};
+	if (wlr_tool->tilt) {
+		payload.capabilities |= INPUT_TRACE_TOOL_TILT;
+	}
+	if (wlr_tool->pressure) {
+		payload.capabilities |= INPUT_TRACE_TOOL_PRESSURE;
+	}
+	if (wlr_tool->distance) {
+		payload.capabilities |= INPUT_TRACE_TOOL_DISTANCE;
+	}
+	if (wlr_tool->rotation) {
+		payload.capabilities |= INPUT_TRACE_TOOL_ROTATION;
+	}
+	if (wlr_tool->slider) {
+		payload.capabilities |= INPUT_TRACE_TOOL_SLIDER;
+	}
+	if (wlr_tool->wheel) {
+		payload.capabilities |= INPUT_TRACE_TOOL_WHEEL;
+	}
+	recorder_write(recorder, INPUT_TRACE_TOOL_ADD, device,
+		&payload, sizeof(payload));
+
+	return tool->id;
+}
+
+static void handle_pointer_motion(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_motion);
+	struct wlr_event_pointer_motion *event = data;
+	struct input_trace_pointer_motion payload = {
+		.time_msec = event->time_msec,
+		.delta_x = event->delta_x,
+		.delta_y = event->delta_y,
+		.unaccel_dx = event->unaccel_dx,
+		.unaccel_dy = event->unaccel_dy,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_MOTION, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_pointer_motion_absolute(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_motion_absolute);
+	struct wlr_event_pointer_motion_absolute *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.x = event->x,
+		.y = event->y,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_MOTION_ABSOLUTE,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_button(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_button);
+	struct wlr_event_pointer_button *event = data;
+	struct input_trace_button payload = {
+		.time_msec = event->time_msec,
+		.button = event->button,
+		.state = event->state,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_BUTTON, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_pointer_axis(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_axis);
+	struct wlr_event_pointer_axis *event = data;
+	struct input_trace_pointer_axis payload = {
+		.time_msec = event->time_msec,
+		.source = event->source,
+		.orientation = event->orientation,
+		.delta_discrete = event->delta_discrete,
+		.delta = event->delta,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_AXIS, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_pointer_frame(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_frame);
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_FRAME, device->id,
+		NULL, 0);
+}
+
+static void handle_pointer_swipe_begin(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_swipe_begin);
+	struct wlr_event_pointer_swipe_begin *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.fingers = event->fingers,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_SWIPE_BEGIN,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_swipe_update(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_swipe_update);
+	struct wlr_event_pointer_swipe_update *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.fingers = event->fingers,
+		.dx = event->dx,
+		.dy = event->dy,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_SWIPE_UPDATE,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_swipe_end(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_swipe_end);
+	struct wlr_event_pointer_swipe_end *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.cancelled = event->cancelled,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_SWIPE_END,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_pinch_begin(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_pinch_begin);
+	struct wlr_event_pointer_pinch_begin *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.fingers = event->fingers,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_PINCH_BEGIN,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_pinch_update(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_pinch_update);
+	struct wlr_event_pointer_pinch_update *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.fingers = event->fingers,
+		.dx = event->dx,
+		.dy = event->dy,
+		.scale = event->scale,
+		.rotation = event->rotation,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_PINCH_UPDATE,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_pointer_pinch_end(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, pointer_pinch_end);
+	struct wlr_event_pointer_pinch_end *event = data;
+	struct input_trace_gesture payload = {
+		.time_msec = event->time_msec,
+		.cancelled = event->cancelled,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_POINTER_PINCH_END,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_keyboard_key(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, keyboard_key);
+	struct wlr_event_keyboard_key *event = data;
+	struct input_trace_keyboard_key payload = {
+		.time_msec = event->time_msec,
+		.keycode = event->keycode,
+		.state = event->state,
+		.update_state = event->update_state,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_KEYBOARD_KEY, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_touch_down(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, touch_down);
+	struct wlr_event_touch_down *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = event->touch_id,
+		.x = event->x,
+		.y = event->y,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TOUCH_DOWN, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_touch_up(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, touch_up);
+	struct wlr_event_touch_up *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = event->touch_id,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TOUCH_UP, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_touch_motion(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, touch_motion);
+	struct wlr_event_touch_motion *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = event->touch_id,
+		.x = event->x,
+		.y = event->y,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TOUCH_MOTION, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_touch_cancel(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, touch_cancel);
+	struct wlr_event_touch_cancel *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = event->touch_id,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TOUCH_CANCEL, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_tablet_tool_axis(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, tablet_tool_axis);
+	struct wlr_event_tablet_tool_axis *event = data;
+	struct input_trace_tablet_tool_axis payload = {
+		.time_msec = event->time_msec,
+		.tool = recorder_get_tool_id(device->recorder, device->id,
+			event->tool),
+		.updated_axes = event->updated_axes,
+		.x = event->x,
+		.y = event->y,
+		.dx = event->dx,
+		.dy = event->dy,
+		.pressure = event->pressure,
+		.distance = event->distance,
+		.tilt_x = event->tilt_x,
+		.tilt_y = event->tilt_y,
+		.rotation = event->rotation,
+		.slider = event->slider,
+		.wheel_delta = event->wheel_delta,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TABLET_TOOL_AXIS, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_tablet_tool_proximity(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, tablet_tool_proximity);
+	struct wlr_event_tablet_tool_proximity *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = recorder_get_tool_id(device->recorder, device->id, event->tool),
+		.state = event->state,
+		.x = event->x,
+		.y = event->y,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TABLET_TOOL_PROXIMITY,
+		device->id, &payload, sizeof(payload));
+}
+
+static void handle_tablet_tool_tip(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, tablet_tool_tip);
+	struct wlr_event_tablet_tool_tip *event = data;
+	struct input_trace_position payload = {
+		.time_msec = event->time_msec,
+		.id = recorder_get_tool_id(device->recorder, device->id, event->tool),
+		.state = event->state,
+		.x = event->x,
+		.y = event->y,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TABLET_TOOL_TIP, device->id,
+		&payload, sizeof(payload));
+}
+
+static void handle_tablet_tool_button(struct wl_listener *listener,
+		void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, tablet_tool_button);
+	struct wlr_event_tablet_tool_button *event = data;
+	struct input_trace_button payload = {
+		.time_msec = event->time_msec,
+		.tool = recorder_get_tool_id(device->recorder, device->id,
+			event->tool),
+		.button = event->button,
+		.state = event->state,
+	};
+	recorder_write(device->recorder, INPUT_TRACE_TABLET_TOOL_BUTTON,
+		device->id, &payload, sizeof(payload));
+}
+
+static void device_destroy(struct wlr_input_recorder_device *device) {
+	switch (device->device->type) {
+	case WLR_INPUT_DEVICE_POINTER:
+		wl_list_remove(&device->pointer_motion.link);
+		wl_list_remove(&device->pointer_motion_absolute.link);
+		wl_list_remove(&device->pointer_button.link);
+		wl_list_remove(&device->pointer_axis.link);
+		wl_list_remove(&device->pointer_frame.link);
+		wl_list_remove(&device->pointer_swipe_begin.link);
+		wl_list_remove(&device->pointer_swipe_update.link);
+		wl_list_remove(&device->pointer_swipe_end.link);
+		wl_list_remove(&device->pointer_pinch_begin.link);
+		wl_list_remove(&device->pointer_pinch_update.link);
+		wl_list_remove(&device->pointer_pinch_end.link);
+		break;
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		wl_list_remove(&device->keyboard_key.link);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:
+		wl_list_remove(&device->touch_down.link);
+		wl_list_remove(&device->touch_up.link);
+		wl_list_remove(&device->touch_motion.link);
+		wl_list_remove(&device->touch_cancel.link);
+		break;
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		wl_list_remove(&device->tablet_tool_axis.link);
+		wl_list_remove(&device->tablet_tool_proximity.link);
+		wl_list_remove(&device->tablet_tool_tip.link);
+		wl_list_remove(&device->tablet_tool_button.link);
+		break;
+	default:
+		assert(false);
+	}
+	wl_list_remove(&device->destroy.link);
+	wl_list_remove(&device->link);
+	free(device);
+}
+
+static void device_handle_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_input_recorder_device *device =
+		wl_container_of(listener, device, destroy);
+	recorder_write(device->recorder, INPUT_TRACE_DEVICE_REMOVE, device->id,
+		NULL, 0);
+	device_destroy(device);
+}
+
+bool wlr_input_recorder_add_device(struct wlr_input_recorder *recorder,
+		struct wlr_input_device *wlr_device) {
+	struct wlr_input_recorder_device *device;
+	wl_list_for_each(device, &recorder->devices, link) {
+		if (device->device == wlr_device) {
+			return true;
+		}
+	}
+
+	switch (wlr_device->type) {
+	case WLR_INPUT_DEVICE_POINTER:
+	case WLR_INPUT_DEVICE_KEYBOARD:
+	case WLR_INPUT_DEVICE_TOUCH:
+	case WLR_INPUT_DEVICE_TABLET_TOOL:
+		break;
+	default:
+		wlr_log(WLR_DEBUG, "Not recording input device '%s': "
+			"unsupported type", wlr_device->name);
+		return false;
+	}
+
+	device = calloc(1, sizeof(struct wlr_input_recorder_device));
+	if (device == NULL) {
+		return false;
+	}
+	device->recorder = recorder;
+	device->device = wlr_device;
+	device->id = ++recorder->last_device_id;
+
+	struct input_trace_device payload = {
+		.type = wlr_device->type,
+		.vendor = wlr_device->vendor,
+		.product = wlr_device->product,
+	};
+	if (wlr_device->name != NULL) {
+		strncpy(payload.name, wlr_device->name, sizeof(payload.name) - 1);
+	}
+	recorder_write(recorder, INPUT_TRACE_DEVICE_ADD, device->id,
+		&payload, sizeof(payload));
+
+	switch (wlr_device->type) {
+	case WLR_INPUT_DEVICE_POINTER:;
+		struct wlr_pointer *pointer = wlr_device->pointer;
+		device->pointer_motion.notify = handle_pointer_motion;
+		wl_signal_add(&pointer->events.motion, &device->pointer_motion);
+		device->pointer_motion_absolute.notify = handle_pointer_motion_absolute;
+		wl_signal_add(&pointer->events.motion_absolute,
+			&device->pointer_motion_absolute);
+		device->pointer_button.notify = handle_pointer_button;
+		wl_signal_add(&pointer->events.button, &device->pointer_button);
+		device->pointer_axis.notify = handle_pointer_axis;
+		wl_signal_add(&pointer->events.axis, &device->pointer_axis);
+		device->pointer_frame.notify = handle_pointer_frame;
+		wl_signal_add(&pointer->events.frame, &device->pointer_frame);
+		device->pointer_swipe_begin.notify = handle_pointer_swipe_begin;
+		wl_signal_add(&pointer->events.swipe_begin,
+			&device->pointer_swipe_begin);
+		device->pointer_swipe_update.notify = handle_pointer_swipe_update;
+		wl_signal_add(&pointer->events.swipe_update,
+			&device->pointer_swipe_update);
+		device->pointer_swipe_end.notify = handle_pointer_swipe_end;
+		wl_signal_add(&pointer->events.swipe_end, &device->pointer_swipe_end);
+		device->pointer_pinch_begin.notify = handle_pointer_pinch_begin;
+		wl_signal_add(&pointer->events.pinch_begin,
+			&device->pointer_pinch_begin);
+		device->pointer_pinch_update.notify = handle_pointer_pinch_update;
+		wl_signal_add(&pointer->events.pinch_update,
+			&device->pointer_pinch_update);
+		device->pointer_pinch_end.notify = handle_pointer_pinch_end;
+		wl_signal_add(&pointer->events.pinch_end, &device->pointer_pinch_end);
+		break;
+	case WLR_INPUT_DEVICE_KEYBOARD:
+		device->keyboard_key.notify = handle_keyboard_key;
+		wl_signal_add(&wlr_device->keyboard->events.key,
+			&device->keyboard_key);
+		break;
+	case WLR_INPUT_DEVICE_TOUCH:;
+		struct wlr_touch *touch = wlr_device->touch;
+		device->touch_down.notify = handle_touch_down;
+		wl_signal_add(&touch->events.down, &device->touch_down);
+		device->touch_up.notify = handle_touch_up;
+		wl_signal_add(&touch->events.up, &device->touch_up);
+		device->touch_motion.notify = handle_touch_motion;
+		wl_signal_add(&touch->events.motion, &device->touch_motion);
+		device->touch_cancel.notify = handle_touch_cancel;
+		wl_signal_add(&touch->events.cancel, &device->touch_cancel);
+		break;
+	case WLR_INPUT_DEVICE_TABLET_TOOL:;
+		struct wlr_tablet *tablet = wlr_device->tablet;
+		device->tablet_tool_axis.notify = handle_tablet_tool_axis;
+		wl_signal_add(&tablet->events.axis, &device->tablet_tool_axis);
+		device->tablet_tool_proximity.notify = handle_tablet_tool_proximity;
+		wl_signal_add(&tablet->events.proximity,
+			&device->tablet_tool_proximity);
+		device->tablet_tool_tip.notify = handle_tablet_tool_tip;
+		wl_signal_add(&tablet->events.tip, &device->tablet_tool_tip);
+		device->tablet_tool_button.notify = handle_tablet_tool_button;
+		wl_signal_add(&tablet->events.button, &device->tablet_tool_button);
+		break;
+	default:
+		assert(false);
+	}
+
+	device->destroy.notify = device_handle_destroy;
+	wl_signal_add(&wlr_device->events.destroy, &device->destroy);
+	wl_list_insert(&recorder->devices, &device->link);
+	return true;
+}
+
+struct wlr_input_recorder *wlr_input_recorder_create(const char *path) {
+	struct wlr_input_recorder *recorder =
+		calloc(1, sizeof(struct wlr_input_recorder));
+	if (recorder == NULL) {
+		return NULL;
+	}
+
+	recorder->file = fopen(path, "we");
+	if (recorder->file == NULL) {
+		wlr_log_errno(WLR_ERROR, "Failed to open input trace %s", path);
+		free(recorder);
+		return NULL;
+	}
+	// A large buffer keeps write syscalls off the input path
+	setvbuf(recorder->file, NULL, _IOFBF, RECORDER_BUFFER_SIZE);
+
+	struct input_trace_header header = {0};
+	memcpy(header.magic, INPUT_TRACE_MAGIC, sizeof(header.magic));
+	if (fwrite(&header, sizeof(header), 1, recorder->file) != 1) {
+		wlr_log_errno(WLR_ERROR, "Failed to write input trace %s", path);
+		fclose(recorder->file);
+		free(recorder);
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &recorder->start);
+	wl_list_init(&recorder->devices);
+	wl_list_init(&recorder->tools);
+
+	wlr_log(WLR_INFO, "Recording input events to %s", path);
+	return recorder;
+}
+
+bool wlr_input_recorder_flush(struct wlr_input_recorder *recorder) {
+	if (!recorder->failed && fflush(recorder->file) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to write input trace");
+		recorder->failed = true;
+	}
+	return !recorder->failed;
+}
+
+void wlr_input_recorder_destroy(struct wlr_input_recorder *recorder) {
+	if (recorder == NULL) {
+		return;
+	}
+
+	struct wlr_input_recorder_device *device, *device_tmp;
+	wl_list_for_each_safe(device, device_tmp, &recorder->devices, link) {
+		device_destroy(device);
+	}
+	struct wlr_input_recorder_tool *tool, *tool_tmp;
+	wl_list_for_each_safe(tool, tool_tmp, &recorder->tools, link) {
+		tool_destroy(tool);
+	}
+
+	if (fclose(recorder->file) != 0 && !recorder->failed) {
+		wlr_log_errno(WLR_ERROR, "Failed to write input trace");
+	}
+	wlr_log(WLR_INFO, "Recorded %"PRIu64" input events", recorder->events);
+	free(recorder);
+}
@@ -2,10 +2,12 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/util/log.h>
+#include "util/shm.h"
 #include "util/signal.h"
 
 static void keyboard_led_update(struct wlr_keyboard *keyboard) {
@@ -118,6 +120,8 @@ void wlr_keyboard_init(struct wlr_keyboard *kb,
 	wl_signal_init(&kb->events.repeat_info);
 	wl_signal_init(&kb->events.destroy);
 
+	kb->keymap_fd = -1;
+
 	// Sane defaults
 	kb->repeat_info.rate = 25;
 	kb->repeat_info.delay = 600;
@@ -131,6 +135,9 @@ void wlr_keyboard_destroy(struct wlr_keyboard *kb) {
 	xkb_state_unref(kb->xkb_state);
 	xkb_keymap_unref(kb->keymap);
 	free(kb->keymap_string);
+	if (kb->keymap_fd >= 0) {
+		close(kb->keymap_fd);
+	}
 	if (kb->impl && kb->impl->destroy) {
 		kb->impl->destroy(kb);
 	} else {
@@ -191,6 +198,20 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 	kb->keymap_string = tmp_keymap_string;
 	kb->keymap_size = strlen(kb->keymap_string) + 1;
 
+	// All clients are sent the same file, so it's only written once per
+	// keymap change
+	int keymap_fd = create_readonly_shm_file(kb->keymap_string,
+		kb->keymap_size);
+	if (keymap_fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to create a keymap file for %zu bytes",
+			kb->keymap_size);
+		goto err;
+	}
+	if (kb->keymap_fd >= 0) {
+		close(kb->keymap_fd);
+	}
+	kb->keymap_fd = keymap_fd;
+
 	for (size_t i = 0; i < kb->num_keycodes; ++i) {
 		xkb_keycode_t keycode = kb->keycodes[i] + 8;
 		xkb_state_update_key(kb->xkb_state, keycode, XKB_KEY_DOWN);
@@ -208,6 +229,10 @@ err:
 	kb->keymap = NULL;
 	free(kb->keymap_string);
 	kb->keymap_string = NULL;
+	if (kb->keymap_fd >= 0) {
+		close(kb->keymap_fd);
+		kb->keymap_fd = -1;
+	}
 	return false;
 }
 
@@ -20,6 +20,11 @@
 
 #define OUTPUT_VERSION 3
 
+// How many frames are used to predict the render duration
+#define FRAME_DELAY_PREDICTION_FRAMES 16
+// Extra time given to the compositor on top of the predicted render duration
+#define FRAME_DELAY_MARGIN_NSEC 1500000
+
 static void send_geometry(struct wl_resource *resource) {
 	struct wlr_output *output = wlr_output_from_resource(resource);
 	wl_output_send_geometry(resource, 0, 0,
@@ -326,6 +331,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	output->scale = 1;
 	output->commit_seq = 0;
 	wl_list_init(&output->cursors);
+	wl_list_init(&output->overlays);
 	wl_list_init(&output->resources);
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.damage);
@@ -333,6 +339,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_signal_init(&output->events.precommit);
 	wl_signal_init(&output->events.commit);
 	wl_signal_init(&output->events.present);
+	wl_signal_init(&output->events.frame_stats);
 	wl_signal_init(&output->events.enable);
 	wl_signal_init(&output->events.mode);
 	wl_signal_init(&output->events.scale);
@@ -371,6 +378,11 @@ void wlr_output_destroy(struct wlr_output *output) {
 		wlr_output_cursor_destroy(cursor);
 	}
 
+	struct wlr_output_overlay *overlay, *tmp_overlay;
+	wl_list_for_each_safe(overlay, tmp_overlay, &output->overlays, link) {
+		wlr_output_overlay_destroy(overlay);
+	}
+
 	if (output->idle_frame != NULL) {
 		wl_event_source_remove(output->idle_frame);
 	}
@@ -379,6 +391,10 @@ void wlr_output_destroy(struct wlr_output *output) {
 		wl_event_source_remove(output->idle_done);
 	}
 
+	if (output->frame_delay.timer != NULL) {
+		wl_event_source_remove(output->frame_delay.timer);
+	}
+
 	free(output->description);
 
 	pixman_region32_fini(&output->pending.damage);
@@ -436,6 +452,8 @@ static void output_state_clear_buffer(struct wlr_output_state *state) {
 }
 
 bool wlr_output_attach_render(struct wlr_output *output, int *buffer_age) {
+	clock_gettime(CLOCK_MONOTONIC, &output->frame_timings.render_start);
+
 	if (!output->impl->attach_render(output, buffer_age)) {
 		return false;
 	}
@@ -470,7 +488,16 @@ void wlr_output_set_damage(struct wlr_output *output,
 static void output_state_clear(struct wlr_output_state *state) {
 	output_state_clear_buffer(state);
 	pixman_region32_clear(&state->damage);
-	state->committed = 0;
+	// Overlay changes stay pending until they're applied along with a buffer,
+	// the overlay state itself lives in the overlays
+	state->committed &= WLR_OUTPUT_STATE_OVERLAYS;
+}
+
+static void output_reset_overlays(struct wlr_output *output) {
+	struct wlr_output_overlay *overlay;
+	wl_list_for_each(overlay, &output->overlays, link) {
+		overlay->accepted = false;
+	}
 }
 
 static void output_pending_resolution(struct wlr_output *output, int *width,
@@ -551,9 +578,109 @@ bool wlr_output_test(struct wlr_output *output) {
 	if (!output_basic_test(output)) {
 		return false;
 	}
+	if (output->pending.committed & WLR_OUTPUT_STATE_OVERLAYS) {
+		output_reset_overlays(output);
+	}
 	return output->impl->test(output);
 }
 
+static void output_finish_frame_timing(struct wlr_output *output,
+		struct wlr_output_frame_timing *timing,
+		enum wlr_output_frame_timing_state state) {
+	timing->state = state;
+	if (state == WLR_OUTPUT_FRAME_TIMING_PRESENTED) {
+		output->frame_timings.presented++;
+	} else {
+		output->frame_timings.discarded++;
+	}
+
+	struct wlr_output_event_frame_stats event = {
+		.output = output,
+		.timing = timing,
+	};
+	wlr_signal_emit_safe(&output->events.frame_stats, &event);
+}
+
+static struct wlr_output_frame_timing *output_begin_frame_timing(
+		struct wlr_output *output, const struct timespec *now) {
+	struct wlr_output_frame_timing *timing =
+		&output->frame_timings.records[output->frame_timings.idx];
+	if (output->frame_timings.len == WLR_OUTPUT_FRAME_TIMING_LEN &&
+			timing->state == WLR_OUTPUT_FRAME_TIMING_PENDING) {
+		output_finish_frame_timing(output, timing,
+			WLR_OUTPUT_FRAME_TIMING_DISCARDED);
+	}
+
+	memset(timing, 0, sizeof(*timing));
+	timing->commit_seq = output->commit_seq + 1;
+	timing->state = WLR_OUTPUT_FRAME_TIMING_PENDING;
+	if (output->pending.buffer_type == WLR_OUTPUT_STATE_BUFFER_RENDER) {
+		timing->render_start = output->frame_timings.render_start;
+	}
+	timing->commit = *now;
+
+	output->frame_timings.idx =
+		(output->frame_timings.idx + 1) % WLR_OUTPUT_FRAME_TIMING_LEN;
+	if (output->frame_timings.len < WLR_OUTPUT_FRAME_TIMING_LEN) {
+		output->frame_timings.len++;
+	}
+	return timing;
+}
+
+static void output_abort_frame_timing(struct wlr_output *output) {
+	output->frame_timings.idx = (output->frame_timings.idx +
+		WLR_OUTPUT_FRAME_TIMING_LEN - 1) % WLR_OUTPUT_FRAME_TIMING_LEN;
+	output->frame_timings.len--;
+}
+
+static void output_present_frame_timing(struct wlr_output *output,
+		const struct wlr_output_event_present *event,
+		const struct timespec *flip) {
+	struct wlr_output_frame_timing *timing = NULL;
+	for (size_t i = output->frame_timings.len; i > 0; --i) {
+		size_t j = (output->frame_timings.idx + WLR_OUTPUT_FRAME_TIMING_LEN -
+			i) % WLR_OUTPUT_FRAME_TIMING_LEN;
+		struct wlr_output_frame_timing *cur = &output->frame_timings.records[j];
+		if (cur->state != WLR_OUTPUT_FRAME_TIMING_PENDING) {
+			continue;
+		}
+		if (cur->commit_seq == event->commit_seq) {
+			timing = cur;
+			break;
+		}
+		if ((int32_t)(cur->commit_seq - event->commit_seq) < 0) {
+			// A more recent frame has been presented, this one won't be
+			output_finish_frame_timing(output, cur,
+				WLR_OUTPUT_FRAME_TIMING_DISCARDED);
+		}
+	}
+	if (timing == NULL) {
+		return;
+	}
+
+	timing->flip = *flip;
+	timing->present = *event->when;
+	timing->present_seq = event->seq;
+	timing->present_refresh = event->refresh;
+	timing->present_flags = event->flags;
+	output_finish_frame_timing(output, timing,
+		WLR_OUTPUT_FRAME_TIMING_PRESENTED);
+}
+
+size_t wlr_output_get_frame_timings(struct wlr_output *output,
+		struct wlr_output_frame_timing *timings, size_t max) {
+	size_t n = output->frame_timings.len;
+	if (n > max) {
+		n = max;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		size_t j = (output->frame_timings.idx + WLR_OUTPUT_FRAME_TIMING_LEN -
+			n + i) % WLR_OUTPUT_FRAME_TIMING_LEN;
+		timings[i] = output->frame_timings.records[j];
+	}
+	return n;
+}
+
 bool wlr_output_commit(struct wlr_output *output) {
 	if (!output_basic_test(output)) {
 		wlr_log(WLR_ERROR, "Basic output test failed");
@@ -565,6 +692,11 @@ bool wlr_output_commit(struct wlr_output *output) {
 		wl_event_source_remove(output->idle_frame);
 		output->idle_frame = NULL;
 	}
+	if ((output->pending.committed & WLR_OUTPUT_STATE_BUFFER) &&
+			output->frame_delay.pending) {
+		wl_event_source_timer_update(output->frame_delay.timer, 0);
+		output->frame_delay.pending = false;
+	}
 
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
@@ -575,7 +707,27 @@ bool wlr_output_commit(struct wlr_output *output) {
 	};
 	wlr_signal_emit_safe(&output->events.precommit, &event);
 
+	struct wlr_output_frame_timing *timing = NULL;
+	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		timing = output_begin_frame_timing(output, &now);
+	}
+
+	bool overlays_updated = (output->pending.committed &
+		(WLR_OUTPUT_STATE_BUFFER | WLR_OUTPUT_STATE_OVERLAYS)) ==
+		(WLR_OUTPUT_STATE_BUFFER | WLR_OUTPUT_STATE_OVERLAYS);
+	if (overlays_updated) {
+		output_reset_overlays(output);
+	}
+
+	if (timing != NULL) {
+		// Backends may present the frame before returning
+		clock_gettime(CLOCK_MONOTONIC, &timing->submit);
+	}
+
 	if (!output->impl->commit(output)) {
+		if (timing != NULL) {
+			output_abort_frame_timing(output);
+		}
 		output_state_clear(&output->pending);
 		return false;
 	}
@@ -627,6 +779,9 @@ bool wlr_output_commit(struct wlr_output *output) {
 	}
 
 	output_state_clear(&output->pending);
+	if (overlays_updated) {
+		output->pending.committed &= ~WLR_OUTPUT_STATE_OVERLAYS;
+	}
 	return true;
 }
 
@@ -646,11 +801,170 @@ void wlr_output_attach_buffer(struct wlr_output *output,
 	output->pending.buffer = wlr_buffer_lock(buffer);
 }
 
-void wlr_output_send_frame(struct wlr_output *output) {
+struct wlr_output_overlay *wlr_output_overlay_create(struct wlr_output *output) {
+	struct wlr_output_overlay *overlay =
+		calloc(1, sizeof(struct wlr_output_overlay));
+	if (overlay == NULL) {
+		return NULL;
+	}
+	overlay->output = output;
+	wl_list_insert(output->overlays.prev, &overlay->link);
+	return overlay;
+}
+
+void wlr_output_overlay_attach_buffer(struct wlr_output_overlay *overlay,
+		struct wlr_buffer *buffer, const struct wlr_box *dst_box) {
+	if (buffer != NULL) {
+		wlr_buffer_lock(buffer);
+	}
+	wlr_buffer_unlock(overlay->buffer);
+	overlay->buffer = buffer;
+	if (dst_box != NULL) {
+		overlay->dst_box = *dst_box;
+	}
+	if (buffer == NULL) {
+		overlay->accepted = false;
+	}
+	overlay->output->pending.committed |= WLR_OUTPUT_STATE_OVERLAYS;
+}
+
+void wlr_output_overlay_destroy(struct wlr_output_overlay *overlay) {
+	if (overlay == NULL) {
+		return;
+	}
+	wlr_buffer_unlock(overlay->buffer);
+	overlay->output->pending.committed |= WLR_OUTPUT_STATE_OVERLAYS;
+	wl_list_remove(&overlay->link);
+	free(overlay);
+}
+
+static int64_t timespec_to_nsec(const struct timespec *t) {
+	return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+/**
+ * Predict how long the compositor needs to render and commit a frame, from
+ * the slowest of the last presented frames. Returns -1 if unknown.
+ */
+static int64_t output_predict_render_duration(struct wlr_output *output) {
+	int64_t duration = -1;
+	size_t n = 0;
+	for (size_t i = 1; i <= output->frame_timings.len &&
+			n < FRAME_DELAY_PREDICTION_FRAMES; ++i) {
+		size_t j = (output->frame_timings.idx + WLR_OUTPUT_FRAME_TIMING_LEN -
+			i) % WLR_OUTPUT_FRAME_TIMING_LEN;
+		struct wlr_output_frame_timing *timing =
+			&output->frame_timings.records[j];
+		if (timing->state != WLR_OUTPUT_FRAME_TIMING_PRESENTED) {
+			continue;
+		}
+
+		// Frames attached with wlr_output_attach_buffer aren't rendered
+		const struct timespec *start = &timing->render_start;
+		if (timespec_to_nsec(start) == 0) {
+			start = &timing->commit;
+		}
+		int64_t d = timespec_to_nsec(&timing->submit) -
+			timespec_to_nsec(start);
+		if (d > duration) {
+			duration = d;
+		}
+		n++;
+	}
+	return duration;
+}
+
+/**
+ * Compute how long the `frame` event can be delayed, in milliseconds.
+ */
+static int output_get_frame_delay(struct wlr_output *output) {
+	if (output->frame_timings.len == 0) {
+		return 0;
+	}
+	size_t last = (output->frame_timings.idx + WLR_OUTPUT_FRAME_TIMING_LEN -
+		1) % WLR_OUTPUT_FRAME_TIMING_LEN;
+	struct wlr_output_frame_timing *timing =
+		&output->frame_timings.records[last];
+	if (timing->state != WLR_OUTPUT_FRAME_TIMING_PRESENTED ||
+			timing->present_refresh <= 0 ||
+			!(timing->present_flags & WLR_OUTPUT_PRESENT_VSYNC)) {
+		return 0;
+	}
+
+	int64_t render_duration = output_predict_render_duration(output);
+	if (render_duration < 0) {
+		return 0;
+	}
+
+	clockid_t clock = wlr_backend_get_presentation_clock(output->backend);
+	struct timespec now;
+	if (clock_gettime(clock, &now) != 0) {
+		return 0;
+	}
+
+	int64_t next_vblank = timespec_to_nsec(&timing->present) +
+		timing->present_refresh;
+	int64_t delay = next_vblank - timespec_to_nsec(&now) - render_duration -
+		FRAME_DELAY_MARGIN_NSEC;
+	if (delay <= 0 || delay >= timing->present_refresh) {
+		return 0;
+	}
+	return delay / 1000000;
+}
+
+static void output_emit_frame(struct wlr_output *output) {
 	output->frame_pending = false;
 	wlr_signal_emit_safe(&output->events.frame, output);
 }
 
+static int handle_frame_delay_timer(void *data) {
+	struct wlr_output *output = data;
+	output->frame_delay.pending = false;
+	output_emit_frame(output);
+	return 0;
+}
+
+void wlr_output_send_frame(struct wlr_output *output) {
+	if (output->frame_delay.pending) {
+		// A delayed `frame` event is already on its way
+		return;
+	}
+	if (!output->frame_delay.enabled) {
+		output_emit_frame(output);
+		return;
+	}
+
+	int delay = output_get_frame_delay(output);
+	if (delay == 0) {
+		output_emit_frame(output);
+		return;
+	}
+
+	if (output->frame_delay.timer == NULL) {
+		struct wl_event_loop *ev = wl_display_get_event_loop(output->display);
+		output->frame_delay.timer =
+			wl_event_loop_add_timer(ev, handle_frame_delay_timer, output);
+		if (output->frame_delay.timer == NULL) {
+			output_emit_frame(output);
+			return;
+		}
+	}
+
+	// Keep frame_pending set until the timer fires
+	output->frame_pending = true;
+	output->frame_delay.pending = true;
+	wl_event_source_timer_update(output->frame_delay.timer, delay);
+}
+
+void wlr_output_enable_frame_delay(struct wlr_output *output, bool enabled) {
+	output->frame_delay.enabled = enabled;
+	if (!enabled && output->frame_delay.pending) {
+		wl_event_source_timer_update(output->frame_delay.timer, 0);
+		output->frame_delay.pending = false;
+		output_emit_frame(output);
+	}
+}
+
 static void schedule_frame_handle_idle_timer(void *data) {
 	struct wlr_output *output = data;
 	output->idle_frame = NULL;
@@ -686,6 +1000,9 @@ void wlr_output_send_present(struct wlr_output *output,
 
 	event->output = output;
 
+	struct timespec flip;
+	clock_gettime(CLOCK_MONOTONIC, &flip);
+
 	struct timespec now;
 	if (event->when == NULL) {
 		clockid_t clock = wlr_backend_get_presentation_clock(output->backend);
@@ -698,6 +1015,8 @@ void wlr_output_send_present(struct wlr_output *output,
 		event->when = &now;
 	}
 
+	output_present_frame_timing(output, event, &flip);
+
 	wlr_signal_emit_safe(&output->events.present, event);
 }
 
@@ -983,6 +1302,38 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 	return false;
 }
 
+/**
+ * Show a cursor texture from the renderer's cache. The reference to the
+ * texture is moved to the cursor, NULL hides the cursor.
+ */
+static void output_cursor_set_texture(struct wlr_output_cursor *cursor,
+		struct wlr_renderer *renderer, struct wlr_texture *texture,
+		int32_t hotspot_x, int32_t hotspot_y) {
+	output_cursor_reset(cursor);
+
+	int width = 0, height = 0;
+	if (texture != NULL) {
+		wlr_texture_get_size(texture, &width, &height);
+	}
+	cursor->width = width;
+	cursor->height = height;
+	cursor->hotspot_x = hotspot_x;
+	cursor->hotspot_y = hotspot_y;
+	output_cursor_update_visible(cursor);
+
+	wlr_renderer_cursor_texture_unref(renderer, cursor->texture);
+	cursor->texture = texture;
+	cursor->enabled = texture != NULL;
+
+	if (output_cursor_attempt_hardware(cursor)) {
+		return;
+	}
+
+	wlr_log(WLR_DEBUG, "Falling back to software cursor on output '%s'",
+		cursor->output->name);
+	output_cursor_damage_whole(cursor);
+}
+
 bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 		const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height,
 		int32_t hotspot_x, int32_t hotspot_y) {
@@ -994,34 +1345,39 @@ bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 		return true;
 	}
 
-	output_cursor_reset(cursor);
-
-	cursor->width = width;
-	cursor->height = height;
-	cursor->hotspot_x = hotspot_x;
-	cursor->hotspot_y = hotspot_y;
-	output_cursor_update_visible(cursor);
-
-	wlr_texture_destroy(cursor->texture);
-	cursor->texture = NULL;
-
-	cursor->enabled = false;
+	// Cursor textures are shared through the renderer's cache: take the new
+	// reference before dropping the old one, so that setting the same image
+	// again doesn't upload it again
+	struct wlr_texture *texture = NULL;
 	if (pixels != NULL) {
-		cursor->texture = wlr_texture_from_pixels(renderer,
-			WL_SHM_FORMAT_ARGB8888, stride, width, height, pixels);
-		if (cursor->texture == NULL) {
+		texture = wlr_renderer_cursor_texture_get(renderer,
+			pixels, stride, width, height);
+		if (texture == NULL) {
+			output_cursor_set_texture(cursor, renderer, NULL,
+				hotspot_x, hotspot_y);
 			return false;
 		}
-		cursor->enabled = true;
 	}
 
-	if (output_cursor_attempt_hardware(cursor)) {
+	output_cursor_set_texture(cursor, renderer, texture, hotspot_x, hotspot_y);
+	return true;
+}
+
+bool wlr_output_cursor_set_texture(struct wlr_output_cursor *cursor,
+		struct wlr_texture *texture, int32_t hotspot_x, int32_t hotspot_y) {
+	struct wlr_renderer *renderer =
+		wlr_backend_get_renderer(cursor->output->backend);
+	if (!renderer) {
 		return true;
 	}
 
-	wlr_log(WLR_DEBUG, "Falling back to software cursor on output '%s'",
-		cursor->output->name);
-	output_cursor_damage_whole(cursor);
+	if (texture != NULL && !wlr_renderer_cursor_texture_ref(renderer, texture)) {
+		wlr_log(WLR_ERROR, "Cursor texture doesn't come from the renderer's "
+			"cursor texture cache");
+		return false;
+	}
+
+	output_cursor_set_texture(cursor, renderer, texture, hotspot_x, hotspot_y);
 	return true;
 }
 
@@ -1176,7 +1532,11 @@ void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor) {
 		}
 		cursor->output->hardware_cursor = NULL;
 	}
-	wlr_texture_destroy(cursor->texture);
+	if (cursor->texture != NULL) {
+		wlr_renderer_cursor_texture_unref(
+			wlr_backend_get_renderer(cursor->output->backend),
+			cursor->texture);
+	}
 	wl_list_remove(&cursor->link);
 	free(cursor);
 }
@@ -5,6 +5,7 @@
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/util/region.h>
 #include "util/signal.h"
 
 static void output_handle_destroy(struct wl_listener *listener, void *data) {
@@ -70,8 +71,8 @@ static void output_handle_commit(struct wl_listener *listener, void *data) {
 		// render-buffers have been swapped, rotate the damage
 
 		// same as decrementing, but works on unsigned integers
-		output_damage->previous_idx += WLR_OUTPUT_DAMAGE_PREVIOUS_LEN - 1;
-		output_damage->previous_idx %= WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+		output_damage->previous_idx += output_damage->previous_len - 1;
+		output_damage->previous_idx %= output_damage->previous_len;
 
 		prev = &output_damage->previous[output_damage->previous_idx];
 		pixman_region32_copy(prev, &output_damage->current);
@@ -95,11 +96,21 @@ struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output) {
 
 	output_damage->output = output;
 	output_damage->max_rects = 20;
+	output_damage->tile_size = 32;
 	wl_signal_init(&output_damage->events.frame);
+	wl_signal_init(&output_damage->events.simplify);
 	wl_signal_init(&output_damage->events.destroy);
 
+	output_damage->previous_len = WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+	output_damage->previous = calloc(output_damage->previous_len,
+		sizeof(pixman_region32_t));
+	if (output_damage->previous == NULL) {
+		free(output_damage);
+		return NULL;
+	}
+
 	pixman_region32_init(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_init(&output_damage->previous[i]);
 	}
 
@@ -137,12 +148,65 @@ void wlr_output_damage_destroy(struct wlr_output_damage *output_damage) {
 	wl_list_remove(&output_damage->output_frame.link);
 	wl_list_remove(&output_damage->output_commit.link);
 	pixman_region32_fini(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_fini(&output_damage->previous[i]);
 	}
+	free(output_damage->previous);
 	free(output_damage);
 }
 
+bool wlr_output_damage_set_history_len(struct wlr_output_damage *output_damage,
+		size_t len) {
+	if (len == 0) {
+		len = 1;
+	}
+	if (len == output_damage->previous_len) {
+		return true;
+	}
+
+	pixman_region32_t *previous = calloc(len, sizeof(pixman_region32_t));
+	if (previous == NULL) {
+		return false;
+	}
+
+	int width, height;
+	wlr_output_transformed_resolution(output_damage->output, &width, &height);
+
+	// Keep the most recent frames, and assume that the frames we don't know
+	// anything about damaged the whole output
+	for (size_t i = 0; i < len; ++i) {
+		if (i < output_damage->previous_len) {
+			size_t j = (output_damage->previous_idx + i) %
+				output_damage->previous_len;
+			pixman_region32_init(&previous[i]);
+			pixman_region32_copy(&previous[i], &output_damage->previous[j]);
+		} else {
+			pixman_region32_init_rect(&previous[i], 0, 0, width, height);
+		}
+	}
+
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
+		pixman_region32_fini(&output_damage->previous[i]);
+	}
+	free(output_damage->previous);
+
+	output_damage->previous = previous;
+	output_damage->previous_len = len;
+	output_damage->previous_idx = 0;
+	return true;
+}
+
+static uint64_t region_area(pixman_region32_t *region) {
+	uint64_t area = 0;
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+			(uint64_t)(rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
 bool wlr_output_damage_attach_render(struct wlr_output_damage *output_damage,
 		bool *needs_frame, pixman_region32_t *damage) {
 	struct wlr_output *output = output_damage->output;
@@ -152,10 +216,18 @@ bool wlr_output_damage_attach_render(struct wlr_output_damage *output_damage,
 		return false;
 	}
 
+	output_damage->stats.frames++;
+	if (buffer_age > output_damage->stats.max_buffer_age) {
+		output_damage->stats.max_buffer_age = buffer_age;
+	}
+
 	*needs_frame =
 		output->needs_frame || pixman_region32_not_empty(&output_damage->current);
 	// Check if we can use damage tracking
-	if (buffer_age <= 0 || buffer_age - 1 > WLR_OUTPUT_DAMAGE_PREVIOUS_LEN) {
+	if (buffer_age <= 0 ||
+			(size_t)(buffer_age - 1) > output_damage->previous_len) {
+		output_damage->stats.full_damage_frames++;
+
 		int width, height;
 		wlr_output_transformed_resolution(output, &width, &height);
 
@@ -168,16 +240,31 @@ bool wlr_output_damage_attach_render(struct wlr_output_damage *output_damage,
 		// Accumulate damage from old buffers
 		size_t idx = output_damage->previous_idx;
 		for (int i = 0; i < buffer_age - 1; ++i) {
-			int j = (idx + i) % WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+			size_t j = (idx + i) % output_damage->previous_len;
 			pixman_region32_union(damage, damage, &output_damage->previous[j]);
 		}
 
 		// Check the number of rectangles
 		int n_rects = pixman_region32_n_rects(damage);
 		if (n_rects > output_damage->max_rects) {
-			pixman_box32_t *extents = pixman_region32_extents(damage);
-			pixman_region32_union_rect(damage, damage, extents->x1, extents->y1,
-				extents->x2 - extents->x1, extents->y2 - extents->y1);
+			struct wlr_output_damage_event_simplify event = {
+				.output_damage = output_damage,
+				.damage = damage,
+				.damaged_rects = n_rects,
+				.damaged_pixels = region_area(damage),
+			};
+
+			wlr_region_simplify(damage, damage, output_damage->max_rects,
+				output_damage->tile_size);
+
+			// Don't repaint outside of the output because of the tile grid
+			int width, height;
+			wlr_output_transformed_resolution(output, &width, &height);
+			pixman_region32_intersect_rect(damage, damage, 0, 0, width, height);
+
+			event.redrawn_rects = pixman_region32_n_rects(damage);
+			event.redrawn_pixels = region_area(damage);
+			wlr_signal_emit_safe(&output_damage->events.simplify, &event);
 		}
 	}
 
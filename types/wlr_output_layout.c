@@ -2,6 +2,7 @@
 #include <float.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
@@ -10,6 +11,16 @@
 
 struct wlr_output_layout_state {
 	struct wlr_box _box; // should never be read directly, use the getter
+
+	// Grid index used for point and box lookups. The layout plane is cut into
+	// cells along every output edge, and each cell refers to the first output
+	// in the list covering it. Rebuilt lazily after the layout changes.
+	struct {
+		bool valid;
+		int *xs, *ys; // sorted unique edges
+		size_t xs_len, ys_len;
+		struct wlr_output_layout_output **cells; // (xs_len - 1) * (ys_len - 1)
+	} index;
 };
 
 struct wlr_output_layout_output_state {
@@ -54,6 +65,7 @@ static void output_layout_output_destroy(
 	wl_list_remove(&l_output->state->transform.link);
 	wl_list_remove(&l_output->state->output_destroy.link);
 	wl_list_remove(&l_output->link);
+	l_output->state->layout->state->index.valid = false;
 	free(l_output->state);
 	free(l_output);
 }
@@ -70,6 +82,9 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		output_layout_output_destroy(l_output);
 	}
 
+	free(layout->state->index.xs);
+	free(layout->state->index.ys);
+	free(layout->state->index.cells);
 	free(layout->state);
 	free(layout);
 }
@@ -85,6 +100,132 @@ static struct wlr_box *output_layout_output_get_box(
 	return &l_output->state->_box;
 }
 
+static int compare_int(const void *_a, const void *_b) {
+	int a = *(const int *)_a, b = *(const int *)_b;
+	return (a > b) - (a < b);
+}
+
+static size_t sort_unique_edges(int *edges, size_t len) {
+	qsort(edges, len, sizeof(int), compare_int);
+	size_t n = 0;
+	for (size_t i = 0; i < len; ++i) {
+		if (n == 0 || edges[n - 1] != edges[i]) {
+			edges[n++] = edges[i];
+		}
+	}
+	return n;
+}
+
+/**
+ * Returns the index i such that edges[i] <= v < edges[i + 1], or -1 if v is
+ * outside of the edges.
+ */
+static int find_interval(const int *edges, size_t len, double v) {
+	if (len < 2 || !(v >= edges[0] && v < edges[len - 1])) {
+		return -1;
+	}
+	size_t lo = 0, hi = len - 1;
+	while (hi - lo > 1) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (v < edges[mid]) {
+			hi = mid;
+		} else {
+			lo = mid;
+		}
+	}
+	return lo;
+}
+
+static bool output_layout_build_index(struct wlr_output_layout *layout) {
+	struct wlr_output_layout_state *state = layout->state;
+
+	free(state->index.xs);
+	free(state->index.ys);
+	free(state->index.cells);
+	memset(&state->index, 0, sizeof(state->index));
+
+	size_t n = wl_list_length(&layout->outputs);
+	if (n == 0) {
+		state->index.valid = true;
+		return true;
+	}
+
+	int *xs = calloc(2 * n, sizeof(int));
+	int *ys = calloc(2 * n, sizeof(int));
+	if (xs == NULL || ys == NULL) {
+		goto error;
+	}
+
+	size_t len = 0;
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_box *box = output_layout_output_get_box(l_output);
+		if (wlr_box_empty(box)) {
+			continue;
+		}
+		xs[len] = box->x;
+		xs[len + 1] = box->x + box->width;
+		ys[len] = box->y;
+		ys[len + 1] = box->y + box->height;
+		len += 2;
+	}
+
+	size_t xs_len = sort_unique_edges(xs, len);
+	size_t ys_len = sort_unique_edges(ys, len);
+
+	struct wlr_output_layout_output **cells = NULL;
+	if (len > 0) {
+		cells = calloc((xs_len - 1) * (ys_len - 1), sizeof(cells[0]));
+		if (cells == NULL) {
+			goto error;
+		}
+	}
+
+	// Walk the list backwards, so that the first output wins on overlaps
+	wl_list_for_each_reverse(l_output, &layout->outputs, link) {
+		struct wlr_box *box = output_layout_output_get_box(l_output);
+		if (wlr_box_empty(box)) {
+			continue;
+		}
+		int x1 = find_interval(xs, xs_len, box->x);
+		int x2 = find_interval(xs, xs_len, box->x + box->width - 1);
+		int y1 = find_interval(ys, ys_len, box->y);
+		int y2 = find_interval(ys, ys_len, box->y + box->height - 1);
+		for (int y = y1; y <= y2; ++y) {
+			for (int x = x1; x <= x2; ++x) {
+				cells[y * (xs_len - 1) + x] = l_output;
+			}
+		}
+	}
+
+	state->index.xs = xs;
+	state->index.ys = ys;
+	state->index.xs_len = xs_len;
+	state->index.ys_len = ys_len;
+	state->index.cells = cells;
+	state->index.valid = true;
+	return true;
+
+error:
+	wlr_log(WLR_ERROR, "Failed to allocate output layout index");
+	free(xs);
+	free(ys);
+	return false;
+}
+
+static bool output_layout_ensure_index(struct wlr_output_layout *layout) {
+	if (layout->state->index.valid) {
+		return true;
+	}
+	return output_layout_build_index(layout);
+}
+
+static struct wlr_output_layout_output *output_layout_index_get(
+		struct wlr_output_layout *layout, int col, int row) {
+	struct wlr_output_layout_state *state = layout->state;
+	return state->index.cells[row * (state->index.xs_len - 1) + col];
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -93,6 +234,8 @@ static struct wlr_box *output_layout_output_get_box(
  * the rightmost output in the layout in a horizontal line.
  */
 static void output_layout_reconfigure(struct wlr_output_layout *layout) {
+	layout->state->index.valid = false;
+
 	int max_x = INT_MIN;
 	int max_x_y = INT_MIN; // y value for the max_x output
 
@@ -243,11 +386,53 @@ bool wlr_output_layout_contains_point(struct wlr_output_layout *layout,
 	}
 }
 
+static bool output_layout_index_intersects(struct wlr_output_layout *layout,
+		const struct wlr_box *box) {
+	if (wlr_box_empty(box)) {
+		return false;
+	}
+
+	struct wlr_output_layout_state *state = layout->state;
+	const int *xs = state->index.xs, *ys = state->index.ys;
+	size_t xs_len = state->index.xs_len, ys_len = state->index.ys_len;
+	if (xs_len < 2 || ys_len < 2) {
+		return false;
+	}
+
+	// Clamp the box to the indexed area, then visit the cells it covers
+	int x1 = box->x > xs[0] ? box->x : xs[0];
+	int y1 = box->y > ys[0] ? box->y : ys[0];
+	int x2 = box->x + box->width < xs[xs_len - 1] ?
+		box->x + box->width : xs[xs_len - 1];
+	int y2 = box->y + box->height < ys[ys_len - 1] ?
+		box->y + box->height : ys[ys_len - 1];
+	if (x1 >= x2 || y1 >= y2) {
+		return false;
+	}
+
+	int col1 = find_interval(xs, xs_len, x1);
+	int col2 = find_interval(xs, xs_len, x2 - 1);
+	int row1 = find_interval(ys, ys_len, y1);
+	int row2 = find_interval(ys, ys_len, y2 - 1);
+	for (int row = row1; row <= row2; ++row) {
+		for (int col = col1; col <= col2; ++col) {
+			if (output_layout_index_get(layout, col, row) != NULL) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 		struct wlr_output *reference, const struct wlr_box *target_lbox) {
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
+		if (output_layout_ensure_index(layout)) {
+			return output_layout_index_intersects(layout, target_lbox);
+		}
+
 		struct wlr_output_layout_output *l_output;
 		wl_list_for_each(l_output, &layout->outputs, link) {
 			struct wlr_box *output_box =
@@ -271,6 +456,18 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double lx, double ly) {
+	if (output_layout_ensure_index(layout)) {
+		struct wlr_output_layout_state *state = layout->state;
+		int col = find_interval(state->index.xs, state->index.xs_len, lx);
+		int row = find_interval(state->index.ys, state->index.ys_len, ly);
+		if (col < 0 || row < 0) {
+			return NULL;
+		}
+		struct wlr_output_layout_output *l_output =
+			output_layout_index_get(layout, col, row);
+		return l_output != NULL ? l_output->output : NULL;
+	}
+
 	struct wlr_output_layout_output *l_output;
 	wl_list_for_each(l_output, &layout->outputs, link) {
 		struct wlr_box *box = output_layout_output_get_box(l_output);
@@ -328,6 +525,17 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		return;
 	}
 
+	// A point inside the layout is its own closest point
+	if (reference == NULL && wlr_output_layout_output_at(layout, lx, ly)) {
+		if (dest_lx) {
+			*dest_lx = lx;
+		}
+		if (dest_ly) {
+			*dest_ly = ly;
+		}
+		return;
+	}
+
 	double min_x = 0, min_y = 0, min_distance = DBL_MAX;
 	struct wlr_output_layout_output *l_output;
 	wl_list_for_each(l_output, &layout->outputs, link) {
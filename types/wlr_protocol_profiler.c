@@ -0,0 +1,360 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <wlr/types/wlr_protocol_profiler.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+#define PROFILER_TABLE_MIN_CAP 32
+#define PROFILER_DUMP_CLIENT_ENTRIES 10
+#define PROFILER_DUMP_ENTRIES 20
+#define PROFILER_DEFAULT_TAIL_CAP_NSEC 1000000
+
+static uint64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static size_t table_hash(const struct wl_message *message, size_t cap) {
+	return ((uintptr_t)message >> 3) * 2654435761u & (cap - 1);
+}
+
+static bool table_grow(struct wlr_protocol_profiler_table *table) {
+	size_t cap = table->cap > 0 ? table->cap * 2 : PROFILER_TABLE_MIN_CAP;
+	struct wlr_protocol_profiler_entry *entries =
+		calloc(cap, sizeof(struct wlr_protocol_profiler_entry));
+	if (entries == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < table->cap; i++) {
+		struct wlr_protocol_profiler_entry *entry = &table->entries[i];
+		if (entry->message == NULL) {
+			continue;
+		}
+		size_t j = table_hash(entry->message, cap);
+		while (entries[j].message != NULL) {
+			j = (j + 1) & (cap - 1);
+		}
+		entries[j] = *entry;
+	}
+
+	free(table->entries);
+	table->entries = entries;
+	table->cap = cap;
+	return true;
+}
+
+static struct wlr_protocol_profiler_entry *table_get(
+		struct wlr_protocol_profiler_table *table, const char *interface,
+		const struct wl_message *message) {
+	// Keep the load factor under 3/4
+	if ((table->len + 1) * 4 > table->cap * 3 && !table_grow(table)) {
+		return NULL;
+	}
+
+	size_t i = table_hash(message, table->cap);
+	while (table->entries[i].message != NULL) {
+		if (table->entries[i].message == message) {
+			return &table->entries[i];
+		}
+		i = (i + 1) & (table->cap - 1);
+	}
+
+	struct wlr_protocol_profiler_entry *entry = &table->entries[i];
+	entry->interface = interface;
+	entry->message = message;
+	table->len++;
+	return entry;
+}
+
+static void table_finish(struct wlr_protocol_profiler_table *table) {
+	free(table->entries);
+	memset(table, 0, sizeof(*table));
+}
+
+static void entry_add(struct wlr_protocol_profiler_entry *entry,
+		uint64_t elapsed) {
+	if (entry == NULL) {
+		return;
+	}
+	entry->count++;
+	entry->total_nsec += elapsed;
+	if (elapsed > entry->max_nsec) {
+		entry->max_nsec = elapsed;
+	}
+}
+
+/**
+ * Account the time elapsed since the current request was dispatched. If the
+ * request is the last of its batch, the elapsed time also covers whatever
+ * else the event loop iteration did, and is capped.
+ */
+static void profiler_end_request(struct wlr_protocol_profiler *profiler,
+		uint64_t now, bool last) {
+	struct wlr_protocol_profiler_client *client = profiler->current.client;
+	if (client == NULL) {
+		return;
+	}
+
+	uint64_t elapsed = now - profiler->current.start_nsec;
+	if (last && elapsed > profiler->tail_cap_nsec) {
+		profiler->unattributed_nsec += elapsed - profiler->tail_cap_nsec;
+		elapsed = profiler->tail_cap_nsec;
+	}
+	entry_add(table_get(&client->table, profiler->current.interface,
+		profiler->current.message), elapsed);
+	entry_add(table_get(&profiler->table, profiler->current.interface,
+		profiler->current.message), elapsed);
+	client->requests++;
+	client->total_nsec += elapsed;
+	profiler->requests++;
+	profiler->total_nsec += elapsed;
+
+	profiler->current.client = NULL;
+}
+
+static void client_destroy(struct wlr_protocol_profiler_client *client) {
+	struct wlr_protocol_profiler *profiler = client->profiler;
+	if (profiler->current.client == client) {
+		profiler_end_request(profiler, get_current_time_nsec(), false);
+	}
+
+	wl_list_remove(&client->destroy.link);
+	wl_list_remove(&client->link);
+	table_finish(&client->table);
+	free(client);
+}
+
+static void client_handle_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_protocol_profiler_client *client =
+		wl_container_of(listener, client, destroy);
+	client_destroy(client);
+}
+
+static struct wlr_protocol_profiler_client *client_get_or_create(
+		struct wlr_protocol_profiler *profiler, struct wl_client *wl_client) {
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(wl_client, client_handle_destroy);
+	struct wlr_protocol_profiler_client *client;
+	if (listener != NULL) {
+		client = wl_container_of(listener, client, destroy);
+		// Other profilers may listen to the same client
+		if (client->profiler == profiler) {
+			return client;
+		}
+	}
+
+	wl_list_for_each(client, &profiler->clients, link) {
+		if (client->client == wl_client) {
+			return client;
+		}
+	}
+
+	client = calloc(1, sizeof(struct wlr_protocol_profiler_client));
+	if (client == NULL) {
+		return NULL;
+	}
+	client->client = wl_client;
+	client->profiler = profiler;
+	client->destroy.notify = client_handle_destroy;
+	wl_client_add_destroy_listener(wl_client, &client->destroy);
+	wl_list_insert(&profiler->clients, &client->link);
+	return client;
+}
+
+static void handle_idle(void *data) {
+	struct wlr_protocol_profiler *profiler = data;
+	profiler->idle = NULL;
+	profiler_end_request(profiler, get_current_time_nsec(), true);
+}
+
+static void handle_protocol_message(void *data,
+		enum wl_protocol_logger_type direction,
+		const struct wl_protocol_logger_message *message) {
+	struct wlr_protocol_profiler *profiler = data;
+
+	// Events are sent while handling requests, they don't end them
+	if (direction != WL_PROTOCOL_LOGGER_REQUEST) {
+		return;
+	}
+
+	uint64_t now = get_current_time_nsec();
+	profiler_end_request(profiler, now, false);
+
+	struct wlr_protocol_profiler_client *client = client_get_or_create(
+		profiler, wl_resource_get_client(message->resource));
+	if (client == NULL) {
+		return;
+	}
+
+	profiler->current.client = client;
+	profiler->current.interface = wl_resource_get_class(message->resource);
+	profiler->current.message = message->message;
+	profiler->current.start_nsec = now;
+
+	// The last request of a batch ends when the event loop iteration does
+	if (profiler->idle == NULL) {
+		struct wl_event_loop *loop =
+			wl_display_get_event_loop(profiler->display);
+		profiler->idle = wl_event_loop_add_idle(loop, handle_idle, profiler);
+	}
+}
+
+void wlr_protocol_profiler_reset(struct wlr_protocol_profiler *profiler) {
+	struct wlr_protocol_profiler_client *client;
+	wl_list_for_each(client, &profiler->clients, link) {
+		table_finish(&client->table);
+		client->requests = 0;
+		client->total_nsec = 0;
+	}
+	table_finish(&profiler->table);
+	profiler->requests = 0;
+	profiler->total_nsec = 0;
+	profiler->unattributed_nsec = 0;
+}
+
+void wlr_protocol_profiler_for_each_entry(
+		struct wlr_protocol_profiler *profiler,
+		struct wlr_protocol_profiler_client *client,
+		wlr_protocol_profiler_iterator_func_t iterator, void *data) {
+	struct wlr_protocol_profiler_table *table =
+		client != NULL ? &client->table : &profiler->table;
+	for (size_t i = 0; i < table->cap; i++) {
+		if (table->entries[i].message != NULL) {
+			iterator(&table->entries[i], data);
+		}
+	}
+}
+
+static int entry_cmp(const void *a, const void *b) {
+	const struct wlr_protocol_profiler_entry *entry_a = a, *entry_b = b;
+	if (entry_a->total_nsec != entry_b->total_nsec) {
+		return entry_a->total_nsec < entry_b->total_nsec ? 1 : -1;
+	}
+	return 0;
+}
+
+static void dump_table(struct wlr_protocol_profiler_table *table,
+		size_t max_entries) {
+	struct wlr_protocol_profiler_entry *entries =
+		calloc(table->len, sizeof(struct wlr_protocol_profiler_entry));
+	if (entries == NULL) {
+		return;
+	}
+
+	size_t n = 0;
+	for (size_t i = 0; i < table->cap; i++) {
+		if (table->entries[i].message != NULL) {
+			entries[n++] = table->entries[i];
+		}
+	}
+	qsort(entries, n, sizeof(entries[0]), entry_cmp);
+
+	for (size_t i = 0; i < n && i < max_entries; i++) {
+		struct wlr_protocol_profiler_entry *entry = &entries[i];
+		wlr_log(WLR_INFO, "  %s.%s: %"PRIu64" requests, "
+			"total %"PRIu64" us, avg %"PRIu64" us, max %"PRIu64" us",
+			entry->interface, entry->message->name, entry->count,
+			entry->total_nsec / 1000, entry->total_nsec / entry->count / 1000,
+			entry->max_nsec / 1000);
+	}
+
+	free(entries);
+}
+
+void wlr_protocol_profiler_dump(struct wlr_protocol_profiler *profiler) {
+	wlr_log(WLR_INFO, "Protocol profile: %"PRIu64" requests, total %"PRIu64
+		" us, unattributed %"PRIu64" us", profiler->requests,
+		profiler->total_nsec / 1000, profiler->unattributed_nsec / 1000);
+	dump_table(&profiler->table, PROFILER_DUMP_ENTRIES);
+
+	struct wlr_protocol_profiler_client *client;
+	wl_list_for_each(client, &profiler->clients, link) {
+		pid_t pid = 0;
+		wl_client_get_credentials(client->client, &pid, NULL, NULL);
+		wlr_log(WLR_INFO, "Client %p (PID %d): %"PRIu64" requests, "
+			"total %"PRIu64" us", (void *)client->client, (int)pid,
+			client->requests, client->total_nsec / 1000);
+		dump_table(&client->table, PROFILER_DUMP_CLIENT_ENTRIES);
+	}
+}
+
+static int handle_signal(int signal_number, void *data) {
+	struct wlr_protocol_profiler *profiler = data;
+	wlr_protocol_profiler_dump(profiler);
+	return 0;
+}
+
+bool wlr_protocol_profiler_dump_on_signal(
+		struct wlr_protocol_profiler *profiler, int signal_number) {
+	if (profiler->signal != NULL) {
+		wl_event_source_remove(profiler->signal);
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(profiler->display);
+	profiler->signal = wl_event_loop_add_signal(loop, signal_number,
+		handle_signal, profiler);
+	return profiler->signal != NULL;
+}
+
+void wlr_protocol_profiler_destroy(struct wlr_protocol_profiler *profiler) {
+	if (profiler == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&profiler->events.destroy, profiler);
+
+	profiler->current.client = NULL;
+	struct wlr_protocol_profiler_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &profiler->clients, link) {
+		client_destroy(client);
+	}
+
+	if (profiler->idle != NULL) {
+		wl_event_source_remove(profiler->idle);
+	}
+	if (profiler->signal != NULL) {
+		wl_event_source_remove(profiler->signal);
+	}
+	wl_protocol_logger_destroy(profiler->logger);
+	wl_list_remove(&profiler->display_destroy.link);
+	table_finish(&profiler->table);
+	free(profiler);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_protocol_profiler *profiler =
+		wl_container_of(listener, profiler, display_destroy);
+	wlr_protocol_profiler_destroy(profiler);
+}
+
+struct wlr_protocol_profiler *wlr_protocol_profiler_create(
+		struct wl_display *display) {
+	struct wlr_protocol_profiler *profiler =
+		calloc(1, sizeof(struct wlr_protocol_profiler));
+	if (profiler == NULL) {
+		return NULL;
+	}
+	profiler->display = display;
+	profiler->tail_cap_nsec = PROFILER_DEFAULT_TAIL_CAP_NSEC;
+	wl_list_init(&profiler->clients);
+	wl_signal_init(&profiler->events.destroy);
+
+	profiler->logger = wl_display_add_protocol_logger(display,
+		handle_protocol_message, profiler);
+	if (profiler->logger == NULL) {
+		free(profiler);
+		return NULL;
+	}
+
+	profiler->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &profiler->display_destroy);
+
+	return profiler;
+}
@@ -0,0 +1,978 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "util/signal.h"
+
+static struct wlr_scene *scene_root_from_node(struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_ROOT);
+	return (struct wlr_scene *)node;
+}
+
+static struct wlr_scene_tree *scene_tree_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_TREE);
+	return (struct wlr_scene_tree *)node;
+}
+
+struct wlr_scene_surface *wlr_scene_surface_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_SURFACE);
+	return (struct wlr_scene_surface *)node;
+}
+
+static struct wlr_scene_rect *scene_rect_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_RECT);
+	return (struct wlr_scene_rect *)node;
+}
+
+static struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
+	while (node->parent != NULL) {
+		node = node->parent;
+	}
+	return scene_root_from_node(node);
+}
+
+static void scene_node_state_init(struct wlr_scene_node_state *state) {
+	wl_list_init(&state->children);
+	wl_list_init(&state->link);
+	state->enabled = true;
+}
+
+static void scene_node_state_finish(struct wlr_scene_node_state *state) {
+	wl_list_remove(&state->link);
+}
+
+static void scene_node_init(struct wlr_scene_node *node,
+		enum wlr_scene_node_type type, struct wlr_scene_node *parent) {
+	assert(type == WLR_SCENE_NODE_ROOT || parent != NULL);
+
+	node->type = type;
+	node->parent = parent;
+	scene_node_state_init(&node->state);
+	wl_signal_init(&node->events.destroy);
+
+	if (parent != NULL) {
+		wl_list_insert(parent->state.children.prev, &node->state.link);
+	}
+}
+
+/* Geometry */
+
+static void scene_node_get_size(struct wlr_scene_node *node,
+		int *width, int *height) {
+	*width = 0;
+	*height = 0;
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		if (wlr_surface_has_buffer(scene_surface->surface)) {
+			*width = scene_surface->surface->current.width;
+			*height = scene_surface->surface->current.height;
+		}
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(node);
+		*width = rect->width;
+		*height = rect->height;
+		break;
+	}
+}
+
+/**
+ * Get the region of the node which hides whatever is below it, in
+ * node-local coordinates.
+ */
+static void scene_node_get_opaque_region(struct wlr_scene_node *node,
+		pixman_region32_t *opaque) {
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		if (wlr_surface_get_texture(scene_surface->surface) != NULL) {
+			pixman_region32_copy(opaque,
+				&scene_surface->surface->opaque_region);
+		}
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(node);
+		if (rect->color[3] >= 1.0) {
+			pixman_region32_union_rect(opaque, opaque, 0, 0,
+				rect->width, rect->height);
+		}
+		break;
+	}
+}
+
+static void scale_box(struct wlr_box *box, float scale) {
+	int x1 = floor(box->x * scale);
+	int y1 = floor(box->y * scale);
+	int x2 = ceil((box->x + box->width) * scale);
+	int y2 = ceil((box->y + box->height) * scale);
+	box->x = x1;
+	box->y = y1;
+	box->width = x2 - x1;
+	box->height = y2 - y1;
+}
+
+/**
+ * Scale a region, rounding towards the inside of each rectangle. Used for
+ * opaque regions, which must never cover pixels they don't entirely hide.
+ */
+static void region_scale_inward(pixman_region32_t *region, float scale) {
+	if (scale == 1) {
+		return;
+	}
+
+	int n_rects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &n_rects);
+	pixman_box32_t *scaled = calloc(n_rects, sizeof(pixman_box32_t));
+	if (scaled == NULL) {
+		pixman_region32_clear(region);
+		return;
+	}
+
+	int n_scaled = 0;
+	for (int i = 0; i < n_rects; ++i) {
+		pixman_box32_t box = {
+			.x1 = ceil(rects[i].x1 * scale),
+			.y1 = ceil(rects[i].y1 * scale),
+			.x2 = floor(rects[i].x2 * scale),
+			.y2 = floor(rects[i].y2 * scale),
+		};
+		if (box.x1 < box.x2 && box.y1 < box.y2) {
+			scaled[n_scaled++] = box;
+		}
+	}
+
+	pixman_region32_fini(region);
+	pixman_region32_init_rects(region, scaled, n_scaled);
+	free(scaled);
+}
+
+/* Damage tracking */
+
+/**
+ * Add damage to all outputs, `damage` is in layout coordinates.
+ */
+static void scene_damage_outputs(struct wlr_scene *scene,
+		pixman_region32_t *damage) {
+	if (!pixman_region32_not_empty(damage)) {
+		return;
+	}
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct wlr_output *output = scene_output->output;
+		int width, height;
+		wlr_output_transformed_resolution(output, &width, &height);
+
+		pixman_region32_t output_damage;
+		pixman_region32_init(&output_damage);
+		pixman_region32_copy(&output_damage, damage);
+		pixman_region32_translate(&output_damage,
+			-scene_output->x, -scene_output->y);
+		wlr_region_scale(&output_damage, &output_damage, output->scale);
+		pixman_region32_intersect_rect(&output_damage, &output_damage,
+			0, 0, width, height);
+		if (pixman_region32_not_empty(&output_damage)) {
+			wlr_output_damage_add(scene_output->damage, &output_damage);
+		}
+		pixman_region32_fini(&output_damage);
+	}
+}
+
+static void scene_node_get_bounds(struct wlr_scene_node *node, int lx, int ly,
+		pixman_region32_t *bounds) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	if (width > 0 && height > 0) {
+		pixman_region32_union_rect(bounds, bounds, lx, ly, width, height);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_node_get_bounds(child, lx + child->state.x,
+			ly + child->state.y, bounds);
+	}
+}
+
+static void scene_node_damage_whole(struct wlr_scene_node *node) {
+	struct wlr_scene *scene = scene_node_get_root(node);
+	// The node has been added, removed, moved, restacked or resized
+	scene->occlusion_dirty = true;
+	if (wl_list_empty(&scene->outputs)) {
+		return;
+	}
+
+	int lx, ly;
+	if (!wlr_scene_node_coords(node, &lx, &ly)) {
+		return;
+	}
+
+	pixman_region32_t bounds;
+	pixman_region32_init(&bounds);
+	scene_node_get_bounds(node, lx, ly, &bounds);
+	scene_damage_outputs(scene, &bounds);
+	pixman_region32_fini(&bounds);
+}
+
+static void scene_node_update_occlusion(struct wlr_scene_node *node,
+		int lx, int ly, pixman_region32_t *opaque) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	// Children are above their parent
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &node->state.children, state.link) {
+		scene_node_update_occlusion(child, lx, ly, opaque);
+	}
+
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		pixman_region32_copy(&scene_surface->occluded, opaque);
+	}
+
+	pixman_region32_t node_opaque;
+	pixman_region32_init(&node_opaque);
+	scene_node_get_opaque_region(node, &node_opaque);
+	pixman_region32_translate(&node_opaque, lx, ly);
+	pixman_region32_union(opaque, opaque, &node_opaque);
+	pixman_region32_fini(&node_opaque);
+}
+
+/**
+ * Recompute the region hidden above each surface, if the scene changed.
+ * Disabled surfaces are left alone: they're updated once enabled again,
+ * which makes the scene dirty.
+ */
+static void scene_update_occlusion(struct wlr_scene *scene) {
+	if (!scene->occlusion_dirty) {
+		return;
+	}
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	scene_node_update_occlusion(&scene->node, 0, 0, &opaque);
+	pixman_region32_fini(&opaque);
+
+	scene->occlusion_dirty = false;
+}
+
+/* Nodes */
+
+struct wlr_scene *wlr_scene_create(void) {
+	struct wlr_scene *scene = calloc(1, sizeof(struct wlr_scene));
+	if (scene == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene->node, WLR_SCENE_NODE_ROOT, NULL);
+	wl_list_init(&scene->outputs);
+	return scene;
+}
+
+struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_node *parent) {
+	struct wlr_scene_tree *tree = calloc(1, sizeof(struct wlr_scene_tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+	scene_node_init(&tree->node, WLR_SCENE_NODE_TREE, parent);
+	return tree;
+}
+
+static void scene_surface_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_destroy);
+	wlr_scene_node_destroy(&scene_surface->node);
+}
+
+static void scene_surface_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_commit);
+	struct wlr_surface *surface = scene_surface->surface;
+	struct wlr_scene *scene = scene_node_get_root(&scene_surface->node);
+
+	int width, height;
+	scene_node_get_size(&scene_surface->node, &width, &height);
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	scene_node_get_opaque_region(&scene_surface->node, &opaque);
+
+	bool opaque_changed =
+		!pixman_region32_equal(&scene_surface->opaque_region, &opaque);
+	bool size_changed =
+		scene_surface->width != width || scene_surface->height != height;
+	pixman_region32_copy(&scene_surface->opaque_region, &opaque);
+	pixman_region32_fini(&opaque);
+	scene_surface->width = width;
+	scene_surface->height = height;
+
+	// Occlusion is recomputed once per output commit, not per surface commit
+	if (opaque_changed || size_changed) {
+		scene->occlusion_dirty = true;
+	}
+
+	int lx, ly;
+	if (wl_list_empty(&scene->outputs) ||
+			!wlr_scene_node_coords(&scene_surface->node, &lx, &ly)) {
+		return;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface, &damage);
+	if (opaque_changed) {
+		// Content below may have to be blended in, or can now be skipped
+		pixman_region32_union_rect(&damage, &damage, 0, 0,
+			surface->current.width, surface->current.height);
+	}
+	pixman_region32_translate(&damage, lx, ly);
+	if (!scene->occlusion_dirty) {
+		pixman_region32_subtract(&damage, &damage, &scene_surface->occluded);
+	}
+	scene_damage_outputs(scene, &damage);
+	pixman_region32_fini(&damage);
+}
+
+struct wlr_scene_surface *wlr_scene_surface_create(struct wlr_scene_node *parent,
+		struct wlr_surface *surface) {
+	struct wlr_scene_surface *scene_surface =
+		calloc(1, sizeof(struct wlr_scene_surface));
+	if (scene_surface == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_surface->node, WLR_SCENE_NODE_SURFACE, parent);
+
+	scene_surface->surface = surface;
+	pixman_region32_init(&scene_surface->opaque_region);
+	scene_node_get_opaque_region(&scene_surface->node,
+		&scene_surface->opaque_region);
+	scene_node_get_size(&scene_surface->node,
+		&scene_surface->width, &scene_surface->height);
+	pixman_region32_init(&scene_surface->occluded);
+
+	scene_surface->surface_destroy.notify =
+		scene_surface_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &scene_surface->surface_destroy);
+
+	scene_surface->surface_commit.notify = scene_surface_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &scene_surface->surface_commit);
+
+	scene_node_damage_whole(&scene_surface->node);
+
+	return scene_surface;
+}
+
+struct wlr_scene_rect *wlr_scene_rect_create(struct wlr_scene_node *parent,
+		int width, int height, const float color[static 4]) {
+	struct wlr_scene_rect *scene_rect =
+		calloc(1, sizeof(struct wlr_scene_rect));
+	if (scene_rect == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_rect->node, WLR_SCENE_NODE_RECT, parent);
+
+	scene_rect->width = width;
+	scene_rect->height = height;
+	memcpy(scene_rect->color, color, sizeof(scene_rect->color));
+
+	scene_node_damage_whole(&scene_rect->node);
+
+	return scene_rect;
+}
+
+void wlr_scene_rect_set_size(struct wlr_scene_rect *rect, int width,
+		int height) {
+	if (rect->width == width && rect->height == height) {
+		return;
+	}
+
+	scene_node_damage_whole(&rect->node);
+	rect->width = width;
+	rect->height = height;
+	scene_node_damage_whole(&rect->node);
+}
+
+void wlr_scene_rect_set_color(struct wlr_scene_rect *rect,
+		const float color[static 4]) {
+	if (memcmp(rect->color, color, sizeof(rect->color)) == 0) {
+		return;
+	}
+
+	memcpy(rect->color, color, sizeof(rect->color));
+	scene_node_damage_whole(&rect->node);
+}
+
+static void scene_node_finish(struct wlr_scene_node *node) {
+	wlr_signal_emit_safe(&node->events.destroy, NULL);
+
+	struct wlr_scene_node *child, *child_tmp;
+	wl_list_for_each_safe(child, child_tmp,
+			&node->state.children, state.link) {
+		scene_node_finish(child);
+	}
+
+	scene_node_state_finish(&node->state);
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:;
+		struct wlr_scene *scene = scene_root_from_node(node);
+		struct wlr_scene_output *scene_output, *scene_output_tmp;
+		wl_list_for_each_safe(scene_output, scene_output_tmp,
+				&scene->outputs, link) {
+			wlr_scene_output_destroy(scene_output);
+		}
+		free(scene);
+		break;
+	case WLR_SCENE_NODE_TREE:;
+		struct wlr_scene_tree *tree = scene_tree_from_node(node);
+		free(tree);
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		wl_list_remove(&scene_surface->surface_commit.link);
+		wl_list_remove(&scene_surface->surface_destroy.link);
+		pixman_region32_fini(&scene_surface->opaque_region);
+		pixman_region32_fini(&scene_surface->occluded);
+		free(scene_surface);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+		free(scene_rect);
+		break;
+	}
+}
+
+void wlr_scene_node_destroy(struct wlr_scene_node *node) {
+	if (node == NULL) {
+		return;
+	}
+
+	// Children are destroyed along with the node, damage them only once
+	scene_node_damage_whole(node);
+	scene_node_finish(node);
+}
+
+void wlr_scene_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
+	if (node->state.enabled == enabled) {
+		return;
+	}
+
+	// One of these damage_whole() calls will short-circuit and be a no-op
+	scene_node_damage_whole(node);
+	node->state.enabled = enabled;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_set_position(struct wlr_scene_node *node, int x, int y) {
+	if (node->state.x == x && node->state.y == y) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	node->state.x = x;
+	node->state.y = y;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_place_above(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.prev == &sibling->state.link) {
+		return;
+	}
+
+	// Only the pixels covered by the node can change
+	wl_list_remove(&node->state.link);
+	wl_list_insert(&sibling->state.link, &node->state.link);
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_place_below(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.next == &sibling->state.link) {
+		return;
+	}
+
+	wl_list_remove(&node->state.link);
+	wl_list_insert(sibling->state.link.prev, &node->state.link);
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_raise_to_top(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_top = wl_container_of(
+		node->parent->state.children.prev, current_top, state.link);
+	if (node == current_top) {
+		return;
+	}
+	wlr_scene_node_place_above(node, current_top);
+}
+
+void wlr_scene_node_lower_to_bottom(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_bottom = wl_container_of(
+		node->parent->state.children.next, current_bottom, state.link);
+	if (node == current_bottom) {
+		return;
+	}
+	wlr_scene_node_place_below(node, current_bottom);
+}
+
+void wlr_scene_node_reparent(struct wlr_scene_node *node,
+		struct wlr_scene_node *new_parent) {
+	assert(node->type != WLR_SCENE_NODE_ROOT && new_parent != NULL);
+
+	if (node->parent == new_parent) {
+		return;
+	}
+
+	// Ensure that a node cannot become its own ancestor
+	for (struct wlr_scene_node *ancestor = new_parent; ancestor != NULL;
+			ancestor = ancestor->parent) {
+		assert(ancestor != node);
+	}
+
+	scene_node_damage_whole(node);
+
+	wl_list_remove(&node->state.link);
+	node->parent = new_parent;
+	wl_list_insert(new_parent->state.children.prev, &node->state.link);
+
+	scene_node_damage_whole(node);
+}
+
+bool wlr_scene_node_coords(struct wlr_scene_node *node, int *lx_ptr,
+		int *ly_ptr) {
+	int lx = 0, ly = 0;
+	bool enabled = true;
+	while (node != NULL) {
+		lx += node->state.x;
+		ly += node->state.y;
+		enabled = enabled && node->state.enabled;
+		node = node->parent;
+	}
+
+	*lx_ptr = lx;
+	*ly_ptr = ly;
+	return enabled;
+}
+
+static void scene_node_for_each_surface(struct wlr_scene_node *node,
+		int lx, int ly, wlr_surface_iterator_func_t user_iterator,
+		void *user_data) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		user_iterator(scene_surface->surface, lx, ly, user_data);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_node_for_each_surface(child, lx, ly, user_iterator, user_data);
+	}
+}
+
+void wlr_scene_node_for_each_surface(struct wlr_scene_node *node,
+		wlr_surface_iterator_func_t user_iterator, void *user_data) {
+	int lx = 0, ly = 0;
+	if (node->parent != NULL &&
+			!wlr_scene_node_coords(node->parent, &lx, &ly)) {
+		return;
+	}
+	scene_node_for_each_surface(node, lx, ly, user_iterator, user_data);
+}
+
+struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
+		double lx, double ly, double *nx, double *ny) {
+	if (!node->state.enabled) {
+		return NULL;
+	}
+
+	lx -= node->state.x;
+	ly -= node->state.y;
+
+	// Children are above their parent, topmost first
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &node->state.children, state.link) {
+		struct wlr_scene_node *found =
+			wlr_scene_node_at(child, lx, ly, nx, ny);
+		if (found != NULL) {
+			return found;
+		}
+	}
+
+	bool hit = false;
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		hit = wlr_surface_point_accepts_input(scene_surface->surface, lx, ly);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(node);
+		hit = lx >= 0 && lx < rect->width && ly >= 0 && ly < rect->height;
+		break;
+	}
+
+	if (!hit) {
+		return NULL;
+	}
+	if (nx != NULL) {
+		*nx = lx;
+	}
+	if (ny != NULL) {
+		*ny = ly;
+	}
+	return node;
+}
+
+/* Outputs */
+
+static void scene_output_handle_damage_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_output *scene_output =
+		wl_container_of(listener, scene_output, damage_destroy);
+	// The output damage is being destroyed along with the output
+	wl_list_remove(&scene_output->damage_destroy.link);
+	wl_list_init(&scene_output->damage_destroy.link);
+	scene_output->damage = NULL;
+	wlr_scene_output_destroy(scene_output);
+}
+
+struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
+		struct wlr_output *output) {
+	struct wlr_scene_output *scene_output =
+		calloc(1, sizeof(struct wlr_scene_output));
+	if (scene_output == NULL) {
+		return NULL;
+	}
+
+	scene_output->damage = wlr_output_damage_create(output);
+	if (scene_output->damage == NULL) {
+		free(scene_output);
+		return NULL;
+	}
+
+	scene_output->output = output;
+	scene_output->scene = scene;
+	wl_list_insert(&scene->outputs, &scene_output->link);
+
+	scene_output->damage_destroy.notify = scene_output_handle_damage_destroy;
+	wl_signal_add(&scene_output->damage->events.destroy,
+		&scene_output->damage_destroy);
+
+	wlr_output_damage_add_whole(scene_output->damage);
+
+	return scene_output;
+}
+
+void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
+	if (scene_output == NULL) {
+		return;
+	}
+	wl_list_remove(&scene_output->link);
+	wl_list_remove(&scene_output->damage_destroy.link);
+	wlr_output_damage_destroy(scene_output->damage);
+	free(scene_output);
+}
+
+void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
+		int lx, int ly) {
+	if (scene_output->x == lx && scene_output->y == ly) {
+		return;
+	}
+
+	scene_output->x = lx;
+	scene_output->y = ly;
+	wlr_output_damage_add_whole(scene_output->damage);
+}
+
+struct render_entry {
+	struct wlr_scene_node *node;
+	struct wlr_box box; // in output-buffer-local coordinates, untransformed
+	pixman_region32_t visible;
+};
+
+struct render_data {
+	struct wlr_scene_output *scene_output;
+	// Damaged area which isn't hidden by opaque nodes yet
+	pixman_region32_t *remaining;
+	struct wl_array entries; // struct render_entry, topmost first
+};
+
+/**
+ * Walk the tree from top to bottom, keeping track of the area hidden by opaque
+ * nodes. Nodes with nothing left to paint are culled.
+ */
+static void scene_node_collect_visible(struct wlr_scene_node *node,
+		int lx, int ly, struct render_data *data) {
+	if (!node->state.enabled ||
+			!pixman_region32_not_empty(data->remaining)) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &node->state.children, state.link) {
+		scene_node_collect_visible(child, lx, ly, data);
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	struct wlr_scene_output *scene_output = data->scene_output;
+	float scale = scene_output->output->scale;
+	struct wlr_box box = {
+		.x = lx - scene_output->x,
+		.y = ly - scene_output->y,
+		.width = width,
+		.height = height,
+	};
+	scale_box(&box, scale);
+
+	pixman_region32_t visible;
+	pixman_region32_init(&visible);
+	pixman_region32_intersect_rect(&visible, data->remaining,
+		box.x, box.y, box.width, box.height);
+	if (!pixman_region32_not_empty(&visible)) {
+		pixman_region32_fini(&visible);
+		return;
+	}
+
+	struct render_entry *entry = wl_array_add(&data->entries, sizeof(*entry));
+	if (entry == NULL) {
+		pixman_region32_fini(&visible);
+		return;
+	}
+	entry->node = node;
+	entry->box = box;
+	entry->visible = visible;
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	scene_node_get_opaque_region(node, &opaque);
+	pixman_region32_translate(&opaque,
+		lx - scene_output->x, ly - scene_output->y);
+	region_scale_inward(&opaque, scale);
+	pixman_region32_subtract(data->remaining, data->remaining, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+static void scissor_output(struct wlr_output *output, pixman_box32_t *rect) {
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer);
+
+	struct wlr_box box = {
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+
+	int ow, oh;
+	wlr_output_transformed_resolution(output, &ow, &oh);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_box_transform(&box, &box, transform, ow, oh);
+
+	wlr_renderer_scissor(renderer, &box);
+}
+
+static void render_entry(struct wlr_output *output,
+		struct render_entry *entry) {
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	struct wlr_scene_node *node = entry->node;
+	struct wlr_texture *texture = NULL;
+	float matrix[9];
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		return;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_surface *surface = wlr_scene_surface_from_node(node)->surface;
+		texture = wlr_surface_get_texture(surface);
+		if (texture == NULL) {
+			return;
+		}
+		enum wl_output_transform transform =
+			wlr_output_transform_invert(surface->current.transform);
+		wlr_matrix_project_box(matrix, &entry->box, transform, 0,
+			output->transform_matrix);
+		break;
+	case WLR_SCENE_NODE_RECT:
+		break;
+	}
+
+	int n_rects;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&entry->visible, &n_rects);
+	for (int i = 0; i < n_rects; ++i) {
+		scissor_output(output, &rects[i]);
+		if (texture != NULL) {
+			wlr_render_texture_with_matrix(renderer, texture, matrix, 1.0);
+		} else {
+			struct wlr_scene_rect *rect = scene_rect_from_node(node);
+			wlr_render_rect(renderer, &entry->box, rect->color,
+				output->transform_matrix);
+		}
+	}
+}
+
+bool wlr_scene_output_commit(struct wlr_scene_output *scene_output) {
+	struct wlr_output *output = scene_output->output;
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer != NULL);
+
+	// Used to clip the damage of surface commits until the scene changes
+	scene_update_occlusion(scene_output->scene);
+
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_attach_render(scene_output->damage,
+			&needs_frame, &damage)) {
+		pixman_region32_fini(&damage);
+		return false;
+	}
+
+	if (!needs_frame) {
+		pixman_region32_fini(&damage);
+		wlr_output_rollback(output);
+		return true;
+	}
+
+	pixman_region32_t remaining;
+	pixman_region32_init(&remaining);
+	pixman_region32_copy(&remaining, &damage);
+	struct render_data data = {
+		.scene_output = scene_output,
+		.remaining = &remaining,
+	};
+	wl_array_init(&data.entries);
+	scene_node_collect_visible(&scene_output->scene->node, 0, 0, &data);
+
+	wlr_renderer_begin(renderer, output->width, output->height);
+
+	// Clear what isn't hidden by opaque nodes
+	int n_rects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&remaining, &n_rects);
+	for (int i = 0; i < n_rects; ++i) {
+		scissor_output(output, &rects[i]);
+		wlr_renderer_clear(renderer, (float[4]){ 0.0, 0.0, 0.0, 1.0 });
+	}
+
+	// Paint from bottom to top
+	struct render_entry *entries = data.entries.data;
+	size_t n_entries = data.entries.size / sizeof(struct render_entry);
+	for (size_t i = n_entries; i > 0; --i) {
+		render_entry(output, &entries[i - 1]);
+		pixman_region32_fini(&entries[i - 1].visible);
+	}
+	wl_array_release(&data.entries);
+	pixman_region32_fini(&remaining);
+
+	wlr_renderer_scissor(renderer, NULL);
+	wlr_output_render_software_cursors(output, &damage);
+	wlr_renderer_end(renderer);
+	pixman_region32_fini(&damage);
+
+	int tr_width, tr_height;
+	wlr_output_transformed_resolution(output, &tr_width, &tr_height);
+
+	pixman_region32_t frame_damage;
+	pixman_region32_init(&frame_damage);
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_region_transform(&frame_damage, &scene_output->damage->current,
+		transform, tr_width, tr_height);
+	wlr_output_set_damage(output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+
+	return wlr_output_commit(output);
+}
+
+struct frame_done_data {
+	struct wlr_box output_box;
+	const struct timespec *when;
+};
+
+static void send_frame_done_iterator(struct wlr_surface *surface,
+		int lx, int ly, void *_data) {
+	struct frame_done_data *data = _data;
+	struct wlr_box surface_box = {
+		.x = lx,
+		.y = ly,
+		.width = surface->current.width,
+		.height = surface->current.height,
+	};
+	struct wlr_box intersection;
+	if (wlr_box_intersection(&intersection, &data->output_box, &surface_box)) {
+		wlr_surface_send_frame_done(surface, data->when);
+	}
+}
+
+void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
+		const struct timespec *now) {
+	struct frame_done_data data = {
+		.output_box = {
+			.x = scene_output->x,
+			.y = scene_output->y,
+		},
+		.when = now,
+	};
+	wlr_output_effective_resolution(scene_output->output,
+		&data.output_box.width, &data.output_box.height);
+	wlr_scene_node_for_each_surface(&scene_output->scene->node,
+		send_frame_done_iterator, &data);
+}
@@ -9,6 +9,15 @@
 #include "util/signal.h"
 
 #define SCREENCOPY_MANAGER_VERSION 2
+// Above this number of damage rectangles, their extents are read back instead
+#define SCREENCOPY_MAX_READBACKS 16
+// Above this number of damage rectangles, their extents are sent instead
+#define SCREENCOPY_MAX_DAMAGE_EVENTS 8
+
+struct screencopy_readback {
+	struct wlr_renderer_readback *readback;
+	uint32_t dst_x, dst_y; // in the client buffer
+};
 
 struct screencopy_damage {
 	struct wl_list link;
@@ -17,6 +26,13 @@ struct screencopy_damage {
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
 	uint32_t last_commit_seq;
+
+	// Buffer which received the last copy: outside of the accumulated damage,
+	// its contents are still up to date
+	struct wl_resource *buffer;
+	struct wlr_box buffer_box;
+	uint32_t buffer_flags;
+	struct wl_listener buffer_destroy;
 };
 
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
@@ -59,7 +75,29 @@ static void screencopy_damage_handle_output_precommit(
 	screencopy_damage_accumulate(damage);
 }
 
+static void screencopy_damage_set_buffer(struct screencopy_damage *damage,
+		struct wl_resource *buffer, const struct wlr_box *box,
+		uint32_t flags) {
+	wl_list_remove(&damage->buffer_destroy.link);
+	wl_list_init(&damage->buffer_destroy.link);
+	damage->buffer = buffer;
+	if (buffer == NULL) {
+		return;
+	}
+	damage->buffer_box = *box;
+	damage->buffer_flags = flags;
+	wl_resource_add_destroy_listener(buffer, &damage->buffer_destroy);
+}
+
+static void screencopy_damage_handle_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_damage *damage =
+		wl_container_of(listener, damage, buffer_destroy);
+	screencopy_damage_set_buffer(damage, NULL, NULL, 0);
+}
+
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	wl_list_remove(&damage->buffer_destroy.link);
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -96,6 +134,9 @@ static struct screencopy_damage *screencopy_damage_create(
 	wl_signal_add(&output->events.destroy, &damage->output_destroy);
 	damage->output_destroy.notify = screencopy_damage_handle_output_destroy;
 
+	wl_list_init(&damage->buffer_destroy.link);
+	damage->buffer_destroy.notify = screencopy_damage_handle_buffer_destroy;
+
 	return damage;
 }
 
@@ -128,10 +169,24 @@ static struct wlr_screencopy_frame_v1 *frame_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
+static void frame_destroy_readbacks(struct wlr_screencopy_frame_v1 *frame) {
+	if (frame->readback_source != NULL) {
+		wl_event_source_remove(frame->readback_source);
+		frame->readback_source = NULL;
+	}
+	struct screencopy_readback *readback;
+	wl_array_for_each(readback, &frame->readbacks) {
+		wlr_renderer_readback_destroy(readback->readback);
+	}
+	frame->readbacks.size = 0;
+}
+
 static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	if (frame == NULL) {
 		return;
 	}
+	frame_destroy_readbacks(frame);
+	wl_array_release(&frame->readbacks);
 	if (frame->output != NULL && frame->buffer != NULL) {
 		wlr_output_lock_attach_render(frame->output, false);
 		if (frame->cursor_locked) {
@@ -149,6 +204,197 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	free(frame);
 }
 
+/**
+ * Read back the damaged parts of the capture box only. The rest of the buffer
+ * must hold the previous copy, which may have been stored bottom-up: rows are
+ * then written in the same layout.
+ */
+static bool frame_read_damage(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_renderer *renderer, struct pixman_region32 *damage,
+		bool y_invert, void *data) {
+	struct wlr_box *box = &frame->box;
+
+	struct pixman_region32 region;
+	pixman_region32_init(&region);
+	pixman_region32_intersect_rect(&region, damage, box->x, box->y,
+		box->width, box->height);
+
+	bool ok = true;
+	int n_rects;
+	struct pixman_box32 *rects = pixman_region32_rectangles(&region, &n_rects);
+	for (int i = 0; i < n_rects && ok; ++i) {
+		struct pixman_box32 *rect = &rects[i];
+		uint32_t width = rect->x2 - rect->x1;
+		uint32_t height = rect->y2 - rect->y1;
+		uint32_t dst_x = rect->x1 - box->x;
+		uint32_t dst_y = rect->y1 - box->y;
+
+		if (!y_invert) {
+			ok = wlr_renderer_read_pixels(renderer, frame->format, NULL,
+				frame->stride, width, height, rect->x1, rect->y1,
+				dst_x, dst_y, data);
+			continue;
+		}
+
+		for (uint32_t j = 0; j < height && ok; ++j) {
+			ok = wlr_renderer_read_pixels(renderer, frame->format, NULL,
+				frame->stride, width, 1, rect->x1, rect->y1 + j,
+				dst_x, box->height - 1 - dst_y - j, data);
+		}
+	}
+
+	pixman_region32_fini(&region);
+	return ok;
+}
+
+static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame,
+		struct screencopy_damage *damage, uint32_t flags) {
+	// Damage outside of the captured area is of no use to the client
+	struct pixman_region32 region;
+	pixman_region32_init(&region);
+	pixman_region32_intersect_rect(&region, &damage->damage,
+		frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+
+	int n_rects;
+	struct pixman_box32 *rects =
+		pixman_region32_rectangles(&region, &n_rects);
+	if (n_rects > SCREENCOPY_MAX_DAMAGE_EVENTS) {
+		rects = pixman_region32_extents(&region);
+		n_rects = 1;
+	}
+	for (int i = 0; i < n_rects; ++i) {
+		zwlr_screencopy_frame_v1_send_damage(frame->resource,
+			rects[i].x1, rects[i].y1, rects[i].x2 - rects[i].x1,
+			rects[i].y2 - rects[i].y1);
+	}
+	pixman_region32_fini(&region);
+
+	pixman_region32_clear(&damage->damage);
+	screencopy_damage_set_buffer(damage, frame->buffer_resource,
+		&frame->box, flags);
+}
+
+static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
+		const struct timespec *when) {
+	time_t tv_sec = when->tv_sec;
+	uint32_t tv_sec_hi = (sizeof(tv_sec) > 4) ? tv_sec >> 32 : 0;
+	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
+	zwlr_screencopy_frame_v1_send_ready(frame->resource,
+		tv_sec_hi, tv_sec_lo, when->tv_nsec);
+}
+
+static void frame_finish_readbacks(struct wlr_screencopy_frame_v1 *frame) {
+	struct wl_shm_buffer *buffer = frame->buffer;
+	assert(buffer != NULL);
+
+	wl_shm_buffer_begin_access(buffer);
+	void *data = wl_shm_buffer_get_data(buffer);
+	bool ok = true;
+	struct screencopy_readback *readback;
+	wl_array_for_each(readback, &frame->readbacks) {
+		ok = ok && wlr_renderer_readback_finish(readback->readback,
+			frame->stride, readback->dst_x, readback->dst_y, data);
+	}
+	wl_shm_buffer_end_access(buffer);
+
+	if (!ok) {
+		struct screencopy_damage *damage =
+			screencopy_damage_find(frame->client, frame->output);
+		if (damage) {
+			screencopy_damage_set_buffer(damage, NULL, NULL, 0);
+		}
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+		frame_destroy(frame);
+		return;
+	}
+
+	frame_send_ready(frame, &frame->readback_when);
+	frame_destroy(frame);
+}
+
+static int frame_handle_readback_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_screencopy_frame_v1 *frame = data;
+	frame_finish_readbacks(frame);
+	return 0;
+}
+
+static void frame_handle_readback_idle(void *data) {
+	struct wlr_screencopy_frame_v1 *frame = data;
+	// Idle sources are removed once dispatched
+	frame->readback_source = NULL;
+	frame_finish_readbacks(frame);
+}
+
+/**
+ * Start asynchronous read-backs of `region`, in output buffer coordinates.
+ * The frame is completed from the event loop once the GPU is done. Returns
+ * false if the renderer doesn't support asynchronous read-backs.
+ */
+static bool frame_start_readbacks(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_renderer *renderer, struct pixman_region32 *region) {
+	struct wlr_box *box = &frame->box;
+
+	struct pixman_region32 clipped;
+	pixman_region32_init(&clipped);
+	pixman_region32_intersect_rect(&clipped, region, box->x, box->y,
+		box->width, box->height);
+	if (pixman_region32_n_rects(&clipped) > SCREENCOPY_MAX_READBACKS) {
+		struct pixman_box32 extents = *pixman_region32_extents(&clipped);
+		pixman_region32_fini(&clipped);
+		pixman_region32_init_with_extents(&clipped, &extents);
+	}
+
+	bool ok = true;
+	int n_rects;
+	struct pixman_box32 *rects = pixman_region32_rectangles(&clipped, &n_rects);
+	for (int i = 0; i < n_rects; ++i) {
+		struct pixman_box32 *rect = &rects[i];
+		struct screencopy_readback *readback =
+			wl_array_add(&frame->readbacks, sizeof(*readback));
+		if (readback == NULL) {
+			ok = false;
+			break;
+		}
+		readback->readback = wlr_renderer_read_pixels_async(renderer,
+			frame->format, rect->x2 - rect->x1, rect->y2 - rect->y1,
+			rect->x1, rect->y1);
+		if (readback->readback == NULL) {
+			frame->readbacks.size -= sizeof(*readback);
+			ok = false;
+			break;
+		}
+		readback->dst_x = rect->x1 - box->x;
+		readback->dst_y = rect->y1 - box->y;
+	}
+	pixman_region32_fini(&clipped);
+
+	int fence_fd = -1;
+	if (ok && frame->readbacks.size > 0) {
+		// Read-backs complete in order, wait for the last one
+		struct screencopy_readback *last = (struct screencopy_readback *)
+			((char *)frame->readbacks.data + frame->readbacks.size) - 1;
+		fence_fd = wlr_renderer_readback_get_fd(last->readback);
+	}
+
+	struct wl_client *client = wl_resource_get_client(frame->resource);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wl_client_get_display(client));
+	if (ok && fence_fd >= 0) {
+		frame->readback_source = wl_event_loop_add_fd(loop, fence_fd,
+			WL_EVENT_READABLE, frame_handle_readback_fence, frame);
+	} else if (ok) {
+		// No way to know when the GPU is done: finish after the commit
+		frame->readback_source = wl_event_loop_add_idle(loop,
+			frame_handle_readback_idle, frame);
+	}
+
+	if (!ok || frame->readback_source == NULL) {
+		frame_destroy_readbacks(frame);
+		return false;
+	}
+	return true;
+}
+
 static void frame_handle_output_precommit(struct wl_listener *listener,
 		void *_data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -167,7 +413,15 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 		damage = screencopy_damage_get_or_create(frame->client, output);
 		if (damage) {
 			screencopy_damage_accumulate(damage);
-			if (!pixman_region32_not_empty(&damage->damage)) {
+			struct pixman_box32 box = {
+				.x1 = frame->box.x,
+				.y1 = frame->box.y,
+				.x2 = frame->box.x + frame->box.width,
+				.y2 = frame->box.y + frame->box.height,
+			};
+			// Wait until the captured area is damaged
+			if (pixman_region32_contains_rectangle(&damage->damage,
+					&box) == PIXMAN_REGION_OUT) {
 				return;
 			}
 		}
@@ -187,42 +441,63 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 	int32_t height = wl_shm_buffer_get_height(buffer);
 	int32_t stride = wl_shm_buffer_get_stride(buffer);
 
+	// If the client copies into the same buffer as last time, only the
+	// damaged parts need to be read back
+	bool partial = damage != NULL &&
+		damage->buffer == frame->buffer_resource &&
+		damage->buffer_box.x == frame->box.x &&
+		damage->buffer_box.y == frame->box.y &&
+		damage->buffer_box.width == frame->box.width &&
+		damage->buffer_box.height == frame->box.height;
+
+	// Asynchronous read-backs store rows top-down, which doesn't match a
+	// buffer previously filled bottom-up
+	if (!partial ||
+			!(damage->buffer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT)) {
+		struct pixman_region32 full;
+		pixman_region32_init_rect(&full, x, y, width, height);
+		bool started = frame_start_readbacks(frame, renderer,
+			partial ? &damage->damage : &full);
+		pixman_region32_fini(&full);
+
+		if (started) {
+			zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
+			if (damage) {
+				frame_send_damage(frame, damage, 0);
+			}
+			frame->readback_when = *event->when;
+			return;
+		}
+	}
+
 	wl_shm_buffer_begin_access(buffer);
 	void *data = wl_shm_buffer_get_data(buffer);
 	uint32_t flags = 0;
-	bool ok = wlr_renderer_read_pixels(renderer, fmt, &flags, stride,
-		width, height, x, y, 0, 0, data);
+	bool ok;
+	if (partial) {
+		flags = damage->buffer_flags;
+		ok = frame_read_damage(frame, renderer, &damage->damage,
+			flags & WLR_RENDERER_READ_PIXELS_Y_INVERT, data);
+	} else {
+		ok = wlr_renderer_read_pixels(renderer, fmt, &flags, stride,
+			width, height, x, y, 0, 0, data);
+	}
 	wl_shm_buffer_end_access(buffer);
 
 	if (!ok) {
+		if (damage) {
+			screencopy_damage_set_buffer(damage, NULL, NULL, 0);
+		}
 		zwlr_screencopy_frame_v1_send_failed(frame->resource);
 		frame_destroy(frame);
 		return;
 	}
 
 	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
-
-	// TODO: send fine-grained damage events
 	if (damage) {
-		struct pixman_box32 *damage_box =
-			pixman_region32_extents(&damage->damage);
-
-		int damage_x = damage_box->x1;
-		int damage_y = damage_box->y1;
-		int damage_width = damage_box->x2 - damage_box->x1;
-		int damage_height = damage_box->y2 - damage_box->y1;
-
-		zwlr_screencopy_frame_v1_send_damage(frame->resource,
-			damage_x, damage_y, damage_width, damage_height);
-
-		pixman_region32_clear(&damage->damage);
+		frame_send_damage(frame, damage, flags);
 	}
-
-	time_t tv_sec = event->when->tv_sec;
-	uint32_t tv_sec_hi = (sizeof(tv_sec) > 4) ? tv_sec >> 32 : 0;
-	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
-	zwlr_screencopy_frame_v1_send_ready(frame->resource,
-		tv_sec_hi, tv_sec_lo, event->when->tv_nsec);
+	frame_send_ready(frame, event->when);
 
 	frame_destroy(frame);
 }
@@ -298,6 +573,7 @@ static void frame_handle_copy(struct wl_client *wl_client,
 	}
 
 	frame->buffer = buffer;
+	frame->buffer_resource = buffer_resource;
 
 	wl_signal_add(&output->events.precommit, &frame->output_precommit);
 	frame->output_precommit.notify = frame_handle_output_precommit;
@@ -398,6 +674,7 @@ static void capture_output(struct wl_client *wl_client,
 	wl_list_init(&frame->output_enable.link);
 	wl_list_init(&frame->output_destroy.link);
 	wl_list_init(&frame->buffer_destroy.link);
+	wl_array_init(&frame->readbacks);
 
 	if (output == NULL || !output->enabled) {
 		goto error;
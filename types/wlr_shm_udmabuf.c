@@ -0,0 +1,469 @@
+#define _GNU_SOURCE // for F_GET_SEALS
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wayland-server-protocol.h>
+#include <wlr/config.h>
+#include <wlr/types/wlr_shm_udmabuf.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+#if WLR_HAS_UDMABUF
+#include <drm_fourcc.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+#endif
+
+struct shm_udmabuf_client {
+	struct wlr_shm_udmabuf *shm_udmabuf;
+	struct wl_client *client;
+
+	struct wl_list pools; // shm_udmabuf_pool::link
+	struct wl_list buffers; // shm_udmabuf_buffer::link
+
+	// Objects whose creation request has been logged but not dispatched yet
+	struct shm_udmabuf_pool *pending_pool;
+	struct shm_udmabuf_buffer *pending_buffer;
+	struct wl_list pending_link; // wlr_shm_udmabuf::pending_clients
+
+	struct wl_listener client_destroy;
+	struct wl_list link; // wlr_shm_udmabuf::clients
+};
+
+struct shm_udmabuf_pool {
+	struct shm_udmabuf_client *client;
+	uint32_t id;
+	struct wl_resource *resource; // NULL once destroyed
+	int fd;
+	size_t n_refs; // the pool resource and buffers
+
+	struct wl_listener resource_destroy;
+	struct wl_list link; // shm_udmabuf_client::pools
+};
+
+struct shm_udmabuf_buffer {
+	struct shm_udmabuf_pool *pool;
+	uint32_t id;
+	struct wl_resource *resource;
+	int32_t offset, width, height, stride;
+	uint32_t format;
+
+	int dmabuf_fd; // -1 if not created yet
+	bool import_failed;
+
+	struct wl_listener resource_destroy;
+	struct wl_list link; // shm_udmabuf_client::buffers
+};
+
+static void pool_unref(struct shm_udmabuf_pool *pool) {
+	assert(pool->n_refs > 0);
+	pool->n_refs--;
+	if (pool->n_refs > 0) {
+		return;
+	}
+
+	wl_list_remove(&pool->link);
+	close(pool->fd);
+	free(pool);
+}
+
+static void pool_handle_resource_destroy(struct wl_listener *listener,
+		void *data) {
+	struct shm_udmabuf_pool *pool =
+		wl_container_of(listener, pool, resource_destroy);
+	wl_list_remove(&pool->resource_destroy.link);
+	pool->resource = NULL;
+	pool_unref(pool);
+}
+
+static void buffer_destroy(struct shm_udmabuf_buffer *buffer) {
+	if (buffer->resource != NULL) {
+		wl_list_remove(&buffer->resource_destroy.link);
+	}
+	wl_list_remove(&buffer->link);
+	if (buffer->dmabuf_fd >= 0) {
+		close(buffer->dmabuf_fd);
+	}
+	pool_unref(buffer->pool);
+	free(buffer);
+}
+
+static void buffer_handle_resource_destroy(struct wl_listener *listener,
+		void *data) {
+	struct shm_udmabuf_buffer *buffer =
+		wl_container_of(listener, buffer, resource_destroy);
+	wl_list_remove(&buffer->resource_destroy.link);
+	buffer->resource = NULL;
+	buffer_destroy(buffer);
+}
+
+static void client_bind_pending(struct shm_udmabuf_client *client) {
+	wl_list_remove(&client->pending_link);
+	wl_list_init(&client->pending_link);
+
+	struct shm_udmabuf_pool *pool = client->pending_pool;
+	if (pool != NULL) {
+		client->pending_pool = NULL;
+
+		struct wl_resource *resource =
+			wl_client_get_object(client->client, pool->id);
+		if (resource == NULL || strcmp(wl_resource_get_class(resource),
+				wl_shm_pool_interface.name) != 0) {
+			// The request failed
+			pool_unref(pool);
+		} else {
+			pool->resource = resource;
+			pool->resource_destroy.notify = pool_handle_resource_destroy;
+			wl_resource_add_destroy_listener(resource, &pool->resource_destroy);
+		}
+	}
+
+	struct shm_udmabuf_buffer *buffer = client->pending_buffer;
+	if (buffer != NULL) {
+		client->pending_buffer = NULL;
+
+		struct wl_resource *resource =
+			wl_client_get_object(client->client, buffer->id);
+		if (resource == NULL || strcmp(wl_resource_get_class(resource),
+				wl_buffer_interface.name) != 0 ||
+				wl_shm_buffer_get(resource) == NULL) {
+			buffer_destroy(buffer);
+		} else {
+			buffer->resource = resource;
+			buffer->resource_destroy.notify = buffer_handle_resource_destroy;
+			wl_resource_add_destroy_listener(resource,
+				&buffer->resource_destroy);
+		}
+	}
+}
+
+static void client_destroy(struct shm_udmabuf_client *client) {
+	// The client's resources haven't been destroyed yet
+	struct shm_udmabuf_buffer *buffer, *buffer_tmp;
+	wl_list_for_each_safe(buffer, buffer_tmp, &client->buffers, link) {
+		buffer_destroy(buffer);
+	}
+	client->pending_buffer = NULL;
+	if (client->pending_pool != NULL) {
+		pool_unref(client->pending_pool);
+		client->pending_pool = NULL;
+	}
+	struct shm_udmabuf_pool *pool, *pool_tmp;
+	wl_list_for_each_safe(pool, pool_tmp, &client->pools, link) {
+		if (pool->resource != NULL) {
+			wl_list_remove(&pool->resource_destroy.link);
+			pool->resource = NULL;
+			pool_unref(pool);
+		}
+	}
+	assert(wl_list_empty(&client->pools));
+
+	wl_list_remove(&client->client_destroy.link);
+	wl_list_remove(&client->pending_link);
+	wl_list_remove(&client->link);
+	free(client);
+}
+
+static void client_handle_destroy(struct wl_listener *listener, void *data) {
+	struct shm_udmabuf_client *client =
+		wl_container_of(listener, client, client_destroy);
+	client_destroy(client);
+}
+
+static struct shm_udmabuf_client *client_get_or_create(
+		struct wlr_shm_udmabuf *shm_udmabuf, struct wl_client *wl_client) {
+	struct wl_listener *listener =
+		wl_client_get_destroy_listener(wl_client, client_handle_destroy);
+	if (listener != NULL) {
+		struct shm_udmabuf_client *client =
+			wl_container_of(listener, client, client_destroy);
+		return client;
+	}
+
+	struct shm_udmabuf_client *client =
+		calloc(1, sizeof(struct shm_udmabuf_client));
+	if (client == NULL) {
+		return NULL;
+	}
+	client->shm_udmabuf = shm_udmabuf;
+	client->client = wl_client;
+	wl_list_init(&client->pools);
+	wl_list_init(&client->buffers);
+	wl_list_init(&client->pending_link);
+
+	client->client_destroy.notify = client_handle_destroy;
+	wl_client_add_destroy_listener(wl_client, &client->client_destroy);
+
+	wl_list_insert(&shm_udmabuf->clients, &client->link);
+	return client;
+}
+
+static void handle_create_pool(struct wlr_shm_udmabuf *shm_udmabuf,
+		const struct wl_protocol_logger_message *message) {
+	struct shm_udmabuf_client *client = client_get_or_create(shm_udmabuf,
+		wl_resource_get_client(message->resource));
+	if (client == NULL) {
+		return;
+	}
+
+	// Only memfds sealed against shrinking can be wrapped with udmabuf, don't
+	// keep a file descriptor around for other pools. Their buffers aren't
+	// tracked either.
+	int fd = message->arguments[1].h;
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+		return;
+	}
+
+	struct shm_udmabuf_pool *pool = calloc(1, sizeof(struct shm_udmabuf_pool));
+	if (pool == NULL) {
+		return;
+	}
+
+	// libwayland closes the file descriptor once it has mapped it
+	pool->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (pool->fd < 0) {
+		free(pool);
+		return;
+	}
+	pool->client = client;
+	pool->id = message->arguments[0].n;
+	pool->n_refs = 1;
+	wl_list_insert(&client->pools, &pool->link);
+
+	client->pending_pool = pool;
+	wl_list_remove(&client->pending_link);
+	wl_list_insert(&shm_udmabuf->pending_clients, &client->pending_link);
+}
+
+static void handle_create_buffer(struct wlr_shm_udmabuf *shm_udmabuf,
+		const struct wl_protocol_logger_message *message) {
+	struct wl_listener *listener = wl_resource_get_destroy_listener(
+		message->resource, pool_handle_resource_destroy);
+	if (listener == NULL) {
+		return;
+	}
+	struct shm_udmabuf_pool *pool =
+		wl_container_of(listener, pool, resource_destroy);
+	struct shm_udmabuf_client *client = pool->client;
+
+	struct shm_udmabuf_buffer *buffer =
+		calloc(1, sizeof(struct shm_udmabuf_buffer));
+	if (buffer == NULL) {
+		return;
+	}
+	buffer->pool = pool;
+	buffer->id = message->arguments[0].n;
+	buffer->offset = message->arguments[1].i;
+	buffer->width = message->arguments[2].i;
+	buffer->height = message->arguments[3].i;
+	buffer->stride = message->arguments[4].i;
+	buffer->format = message->arguments[5].u;
+	buffer->dmabuf_fd = -1;
+	pool->n_refs++;
+	wl_list_insert(&client->buffers, &buffer->link);
+
+	client->pending_buffer = buffer;
+	wl_list_remove(&client->pending_link);
+	wl_list_insert(&shm_udmabuf->pending_clients, &client->pending_link);
+}
+
+static void handle_protocol_message(void *data,
+		enum wl_protocol_logger_type direction,
+		const struct wl_protocol_logger_message *message) {
+	struct wlr_shm_udmabuf *shm_udmabuf = data;
+
+	// Any message logged after a creation request means the request has
+	// been dispatched
+	struct shm_udmabuf_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &shm_udmabuf->pending_clients,
+			pending_link) {
+		client_bind_pending(client);
+	}
+
+	if (direction != WL_PROTOCOL_LOGGER_REQUEST) {
+		return;
+	}
+
+	if (message->message == &wl_shm_interface.methods[0]) {
+		handle_create_pool(shm_udmabuf, message);
+	} else if (message->message == &wl_shm_pool_interface.methods[0]) {
+		handle_create_buffer(shm_udmabuf, message);
+	}
+}
+
+#if WLR_HAS_UDMABUF
+static uint32_t convert_wl_shm_format_to_drm(enum wl_shm_format fmt) {
+	switch (fmt) {
+	case WL_SHM_FORMAT_ARGB8888:
+		return DRM_FORMAT_ARGB8888;
+	case WL_SHM_FORMAT_XRGB8888:
+		return DRM_FORMAT_XRGB8888;
+	default:
+		return (uint32_t)fmt;
+	}
+}
+
+static bool buffer_create_udmabuf(struct shm_udmabuf_buffer *buffer) {
+	struct shm_udmabuf_pool *pool = buffer->pool;
+
+	// The pool is sealed against shrinking, but may have been write-sealed
+	// since it was created
+	int seals = fcntl(pool->fd, F_GET_SEALS);
+	if (seals < 0 || (seals & F_SEAL_WRITE)) {
+		return false;
+	}
+
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (buffer->offset < 0 || buffer->offset % page_size != 0) {
+		return false;
+	}
+
+	uint64_t size = (uint64_t)buffer->stride * buffer->height;
+	size = (size + page_size - 1) / page_size * page_size;
+
+	struct stat st;
+	if (fstat(pool->fd, &st) != 0 ||
+			(uint64_t)buffer->offset + size > (uint64_t)st.st_size) {
+		return false;
+	}
+
+	struct udmabuf_create create = {
+		.memfd = pool->fd,
+		.flags = UDMABUF_FLAGS_CLOEXEC,
+		.offset = buffer->offset,
+		.size = size,
+	};
+	int fd = ioctl(pool->client->shm_udmabuf->udmabuf_fd, UDMABUF_CREATE,
+		&create);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "UDMABUF_CREATE failed");
+		return false;
+	}
+
+	buffer->dmabuf_fd = fd;
+	return true;
+}
+#endif
+
+static struct shm_udmabuf_buffer *buffer_from_resource(
+		struct wl_resource *buffer_resource) {
+	struct wl_listener *listener = wl_resource_get_destroy_listener(
+		buffer_resource, buffer_handle_resource_destroy);
+	if (listener == NULL) {
+		return NULL;
+	}
+	struct shm_udmabuf_buffer *buffer =
+		wl_container_of(listener, buffer, resource_destroy);
+	return buffer;
+}
+
+bool wlr_shm_udmabuf_get_dmabuf(struct wl_resource *buffer_resource,
+		struct wlr_dmabuf_attributes *attribs) {
+#if WLR_HAS_UDMABUF
+	struct shm_udmabuf_buffer *buffer = buffer_from_resource(buffer_resource);
+	if (buffer == NULL) {
+		return false;
+	}
+
+	if (buffer->dmabuf_fd < 0) {
+		if (buffer->import_failed) {
+			return false;
+		}
+		if (!buffer_create_udmabuf(buffer)) {
+			buffer->import_failed = true;
+			return false;
+		}
+	}
+
+	memset(attribs, 0, sizeof(*attribs));
+	attribs->width = buffer->width;
+	attribs->height = buffer->height;
+	attribs->format = convert_wl_shm_format_to_drm(buffer->format);
+	attribs->modifier = DRM_FORMAT_MOD_LINEAR;
+	attribs->n_planes = 1;
+	attribs->offset[0] = 0;
+	attribs->stride[0] = buffer->stride;
+	attribs->fd[0] = buffer->dmabuf_fd;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void wlr_shm_udmabuf_import_failed(struct wl_resource *buffer_resource) {
+	struct shm_udmabuf_buffer *buffer = buffer_from_resource(buffer_resource);
+	if (buffer == NULL) {
+		return;
+	}
+
+	buffer->import_failed = true;
+	if (buffer->dmabuf_fd >= 0) {
+		close(buffer->dmabuf_fd);
+		buffer->dmabuf_fd = -1;
+	}
+}
+
+void wlr_shm_udmabuf_destroy(struct wlr_shm_udmabuf *shm_udmabuf) {
+	if (shm_udmabuf == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&shm_udmabuf->events.destroy, shm_udmabuf);
+
+	struct shm_udmabuf_client *client, *tmp;
+	wl_list_for_each_safe(client, tmp, &shm_udmabuf->clients, link) {
+		client_destroy(client);
+	}
+
+	wl_protocol_logger_destroy(shm_udmabuf->logger);
+	wl_list_remove(&shm_udmabuf->display_destroy.link);
+	close(shm_udmabuf->udmabuf_fd);
+	free(shm_udmabuf);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_shm_udmabuf *shm_udmabuf =
+		wl_container_of(listener, shm_udmabuf, display_destroy);
+	wlr_shm_udmabuf_destroy(shm_udmabuf);
+}
+
+struct wlr_shm_udmabuf *wlr_shm_udmabuf_create(struct wl_display *display) {
+#if WLR_HAS_UDMABUF
+	int udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (udmabuf_fd < 0) {
+		wlr_log_errno(WLR_INFO, "Failed to open /dev/udmabuf");
+		return NULL;
+	}
+
+	struct wlr_shm_udmabuf *shm_udmabuf =
+		calloc(1, sizeof(struct wlr_shm_udmabuf));
+	if (shm_udmabuf == NULL) {
+		close(udmabuf_fd);
+		return NULL;
+	}
+	shm_udmabuf->udmabuf_fd = udmabuf_fd;
+	wl_list_init(&shm_udmabuf->clients);
+	wl_list_init(&shm_udmabuf->pending_clients);
+	wl_signal_init(&shm_udmabuf->events.destroy);
+
+	shm_udmabuf->logger = wl_display_add_protocol_logger(display,
+		handle_protocol_message, shm_udmabuf);
+	if (shm_udmabuf->logger == NULL) {
+		close(udmabuf_fd);
+		free(shm_udmabuf);
+		return NULL;
+	}
+
+	shm_udmabuf->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &shm_udmabuf->display_destroy);
+
+	return shm_udmabuf;
+#else
+	wlr_log(WLR_INFO, "wlroots has been built without udmabuf support");
+	return NULL;
+#endif
+}
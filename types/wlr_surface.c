@@ -6,6 +6,7 @@
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_region.h>
+#include <wlr/types/wlr_shm_udmabuf.h>
 #include <wlr/types/wlr_surface.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
@@ -278,6 +279,149 @@ static void surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 	}
 }
 
+static uint64_t next_buffer_seq = 1;
+
+/**
+ * Record the buffer damage of the current commit in the history and return
+ * the sequence number tagging the new texture contents.
+ */
+static uint64_t surface_push_buffer_damage(struct wlr_surface *surface) {
+	surface->buffer_history_idx =
+		(surface->buffer_history_idx + 1) % WLR_SURFACE_BUFFER_HISTORY_LEN;
+	uint64_t seq = next_buffer_seq++;
+	pixman_region32_t *damage =
+		&surface->buffer_history[surface->buffer_history_idx].damage;
+	surface->buffer_history[surface->buffer_history_idx].seq = seq;
+	pixman_region32_copy(damage, &surface->buffer_damage);
+	if (surface->current.buffer_width != surface->previous.buffer_width ||
+			surface->current.buffer_height !=
+			surface->previous.buffer_height) {
+		// surface_update_damage only checks for surface size changes, but a
+		// buffer resize (e.g. on scale change) invalidates all contents
+		pixman_region32_union_rect(damage, damage, 0, 0,
+			surface->current.buffer_width, surface->current.buffer_height);
+	}
+	return seq;
+}
+
+/**
+ * Accumulate the buffer damage since the commit tagged with `seq`. Returns
+ * false if this commit is too old or doesn't belong to this surface.
+ */
+static bool surface_get_damage_since(struct wlr_surface *surface,
+		uint64_t seq, pixman_region32_t *damage) {
+	pixman_region32_clear(damage);
+	if (seq == 0) {
+		return false;
+	}
+
+	for (size_t i = 0; i < WLR_SURFACE_BUFFER_HISTORY_LEN; ++i) {
+		size_t j = (surface->buffer_history_idx +
+			WLR_SURFACE_BUFFER_HISTORY_LEN - i) % WLR_SURFACE_BUFFER_HISTORY_LEN;
+		if (surface->buffer_history[j].seq == 0) {
+			return false;
+		}
+		if (surface->buffer_history[j].seq == seq) {
+			return true;
+		}
+		pixman_region32_union(damage, damage,
+			&surface->buffer_history[j].damage);
+	}
+
+	return false;
+}
+
+static void surface_account_upload(struct wlr_surface *surface,
+		struct wl_resource *resource, pixman_region32_t *region) {
+	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+	if (shm_buf == NULL) {
+		return;
+	}
+
+	int32_t width = wl_shm_buffer_get_width(shm_buf);
+	int32_t height = wl_shm_buffer_get_height(shm_buf);
+	if (width <= 0) {
+		return;
+	}
+	uint64_t bpp = wl_shm_buffer_get_stride(shm_buf) / width;
+
+	uint64_t full = bpp * width * height;
+	surface->upload_stats.full_upload_bytes += full;
+	if (region == NULL) {
+		surface->upload_stats.upload_bytes += full;
+		return;
+	}
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &n);
+	for (int i = 0; i < n; ++i) {
+		pixman_box32_t *r = &rects[i];
+		surface->upload_stats.upload_bytes +=
+			bpp * (r->x2 - r->x1) * (r->y2 - r->y1);
+	}
+}
+
+/**
+ * Try to import a wl_shm buffer into a texture recycled from the renderer's
+ * texture pool. If one of this surface's previous textures is still around,
+ * only the damage since then is uploaded.
+ */
+static struct wlr_client_buffer *surface_import_recycled(
+		struct wlr_surface *surface, struct wl_resource *resource) {
+	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+	if (shm_buf == NULL) {
+		return NULL;
+	}
+
+	struct wlr_dmabuf_attributes attribs;
+	if (wlr_shm_udmabuf_get_dmabuf(resource, &attribs)) {
+		// Importing the buffer without a copy is cheaper than any upload
+		return NULL;
+	}
+
+	enum wl_shm_format fmt = wl_shm_buffer_get_format(shm_buf);
+	int32_t width = wl_shm_buffer_get_width(shm_buf);
+	int32_t height = wl_shm_buffer_get_height(shm_buf);
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+
+	// Prefer the most recent texture with this surface's contents
+	struct wlr_texture *texture = NULL;
+	for (size_t i = 0; i < WLR_SURFACE_BUFFER_HISTORY_LEN; ++i) {
+		size_t j = (surface->buffer_history_idx +
+			WLR_SURFACE_BUFFER_HISTORY_LEN - i) % WLR_SURFACE_BUFFER_HISTORY_LEN;
+		uint64_t seq = surface->buffer_history[j].seq;
+		if (seq == 0) {
+			break;
+		}
+		texture = wlr_renderer_texture_pool_acquire(surface->renderer,
+			fmt, width, height, seq);
+		if (texture != NULL) {
+			surface_get_damage_since(surface, seq, &damage);
+			break;
+		}
+	}
+	if (texture == NULL) {
+		texture = wlr_renderer_texture_pool_acquire(surface->renderer,
+			fmt, width, height, 0);
+		pixman_region32_union_rect(&damage, &damage, 0, 0, width, height);
+	}
+	if (texture == NULL) {
+		pixman_region32_fini(&damage);
+		return NULL;
+	}
+
+	surface_account_upload(surface, resource, &damage);
+	struct wlr_client_buffer *buffer = wlr_client_buffer_import_recycled(
+		surface->renderer, resource, texture, &damage);
+	pixman_region32_fini(&damage);
+	if (buffer != NULL) {
+		surface->upload_stats.textures_recycled++;
+	}
+	return buffer;
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	struct wl_resource *resource = surface->current.buffer_resource;
 	if (resource == NULL) {
@@ -289,22 +433,45 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
+	uint64_t seq = surface_push_buffer_damage(surface);
+
 	if (surface->buffer != NULL && surface->buffer->resource_released) {
-		struct wlr_client_buffer *updated_buffer =
-			wlr_client_buffer_apply_damage(surface->buffer, resource,
-			&surface->buffer_damage);
+		pixman_region32_t damage;
+		pixman_region32_init(&damage);
+		struct wlr_client_buffer *updated_buffer = NULL;
+		if (surface_get_damage_since(surface,
+				surface->buffer->content_seq, &damage)) {
+			updated_buffer = wlr_client_buffer_apply_damage(surface->buffer,
+				resource, &damage);
+		}
 		if (updated_buffer != NULL) {
+			surface_account_upload(surface, resource, &damage);
+			pixman_region32_fini(&damage);
+			updated_buffer->content_seq = seq;
 			surface->buffer = updated_buffer;
 			return;
 		}
+		pixman_region32_fini(&damage);
 	}
 
 	struct wlr_client_buffer *buffer =
-		wlr_client_buffer_import(surface->renderer, resource);
+		surface_import_recycled(surface, resource);
+	if (buffer == NULL) {
+		buffer = wlr_client_buffer_import(surface->renderer, resource);
+		if (buffer != NULL) {
+			pixman_region32_t uploaded;
+			pixman_region32_init(&uploaded);
+			// Zero-copy wl_shm imports don't upload anything
+			surface_account_upload(surface, resource,
+				buffer->shm_texture ? NULL : &uploaded);
+			pixman_region32_fini(&uploaded);
+		}
+	}
 	if (buffer == NULL) {
 		wlr_log(WLR_ERROR, "Failed to upload buffer");
 		return;
 	}
+	buffer->content_seq = seq;
 
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
@@ -336,6 +503,52 @@ static void surface_update_input_region(struct wlr_surface *surface) {
 		0, 0, surface->current.width, surface->current.height);
 }
 
+/**
+ * Invalidate the cached bounding box of the surface and of all of its
+ * ancestors.
+ */
+static void surface_invalidate_bounds(struct wlr_surface *surface) {
+	while (surface != NULL) {
+		surface->bounds_valid = false;
+		if (!wlr_surface_is_subsurface(surface)) {
+			break;
+		}
+		struct wlr_subsurface *subsurface =
+			wlr_subsurface_from_wlr_surface(surface);
+		if (subsurface == NULL) {
+			break;
+		}
+		surface = subsurface->parent;
+	}
+}
+
+static const pixman_box32_t *surface_get_bounds(struct wlr_surface *surface) {
+	if (surface->bounds_valid) {
+		return &surface->bounds;
+	}
+
+	pixman_box32_t bounds = {
+		.x1 = 0,
+		.y1 = 0,
+		.x2 = surface->current.width,
+		.y2 = surface->current.height,
+	};
+
+	struct wlr_subsurface *subsurface;
+	wl_list_for_each(subsurface, &surface->subsurfaces, parent_link) {
+		const pixman_box32_t *sub = surface_get_bounds(subsurface->surface);
+		int32_t x = subsurface->current.x, y = subsurface->current.y;
+		bounds.x1 = min(bounds.x1, x + sub->x1);
+		bounds.y1 = min(bounds.y1, y + sub->y1);
+		bounds.x2 = max(bounds.x2, x + sub->x2);
+		bounds.y2 = max(bounds.y2, y + sub->y2);
+	}
+
+	surface->bounds = bounds;
+	surface->bounds_valid = true;
+	return &surface->bounds;
+}
+
 static void surface_commit_pending(struct wlr_surface *surface) {
 	surface_state_finalize(surface, &surface->pending);
 
@@ -358,6 +571,7 @@ static void surface_commit_pending(struct wlr_surface *surface) {
 	}
 	surface_update_opaque_region(surface);
 	surface_update_input_region(surface);
+	surface_invalidate_bounds(surface);
 
 	// commit subsurface order
 	struct wlr_subsurface *subsurface;
@@ -553,6 +767,7 @@ static void subsurface_destroy(struct wlr_subsurface *subsurface) {
 	surface_state_finish(&subsurface->cached);
 
 	if (subsurface->parent) {
+		surface_invalidate_bounds(subsurface->parent);
 		wl_list_remove(&subsurface->parent_link);
 		wl_list_remove(&subsurface->parent_pending_link);
 		wl_list_remove(&subsurface->parent_destroy.link);
@@ -579,6 +794,9 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	pixman_region32_fini(&surface->buffer_damage);
 	pixman_region32_fini(&surface->opaque_region);
 	pixman_region32_fini(&surface->input_region);
+	for (size_t i = 0; i < WLR_SURFACE_BUFFER_HISTORY_LEN; ++i) {
+		pixman_region32_fini(&surface->buffer_history[i].damage);
+	}
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
@@ -628,6 +846,9 @@ struct wlr_surface *wlr_surface_create(struct wl_client *client,
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
+	for (size_t i = 0; i < WLR_SURFACE_BUFFER_HISTORY_LEN; ++i) {
+		pixman_region32_init(&surface->buffer_history[i].damage);
+	}
 
 	wl_signal_add(&renderer->events.destroy, &surface->renderer_destroy);
 	surface->renderer_destroy.notify = surface_handle_renderer_destroy;
@@ -979,6 +1200,7 @@ struct wlr_subsurface *wlr_subsurface_create(struct wlr_surface *surface,
 	wl_list_insert(parent->subsurfaces.prev, &subsurface->parent_link);
 	wl_list_insert(parent->subsurface_pending_list.prev,
 		&subsurface->parent_pending_link);
+	surface_invalidate_bounds(parent);
 
 	surface->role_data = subsurface;
 
@@ -1018,10 +1240,17 @@ struct wlr_surface *wlr_surface_surface_at(struct wlr_surface *surface,
 		double sx, double sy, double *sub_x, double *sub_y) {
 	struct wlr_subsurface *subsurface;
 	wl_list_for_each_reverse(subsurface, &surface->subsurfaces, parent_link) {
-		double _sub_x = subsurface->current.x;
-		double _sub_y = subsurface->current.y;
+		double _sub_x = sx - subsurface->current.x;
+		double _sub_y = sy - subsurface->current.y;
+		// Skip whole subsurface trees which can't contain the point
+		const pixman_box32_t *bounds = surface_get_bounds(subsurface->surface);
+		if (_sub_x < bounds->x1 || _sub_x >= bounds->x2 ||
+				_sub_y < bounds->y1 || _sub_y >= bounds->y2) {
+			continue;
+		}
+
 		struct wlr_surface *sub = wlr_surface_surface_at(subsurface->surface,
-			sx - _sub_x, sy - _sub_y, sub_x, sub_y);
+			_sub_x, _sub_y, sub_x, sub_y);
 		if (sub != NULL) {
 			return sub;
 		}
@@ -1096,36 +1325,12 @@ void wlr_surface_for_each_surface(struct wlr_surface *surface,
 	surface_for_each_surface(surface, 0, 0, iterator, user_data);
 }
 
-struct bound_acc {
-	int32_t min_x, min_y;
-	int32_t max_x, max_y;
-};
-
-static void handle_bounding_box_surface(struct wlr_surface *surface,
-		int x, int y, void *data) {
-	struct bound_acc *acc = data;
-
-	acc->min_x = min(x, acc->min_x);
-	acc->min_y = min(y, acc->min_y);
-
-	acc->max_x = max(x + surface->current.width, acc->max_x);
-	acc->max_y = max(y + surface->current.height, acc->max_y);
-}
-
 void wlr_surface_get_extends(struct wlr_surface *surface, struct wlr_box *box) {
-	struct bound_acc acc = {
-		.min_x = 0,
-		.min_y = 0,
-		.max_x = surface->current.width,
-		.max_y = surface->current.height,
-	};
-
-	wlr_surface_for_each_surface(surface, handle_bounding_box_surface, &acc);
-
-	box->x = acc.min_x;
-	box->y = acc.min_y;
-	box->width = acc.max_x - acc.min_x;
-	box->height = acc.max_y - acc.min_y;
+	const pixman_box32_t *bounds = surface_get_bounds(surface);
+	box->x = bounds->x1;
+	box->y = bounds->y1;
+	box->width = bounds->x2 - bounds->x1;
+	box->height = bounds->y2 - bounds->y1;
 }
 
 void wlr_surface_get_effective_damage(struct wlr_surface *surface,
@@ -1,4 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wlr/types/wlr_xcursor_manager.h>
@@ -28,10 +30,25 @@ void wlr_xcursor_manager_destroy(struct wlr_xcursor_manager *manager) {
 		wlr_xcursor_theme_destroy(theme->theme);
 		free(theme);
 	}
+	free(manager->cache_dir);
 	free(manager->name);
 	free(manager);
 }
 
+void wlr_xcursor_manager_set_cache_dir(struct wlr_xcursor_manager *manager,
+		const char *cache_dir) {
+	free(manager->cache_dir);
+	manager->cache_dir = NULL;
+	if (cache_dir != NULL) {
+		manager->cache_dir = strdup(cache_dir);
+	}
+}
+
+void wlr_xcursor_manager_set_animated(struct wlr_xcursor_manager *manager,
+		bool animated) {
+	manager->animated = animated;
+}
+
 int wlr_xcursor_manager_load(struct wlr_xcursor_manager *manager,
 		float scale) {
 	struct wlr_xcursor_manager_theme *theme;
@@ -46,7 +63,17 @@ int wlr_xcursor_manager_load(struct wlr_xcursor_manager *manager,
 		return 1;
 	}
 	theme->scale = scale;
-	theme->theme = wlr_xcursor_theme_load(manager->name, manager->size * scale);
+	int size = manager->size * scale;
+	if (manager->cache_dir != NULL) {
+		char cache_path[PATH_MAX];
+		snprintf(cache_path, sizeof(cache_path), "%s/%s-%d.cache",
+			manager->cache_dir,
+			manager->name != NULL ? manager->name : "default", size);
+		theme->theme = wlr_xcursor_theme_load_cached(manager->name, size,
+			cache_path);
+	} else {
+		theme->theme = wlr_xcursor_theme_load(manager->name, size);
+	}
 	if (theme->theme == NULL) {
 		free(theme);
 		return 1;
@@ -76,6 +103,11 @@ void wlr_xcursor_manager_set_cursor_image(struct wlr_xcursor_manager *manager,
 			continue;
 		}
 
+		if (manager->animated) {
+			wlr_cursor_set_xcursor(cursor, xcursor, theme->scale);
+			continue;
+		}
+
 		struct wlr_xcursor_image *image = xcursor->images[0];
 		wlr_cursor_set_image(cursor, image->buffer, image->width * 4,
 			image->width, image->height, image->hotspot_x, image->hotspot_y,
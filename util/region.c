@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/util/region.h>
 
@@ -181,6 +183,124 @@ void wlr_region_rotated_bounds(pixman_region32_t *dst, pixman_region32_t *src,
 	free(dst_rects);
 }
 
+static void region_snap_to_grid(pixman_region32_t *dst,
+		pixman_region32_t *src, int tile_size) {
+	int nrects;
+	pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
+
+	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (dst_rects == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < nrects; ++i) {
+		dst_rects[i].x1 = floor((double)src_rects[i].x1 / tile_size) * tile_size;
+		dst_rects[i].x2 = ceil((double)src_rects[i].x2 / tile_size) * tile_size;
+		dst_rects[i].y1 = floor((double)src_rects[i].y1 / tile_size) * tile_size;
+		dst_rects[i].y2 = ceil((double)src_rects[i].y2 / tile_size) * tile_size;
+	}
+
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, dst_rects, nrects);
+	free(dst_rects);
+}
+
+static uint64_t box_area(const pixman_box32_t *box) {
+	return (uint64_t)(box->x2 - box->x1) * (uint64_t)(box->y2 - box->y1);
+}
+
+static pixman_box32_t box_union(const pixman_box32_t *a,
+		const pixman_box32_t *b) {
+	return (pixman_box32_t){
+		.x1 = a->x1 < b->x1 ? a->x1 : b->x1,
+		.y1 = a->y1 < b->y1 ? a->y1 : b->y1,
+		.x2 = a->x2 > b->x2 ? a->x2 : b->x2,
+		.y2 = a->y2 > b->y2 ? a->y2 : b->y2,
+	};
+}
+
+/**
+ * Rectangles are only merged with the next few ones in the list. Regions are
+ * sorted by bands, so these are the closest ones; this keeps each merge step
+ * linear in the number of rectangles.
+ */
+#define SIMPLIFY_MERGE_WINDOW 16
+
+static void region_merge_rects(pixman_region32_t *dst, pixman_region32_t *src,
+		int max_rects) {
+	int nrects;
+	pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
+
+	pixman_box32_t *rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (rects == NULL) {
+		return;
+	}
+	memcpy(rects, src_rects, nrects * sizeof(pixman_box32_t));
+
+	while (nrects > max_rects) {
+		int best_i = 0, best_j = 1;
+		uint64_t best_cost = UINT64_MAX;
+		for (int i = 0; i < nrects; ++i) {
+			for (int j = i + 1;
+					j < nrects && j <= i + SIMPLIFY_MERGE_WINDOW; ++j) {
+				pixman_box32_t merged = box_union(&rects[i], &rects[j]);
+				uint64_t area = box_area(&merged);
+				uint64_t used = box_area(&rects[i]) + box_area(&rects[j]);
+				uint64_t cost = area > used ? area - used : 0;
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+
+		rects[best_i] = box_union(&rects[best_i], &rects[best_j]);
+		memmove(&rects[best_j], &rects[best_j + 1],
+			(nrects - best_j - 1) * sizeof(pixman_box32_t));
+		--nrects;
+	}
+
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, rects, nrects);
+	free(rects);
+}
+
+void wlr_region_simplify(pixman_region32_t *dst, pixman_region32_t *src,
+		int max_rects, int tile_size) {
+	if (max_rects < 1) {
+		max_rects = 1;
+	}
+
+	pixman_region32_copy(dst, src);
+	if (pixman_region32_n_rects(dst) <= max_rects) {
+		return;
+	}
+
+	if (tile_size > 1) {
+		region_snap_to_grid(dst, dst, tile_size);
+	}
+
+	// Merged rectangles may overlap others, and the resulting region can be
+	// split into more bands than expected: repeat until the budget is met
+	int nrects = pixman_region32_n_rects(dst);
+	while (nrects > max_rects) {
+		region_merge_rects(dst, dst, max_rects);
+
+		int prev_nrects = nrects;
+		nrects = pixman_region32_n_rects(dst);
+		if (nrects >= prev_nrects) {
+			break;
+		}
+	}
+
+	if (nrects > max_rects) {
+		pixman_box32_t *extents = pixman_region32_extents(dst);
+		pixman_region32_union_rect(dst, dst, extents->x1, extents->y1,
+			extents->x2 - extents->x1, extents->y2 - extents->y1);
+	}
+}
+
 static void region_confine(pixman_region32_t *region, double x1, double y1, double x2,
 		double y2, double *x2_out, double *y2_out, pixman_box32_t box) {
 	double x_clamped = fmax(fmin(x2, box.x2 - 1), box.x1);
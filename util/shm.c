@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200112L
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <time.h>
@@ -18,7 +19,7 @@ static void randname(char *buf) {
 	}
 }
 
-int create_shm_file(void) {
+static int create_shm_file_pair(int *rw_fd, int *ro_fd) {
 	int retries = 100;
 	do {
 		char name[] = "/wlroots-XXXXXX";
@@ -26,16 +27,31 @@ int create_shm_file(void) {
 
 		--retries;
 		// CLOEXEC is guaranteed to be set by shm_open
-		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
-		if (fd >= 0) {
+		*rw_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (*rw_fd >= 0) {
+			if (ro_fd != NULL) {
+				*ro_fd = shm_open(name, O_RDONLY, 0);
+			}
 			shm_unlink(name);
-			return fd;
+			if (ro_fd != NULL && *ro_fd < 0) {
+				close(*rw_fd);
+				return -1;
+			}
+			return 0;
 		}
 	} while (retries > 0 && errno == EEXIST);
 
 	return -1;
 }
 
+int create_shm_file(void) {
+	int fd;
+	if (create_shm_file_pair(&fd, NULL) < 0) {
+		return -1;
+	}
+	return fd;
+}
+
 int allocate_shm_file(size_t size) {
 	int fd = create_shm_file();
 	if (fd < 0) {
@@ -53,3 +69,37 @@ int allocate_shm_file(size_t size) {
 
 	return fd;
 }
+
+static bool write_all(int fd, const void *data, size_t size) {
+	const char *ptr = data;
+	while (size > 0) {
+		ssize_t n = write(fd, ptr, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		ptr += n;
+		size -= n;
+	}
+	return true;
+}
+
+int create_readonly_shm_file(const void *data, size_t size) {
+	// A write-sealed memfd can't be used here: before Linux 6.7, mmap with
+	// MAP_SHARED fails on it even with PROT_READ, and clients are free to map
+	// the keymap this way before wl_seat version 7. Instead, hand out a
+	// read-only descriptor to an unlinked shm file.
+	int rw_fd, ro_fd;
+	if (create_shm_file_pair(&rw_fd, &ro_fd) < 0) {
+		return -1;
+	}
+	bool ok = write_all(rw_fd, data, size);
+	close(rw_fd);
+	if (!ok) {
+		close(ro_fd);
+		return -1;
+	}
+	return ro_fd;
+}
@@ -0,0 +1,308 @@
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "xcursor/cache.h"
+
+/*
+ * Cache files are only meant to be read by the machine which wrote them, so
+ * integers are stored in native byte order. A file contains a header, the
+ * cursor table sorted by name, the image table and the image pixels.
+ */
+
+#define CACHE_MAGIC "WLRXCUR\x01"
+#define CACHE_NAME_LEN 64
+
+struct cache_header {
+	char magic[8];
+	uint32_t size;
+	uint32_t cursor_count;
+	uint32_t image_count;
+	uint32_t pad;
+	int64_t stamp;
+};
+
+struct cache_cursor {
+	char name[CACHE_NAME_LEN]; // NUL-terminated
+	uint32_t image_count;
+	uint32_t first_image; // index in the image table
+};
+
+struct cache_image {
+	uint32_t width, height;
+	uint32_t hotspot_x, hotspot_y;
+	uint32_t delay;
+	uint32_t offset; // of the ARGB pixels, from the start of the file
+};
+
+struct wlr_xcursor_cache {
+	void *data;
+	size_t size;
+
+	const struct cache_header *header;
+	const struct cache_cursor *cursors;
+	const struct cache_image *images;
+};
+
+struct wlr_xcursor_cache *xcursor_cache_open(const char *path, int size,
+		int64_t stamp) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+			(size_t)st.st_size < sizeof(struct cache_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "Failed to map cursor cache %s", path);
+		return NULL;
+	}
+
+	const struct cache_header *header = data;
+	uint64_t tables_size = sizeof(*header) +
+		(uint64_t)header->cursor_count * sizeof(struct cache_cursor) +
+		(uint64_t)header->image_count * sizeof(struct cache_image);
+	if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+			header->size != (uint32_t)size || header->stamp != stamp ||
+			tables_size > (uint64_t)st.st_size) {
+		wlr_log(WLR_DEBUG, "Ignoring stale cursor cache %s", path);
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	const struct cache_cursor *cursors =
+		(const struct cache_cursor *)(header + 1);
+	const struct cache_image *images =
+		(const struct cache_image *)(cursors + header->cursor_count);
+	for (size_t i = 0; i < header->cursor_count; i++) {
+		const struct cache_cursor *cursor = &cursors[i];
+		if (cursor->name[CACHE_NAME_LEN - 1] != '\0' ||
+				cursor->image_count == 0 ||
+				(uint64_t)cursor->first_image + cursor->image_count >
+				header->image_count) {
+			goto error_invalid;
+		}
+	}
+	for (size_t i = 0; i < header->image_count; i++) {
+		const struct cache_image *image = &images[i];
+		uint64_t end = (uint64_t)image->offset +
+			(uint64_t)image->width * image->height * 4;
+		if (image->offset % 4 != 0 || end > (uint64_t)st.st_size) {
+			goto error_invalid;
+		}
+	}
+
+	struct wlr_xcursor_cache *cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+	cache->data = data;
+	cache->size = st.st_size;
+	cache->header = header;
+	cache->cursors = cursors;
+	cache->images = images;
+	return cache;
+
+error_invalid:
+	wlr_log(WLR_ERROR, "Invalid cursor cache %s", path);
+	munmap(data, st.st_size);
+	return NULL;
+}
+
+void xcursor_cache_destroy(struct wlr_xcursor_cache *cache) {
+	if (cache == NULL) {
+		return;
+	}
+	munmap(cache->data, cache->size);
+	free(cache);
+}
+
+static int cache_cursor_cmp(const void *key, const void *elem) {
+	const struct cache_cursor *cursor = elem;
+	return strcmp(key, cursor->name);
+}
+
+struct wlr_xcursor *xcursor_cache_get_cursor(struct wlr_xcursor_cache *cache,
+		const char *name) {
+	const struct cache_cursor *entry = bsearch(name, cache->cursors,
+		cache->header->cursor_count, sizeof(struct cache_cursor),
+		cache_cursor_cmp);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	struct wlr_xcursor *cursor = calloc(1, sizeof(*cursor));
+	if (cursor == NULL) {
+		return NULL;
+	}
+	cursor->name = strdup(entry->name);
+	cursor->images = calloc(entry->image_count, sizeof(cursor->images[0]));
+	if (cursor->name == NULL || cursor->images == NULL) {
+		goto error_cursor;
+	}
+
+	for (size_t i = 0; i < entry->image_count; i++) {
+		const struct cache_image *src = &cache->images[entry->first_image + i];
+		struct wlr_xcursor_image *image = calloc(1, sizeof(*image));
+		if (image == NULL) {
+			goto error_cursor;
+		}
+		cursor->images[i] = image;
+		cursor->image_count++;
+
+		image->width = src->width;
+		image->height = src->height;
+		image->hotspot_x = src->hotspot_x;
+		image->hotspot_y = src->hotspot_y;
+		image->delay = src->delay;
+
+		size_t size = (size_t)src->width * src->height * 4;
+		image->buffer = malloc(size);
+		if (image->buffer == NULL) {
+			goto error_cursor;
+		}
+		memcpy(image->buffer, (const uint8_t *)cache->data + src->offset, size);
+		cursor->total_delay += image->delay;
+	}
+
+	return cursor;
+
+error_cursor:
+	for (size_t i = 0; i < cursor->image_count; i++) {
+		free(cursor->images[i]->buffer);
+		free(cursor->images[i]);
+	}
+	free(cursor->images);
+	free(cursor->name);
+	free(cursor);
+	return NULL;
+}
+
+size_t xcursor_cache_get_cursor_count(struct wlr_xcursor_cache *cache) {
+	return cache->header->cursor_count;
+}
+
+const char *xcursor_cache_get_cursor_name(struct wlr_xcursor_cache *cache,
+		size_t index) {
+	return cache->cursors[index].name;
+}
+
+static int xcursor_name_cmp(const void *a, const void *b) {
+	struct wlr_xcursor *const *cursor_a = a;
+	struct wlr_xcursor *const *cursor_b = b;
+	return strcmp((*cursor_a)->name, (*cursor_b)->name);
+}
+
+bool xcursor_cache_write(const char *path, int size, int64_t stamp,
+		struct wlr_xcursor **cursors, size_t cursors_len) {
+	struct wlr_xcursor **sorted = calloc(cursors_len, sizeof(sorted[0]));
+	if (sorted == NULL && cursors_len > 0) {
+		return false;
+	}
+
+	struct cache_header header = {
+		.size = size,
+		.stamp = stamp,
+	};
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	for (size_t i = 0; i < cursors_len; i++) {
+		if (strlen(cursors[i]->name) >= CACHE_NAME_LEN) {
+			continue;
+		}
+		sorted[header.cursor_count++] = cursors[i];
+		header.image_count += cursors[i]->image_count;
+	}
+	qsort(sorted, header.cursor_count, sizeof(sorted[0]), xcursor_name_cmp);
+
+	size_t tmp_path_len = strlen(path) + 8;
+	char *tmp_path = malloc(tmp_path_len);
+	if (tmp_path == NULL) {
+		free(sorted);
+		return false;
+	}
+	snprintf(tmp_path, tmp_path_len, "%s.XXXXXX", path);
+	int fd = mkstemp(tmp_path);
+	FILE *f = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if (f == NULL) {
+		wlr_log_errno(WLR_ERROR, "Failed to create cursor cache %s", path);
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp_path);
+		}
+		free(tmp_path);
+		free(sorted);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+	uint32_t first_image = 0;
+	for (size_t i = 0; ok && i < header.cursor_count; i++) {
+		struct cache_cursor entry = {
+			.image_count = sorted[i]->image_count,
+			.first_image = first_image,
+		};
+		strcpy(entry.name, sorted[i]->name);
+		ok = fwrite(&entry, sizeof(entry), 1, f) == 1;
+		first_image += entry.image_count;
+	}
+
+	uint64_t offset = sizeof(header) +
+		(uint64_t)header.cursor_count * sizeof(struct cache_cursor) +
+		(uint64_t)header.image_count * sizeof(struct cache_image);
+	for (size_t i = 0; ok && i < header.cursor_count; i++) {
+		for (size_t j = 0; ok && j < sorted[i]->image_count; j++) {
+			struct wlr_xcursor_image *image = sorted[i]->images[j];
+			if (offset > UINT32_MAX) {
+				ok = false;
+				break;
+			}
+			struct cache_image entry = {
+				.width = image->width,
+				.height = image->height,
+				.hotspot_x = image->hotspot_x,
+				.hotspot_y = image->hotspot_y,
+				.delay = image->delay,
+				.offset = offset,
+			};
+			ok = fwrite(&entry, sizeof(entry), 1, f) == 1;
+			offset += (uint64_t)image->width * image->height * 4;
+		}
+	}
+
+	for (size_t i = 0; ok && i < header.cursor_count; i++) {
+		for (size_t j = 0; ok && j < sorted[i]->image_count; j++) {
+			struct wlr_xcursor_image *image = sorted[i]->images[j];
+			size_t len = (size_t)image->width * image->height * 4;
+			ok = fwrite(image->buffer, 1, len, f) == len;
+		}
+	}
+
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	if (ok && rename(tmp_path, path) != 0) {
+		ok = false;
+	}
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to write cursor cache %s", path);
+		unlink(tmp_path);
+	}
+
+	free(tmp_path);
+	free(sorted);
+	return ok;
+}
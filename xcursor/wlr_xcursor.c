@@ -30,6 +30,7 @@
 #include <string.h>
 #include <wlr/util/log.h>
 #include <wlr/xcursor.h>
+#include "xcursor/cache.h"
 #include "xcursor/xcursor.h"
 
 static void xcursor_destroy(struct wlr_xcursor *cursor) {
@@ -101,31 +102,6 @@ err_free_cursor:
 	return NULL;
 }
 
-static void load_default_theme(struct wlr_xcursor_theme *theme) {
-	uint32_t i;
-
-	free(theme->name);
-	theme->name = strdup("default");
-
-	theme->cursor_count = sizeof(cursor_metadata) / sizeof(cursor_metadata[0]);
-	theme->cursors = malloc(theme->cursor_count * sizeof(*theme->cursors));
-
-	if (theme->cursors == NULL) {
-		theme->cursor_count = 0;
-		return;
-	}
-
-	for (i = 0; i < theme->cursor_count; ++i) {
-		theme->cursors[i] =
-			xcursor_create_from_data(&cursor_metadata[i], theme);
-
-		if (theme->cursors[i] == NULL) {
-			break;
-		}
-	}
-	theme->cursor_count = i;
-}
-
 static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 		XcursorImages *images, struct wlr_xcursor_theme *theme) {
 	struct wlr_xcursor *cursor;
@@ -184,40 +160,148 @@ static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 	return cursor;
 }
 
-static void load_callback(XcursorImages *images, void *data) {
-	struct wlr_xcursor_theme *theme = data;
-	struct wlr_xcursor *cursor;
+struct wlr_xcursor_theme_entry {
+	char *name; // NULL if the slot is free
+	struct wlr_xcursor *cursor; // NULL if the theme has no such cursor
+};
+
+static size_t theme_index_hash(const char *name) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (const char *c = name; *c != '\0'; c++) {
+		hash ^= (uint8_t)*c;
+		hash *= 16777619u;
+	}
+	return hash;
+}
 
-	if (wlr_xcursor_theme_get_cursor(theme, images->name)) {
-		XcursorImagesDestroy(images);
-		return;
+static struct wlr_xcursor_theme_entry *theme_index_find(
+		struct wlr_xcursor_theme_entry *index, size_t cap, const char *name) {
+	if (cap == 0) {
+		return NULL;
 	}
+	size_t i = theme_index_hash(name) & (cap - 1);
+	while (index[i].name != NULL && strcmp(index[i].name, name) != 0) {
+		i = (i + 1) & (cap - 1);
+	}
+	return &index[i];
+}
 
-	cursor = xcursor_create_from_xcursor_images(images, theme);
+static bool theme_index_grow(struct wlr_xcursor_theme *theme) {
+	size_t cap = theme->index_cap ? theme->index_cap * 2 : 64;
+	struct wlr_xcursor_theme_entry *index = calloc(cap, sizeof(*index));
+	if (index == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < theme->index_cap; i++) {
+		if (theme->index[i].name != NULL) {
+			*theme_index_find(index, cap, theme->index[i].name) =
+				theme->index[i];
+		}
+	}
+	free(theme->index);
+	theme->index = index;
+	theme->index_cap = cap;
+	return true;
+}
 
-	if (cursor) {
-		struct wlr_xcursor **cursors;
-		theme->cursor_count++;
-		cursors =
-			realloc(theme->cursors,
-				theme->cursor_count * sizeof(theme->cursors[0]));
+/**
+ * Record the result of a cursor lookup. On error, the cursor is destroyed and
+ * false is returned.
+ */
+static bool theme_add_cursor(struct wlr_xcursor_theme *theme,
+		const char *name, struct wlr_xcursor *cursor) {
+	// Keep the load factor under 3/4
+	if ((theme->index_len + 1) * 4 > theme->index_cap * 3 &&
+			!theme_index_grow(theme)) {
+		goto error_cursor;
+	}
 
+	if (cursor != NULL) {
+		struct wlr_xcursor **cursors = realloc(theme->cursors,
+			(theme->cursor_count + 1) * sizeof(theme->cursors[0]));
 		if (cursors == NULL) {
-			theme->cursor_count--;
-			free(cursor);
-		} else {
-			theme->cursors = cursors;
-			theme->cursors[theme->cursor_count - 1] = cursor;
+			goto error_cursor;
 		}
+		theme->cursors = cursors;
 	}
 
-	XcursorImagesDestroy(images);
+	struct wlr_xcursor_theme_entry *entry =
+		theme_index_find(theme->index, theme->index_cap, name);
+	entry->name = strdup(name);
+	if (entry->name == NULL) {
+		goto error_cursor;
+	}
+	entry->cursor = cursor;
+	theme->index_len++;
+
+	if (cursor != NULL) {
+		theme->cursors[theme->cursor_count++] = cursor;
+	}
+	return true;
+
+error_cursor:
+	if (cursor != NULL) {
+		xcursor_destroy(cursor);
+	}
+	return false;
 }
 
-struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
-	struct wlr_xcursor_theme *theme;
+static void load_default_theme(struct wlr_xcursor_theme *theme) {
+	free(theme->name);
+	theme->name = strdup("default");
+	theme->lazy = false;
 
-	theme = malloc(sizeof(*theme));
+	size_t len = sizeof(cursor_metadata) / sizeof(cursor_metadata[0]);
+	for (size_t i = 0; i < len; ++i) {
+		struct wlr_xcursor *cursor =
+			xcursor_create_from_data(&cursor_metadata[i], theme);
+		if (cursor == NULL ||
+				!theme_add_cursor(theme, cursor_metadata[i].name, cursor)) {
+			break;
+		}
+	}
+}
+
+static struct wlr_xcursor *theme_load_builtin_cursor(
+		struct wlr_xcursor_theme *theme, const char *name) {
+	size_t len = sizeof(cursor_metadata) / sizeof(cursor_metadata[0]);
+	for (size_t i = 0; i < len; ++i) {
+		if (strcmp(cursor_metadata[i].name, name) == 0) {
+			return xcursor_create_from_data(&cursor_metadata[i], theme);
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_xcursor *theme_load_cursor(struct wlr_xcursor_theme *theme,
+		const char *name) {
+	if (theme->cache != NULL) {
+		struct wlr_xcursor *cursor =
+			xcursor_cache_get_cursor(theme->cache, name);
+		if (cursor != NULL) {
+			return cursor;
+		}
+	}
+
+	XcursorImages *images =
+		XcursorLibraryLoadImages(name, theme->name, theme->size);
+	if (images == NULL) {
+		return NULL;
+	}
+	struct wlr_xcursor *cursor =
+		xcursor_create_from_xcursor_images(images, theme);
+	XcursorImagesDestroy(images);
+
+	if (cursor != NULL && theme->cache_path != NULL) {
+		theme->cache_dirty = true;
+	}
+	return cursor;
+}
+
+struct wlr_xcursor_theme *wlr_xcursor_theme_load_cached(const char *name,
+		int size, const char *cache_path) {
+	struct wlr_xcursor_theme *theme = calloc(1, sizeof(*theme));
 	if (!theme) {
 		return NULL;
 	}
@@ -231,39 +315,70 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 		goto out_error_name;
 	}
 	theme->size = size;
-	theme->cursor_count = 0;
-	theme->cursors = NULL;
-
-	xcursor_load_theme(name, size, load_callback, theme);
+	theme->lazy = true;
 
-	if (theme->cursor_count == 0) {
+	// Only look the theme up for now, cursors are loaded on demand
+	theme->stamp = xcursor_theme_stamp(name);
+	if (theme->stamp == 0 || !xcursor_theme_has_cursors(name)) {
+		// Icon themes may have an index file but no cursors
 		load_default_theme(theme);
+		wlr_log(WLR_DEBUG, "Cursor theme '%s' not found, using built-in "
+			"cursors", name);
+		return theme;
 	}
 
-	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s', available cursors:",
-			theme->name);
-	for (size_t i = 0; i < theme->cursor_count; ++i) {
-		struct wlr_xcursor *c = theme->cursors[i];
-		struct wlr_xcursor_image *i = c->images[0];
-		wlr_log(WLR_DEBUG, "%s (%u images) %dx%d+%d,%d",
-				c->name, c->image_count,
-				i->width, i->height, i->hotspot_x, i->hotspot_y);
+	if (cache_path != NULL) {
+		theme->cache_path = strdup(cache_path);
+		if (!theme->cache_path) {
+			goto out_error_cache_path;
+		}
+		theme->cache = xcursor_cache_open(cache_path, size, theme->stamp);
 	}
 
+	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s' at size %d%s", theme->name,
+		size, theme->cache != NULL ? " from cache" : "");
 	return theme;
 
+out_error_cache_path:
+	free(theme->name);
 out_error_name:
 	free(theme);
 	return NULL;
 }
 
+struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
+	return wlr_xcursor_theme_load_cached(name, size, NULL);
+}
+
+static void theme_write_cache(struct wlr_xcursor_theme *theme) {
+	// Don't drop cursors which are in the old cache but weren't used
+	if (theme->cache != NULL) {
+		size_t len = xcursor_cache_get_cursor_count(theme->cache);
+		for (size_t i = 0; i < len; i++) {
+			wlr_xcursor_theme_get_cursor(theme,
+				xcursor_cache_get_cursor_name(theme->cache, i));
+		}
+	}
+
+	xcursor_cache_write(theme->cache_path, theme->size, theme->stamp,
+		theme->cursors, theme->cursor_count);
+}
+
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
-	unsigned int i;
+	if (theme->cache_dirty) {
+		theme_write_cache(theme);
+	}
 
-	for (i = 0; i < theme->cursor_count; i++) {
+	for (size_t i = 0; i < theme->cursor_count; i++) {
 		xcursor_destroy(theme->cursors[i]);
 	}
+	for (size_t i = 0; i < theme->index_cap; i++) {
+		free(theme->index[i].name);
+	}
 
+	xcursor_cache_destroy(theme->cache);
+	free(theme->cache_path);
+	free(theme->index);
 	free(theme->name);
 	free(theme->cursors);
 	free(theme);
@@ -271,18 +386,33 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
 		const char *name) {
-	unsigned int i;
-
-	for (i = 0; i < theme->cursor_count; i++) {
-		if (strcmp(name, theme->cursors[i]->name) == 0) {
-			return theme->cursors[i];
-		}
+	struct wlr_xcursor_theme_entry *entry =
+		theme_index_find(theme->index, theme->index_cap, name);
+	if (entry != NULL && entry->name != NULL) {
+		return entry->cursor;
+	}
+	if (!theme->lazy) {
+		return NULL;
 	}
 
-	return NULL;
+	struct wlr_xcursor *cursor = theme_load_cursor(theme, name);
+	if (cursor == NULL) {
+		// Missing from the theme and the themes it inherits from
+		cursor = theme_load_builtin_cursor(theme, name);
+	}
+	if (!theme_add_cursor(theme, name, cursor)) {
+		return NULL;
+	}
+	if (cursor != NULL) {
+		struct wlr_xcursor_image *image = cursor->images[0];
+		wlr_log(WLR_DEBUG, "Loaded cursor %s (%u images) %dx%d+%d,%d",
+			cursor->name, cursor->image_count, image->width,
+			image->height, image->hotspot_x, image->hotspot_y);
+	}
+	return cursor;
 }
 
-static int xcursor_frame_and_duration(struct wlr_xcursor *cursor,
+int wlr_xcursor_frame_and_duration(struct wlr_xcursor *cursor,
 		uint32_t time, uint32_t *duration) {
 	uint32_t t;
 	int i;
@@ -325,7 +455,7 @@ static int xcursor_frame_and_duration(struct wlr_xcursor *cursor,
 }
 
 int wlr_xcursor_frame(struct wlr_xcursor *_cursor, uint32_t time) {
-	return xcursor_frame_and_duration(_cursor, time, NULL);
+	return wlr_xcursor_frame_and_duration(_cursor, time, NULL);
 }
 
 const char *wlr_xcursor_get_resize_name(enum wlr_edges edges) {
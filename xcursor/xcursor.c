@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "xcursor/xcursor.h"
 
 /*
@@ -981,3 +982,118 @@ xcursor_load_theme(const char *theme, int size,
 	if (inherits)
 		free(inherits);
 }
+
+static void
+theme_stamp_update(const char *full, int64_t *stamp)
+{
+	struct stat st;
+
+	if (!full || stat(full, &st) != 0)
+		return;
+
+	if (st.st_mtime > *stamp)
+		*stamp = st.st_mtime;
+	if (*stamp <= 0)
+		*stamp = 1;
+}
+
+/** Get a time stamp for a theme
+ *
+ * This function looks up the cursors directories and index files of a
+ * given theme and its inherited themes, without loading any cursor. It can
+ * be used to check whether a theme exists, and whether it has changed since
+ * it was last looked at.
+ *
+ * \param theme The name of the theme
+ * \return The most recent modification time of the theme's directories and
+ * index files, or 0 if the theme can't be found
+ */
+int64_t
+xcursor_theme_stamp(const char *theme)
+{
+	char *full, *dir;
+	char *inherits = NULL;
+	const char *path, *i;
+	int64_t stamp = 0, inherited;
+
+	if (!theme)
+		theme = "default";
+
+	for (path = XcursorLibraryPath();
+	     path;
+	     path = _XcursorNextPath(path)) {
+		dir = _XcursorBuildThemeDir(path, theme);
+		if (!dir)
+			continue;
+
+		full = _XcursorBuildFullname(dir, "cursors", "");
+		theme_stamp_update(full, &stamp);
+		free(full);
+
+		full = _XcursorBuildFullname(dir, "", "index.theme");
+		theme_stamp_update(full, &stamp);
+		if (full && !inherits)
+			inherits = _XcursorThemeInherits(full);
+		free(full);
+
+		free(dir);
+	}
+
+	for (i = inherits; i; i = _XcursorNextPath(i)) {
+		inherited = xcursor_theme_stamp(i);
+		if (inherited > stamp)
+			stamp = inherited;
+	}
+
+	if (inherits)
+		free(inherits);
+	return stamp;
+}
+
+/** Check whether a theme has cursors
+ *
+ * \param theme The name of the theme
+ * \return Whether a cursors directory exists in the theme or one of the
+ * themes it inherits from
+ */
+bool
+xcursor_theme_has_cursors(const char *theme)
+{
+	char *full, *dir;
+	char *inherits = NULL;
+	const char *path, *i;
+	struct stat st;
+	bool found = false;
+
+	if (!theme)
+		theme = "default";
+
+	for (path = XcursorLibraryPath();
+	     path && !found;
+	     path = _XcursorNextPath(path)) {
+		dir = _XcursorBuildThemeDir(path, theme);
+		if (!dir)
+			continue;
+
+		full = _XcursorBuildFullname(dir, "cursors", "");
+		if (full && stat(full, &st) == 0 && S_ISDIR(st.st_mode))
+			found = true;
+		free(full);
+
+		if (!inherits) {
+			full = _XcursorBuildFullname(dir, "", "index.theme");
+			if (full)
+				inherits = _XcursorThemeInherits(full);
+			free(full);
+		}
+
+		free(dir);
+	}
+
+	for (i = inherits; i && !found; i = _XcursorNextPath(i))
+		found = xcursor_theme_has_cursors(i);
+
+	if (inherits)
+		free(inherits);
+	return found;
+}
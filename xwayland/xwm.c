@@ -3,6 +3,7 @@
 #endif
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wlr/config.h>
 #include <wlr/types/wlr_surface.h>
@@ -92,11 +93,94 @@ struct wlr_xwayland_surface *wlr_xwayland_surface_from_wlr_surface(
 	return (struct wlr_xwayland_surface *)surface->role_data;
 }
 
-// TODO: replace this with hash table?
+#define SURFACE_MAP_MIN_BUCKETS 64
+
+static struct wl_list *surface_map_bucket(struct xwm_surface_map *map,
+		uint32_t key) {
+	// Window IDs share their high bits, surface IDs are sequential
+	uint32_t hash = key * 0x9E3779B1;
+	hash ^= hash >> 16;
+	return &map->buckets[hash & (map->buckets_len - 1)];
+}
+
+static bool surface_map_init(struct xwm_surface_map *map,
+		uint32_t (*get_key)(struct wl_list *link)) {
+	map->buckets = calloc(SURFACE_MAP_MIN_BUCKETS, sizeof(struct wl_list));
+	if (map->buckets == NULL) {
+		return false;
+	}
+	map->buckets_len = SURFACE_MAP_MIN_BUCKETS;
+	map->len = 0;
+	map->get_key = get_key;
+	for (size_t i = 0; i < map->buckets_len; ++i) {
+		wl_list_init(&map->buckets[i]);
+	}
+	return true;
+}
+
+static void surface_map_finish(struct xwm_surface_map *map) {
+	free(map->buckets);
+	map->buckets = NULL;
+}
+
+static void surface_map_grow(struct xwm_surface_map *map) {
+	size_t buckets_len = map->buckets_len * 2;
+	struct wl_list *buckets = calloc(buckets_len, sizeof(struct wl_list));
+	if (buckets == NULL) {
+		// Lookups get slower, but still work
+		return;
+	}
+	for (size_t i = 0; i < buckets_len; ++i) {
+		wl_list_init(&buckets[i]);
+	}
+
+	struct wl_list *old_buckets = map->buckets;
+	size_t old_buckets_len = map->buckets_len;
+	map->buckets = buckets;
+	map->buckets_len = buckets_len;
+	for (size_t i = 0; i < old_buckets_len; ++i) {
+		struct wl_list *link, *tmp;
+		for (link = old_buckets[i].next, tmp = link->next;
+				link != &old_buckets[i]; link = tmp, tmp = link->next) {
+			wl_list_insert(surface_map_bucket(map, map->get_key(link)), link);
+		}
+	}
+	free(old_buckets);
+}
+
+static void surface_map_insert(struct xwm_surface_map *map,
+		struct wl_list *link) {
+	if (map->len >= map->buckets_len) {
+		surface_map_grow(map);
+	}
+	wl_list_insert(surface_map_bucket(map, map->get_key(link)), link);
+	map->len++;
+}
+
+static void surface_map_remove(struct xwm_surface_map *map,
+		struct wl_list *link) {
+	wl_list_remove(link);
+	map->len--;
+}
+
+static uint32_t surface_get_window_id(struct wl_list *link) {
+	struct wlr_xwayland_surface *surface =
+		wl_container_of(link, surface, window_link);
+	return surface->window_id;
+}
+
+static uint32_t surface_get_surface_id(struct wl_list *link) {
+	struct wlr_xwayland_surface *surface =
+		wl_container_of(link, surface, unpaired_link);
+	return surface->surface_id;
+}
+
 static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 		xcb_window_t window_id) {
+	struct wl_list *bucket =
+		surface_map_bucket(&xwm->surfaces_by_window, window_id);
 	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
+	wl_list_for_each(surface, bucket, window_link) {
 		if (surface->window_id == window_id) {
 			return surface;
 		}
@@ -104,6 +188,19 @@ static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
 	return NULL;
 }
 
+static struct wlr_xwayland_surface *lookup_unpaired_surface(
+		struct wlr_xwm *xwm, uint32_t surface_id) {
+	struct wl_list *bucket =
+		surface_map_bucket(&xwm->unpaired_surfaces, surface_id);
+	struct wlr_xwayland_surface *surface;
+	wl_list_for_each(surface, bucket, unpaired_link) {
+		if (surface->surface_id == surface_id) {
+			return surface;
+		}
+	}
+	return NULL;
+}
+
 static int xwayland_surface_handle_ping_timeout(void *data) {
 	struct wlr_xwayland_surface *surface = data;
 
@@ -140,6 +237,7 @@ static struct wlr_xwayland_surface *xwayland_surface_create(
 	surface->height = height;
 	surface->override_redirect = override_redirect;
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	surface_map_insert(&xwm->surfaces_by_window, &surface->window_link);
 	wl_list_init(&surface->children);
 	wl_list_init(&surface->parent_link);
 	wl_signal_init(&surface->events.destroy);
@@ -317,6 +415,8 @@ static void xsurface_set_net_wm_state(struct wlr_xwayland_surface *xsurface) {
 }
 
 static void xsurface_unmap(struct wlr_xwayland_surface *surface);
+static void xwm_cancel_property_requests(struct wlr_xwm *xwm,
+	struct wlr_xwayland_surface *xsurface);
 
 static void xwayland_surface_destroy(
 		struct wlr_xwayland_surface *xsurface) {
@@ -328,7 +428,11 @@ static void xwayland_surface_destroy(
 		xwm_surface_activate(xsurface->xwm, NULL);
 	}
 
+	xwm_cancel_property_requests(xsurface->xwm, xsurface);
+
 	wl_list_remove(&xsurface->link);
+	surface_map_remove(&xsurface->xwm->surfaces_by_window,
+		&xsurface->window_link);
 	wl_list_remove(&xsurface->parent_link);
 
 	struct wlr_xwayland_surface *child, *next;
@@ -339,7 +443,8 @@ static void xwayland_surface_destroy(
 	}
 
 	if (xsurface->surface_id) {
-		wl_list_remove(&xsurface->unpaired_link);
+		surface_map_remove(&xsurface->xwm->unpaired_surfaces,
+			&xsurface->unpaired_link);
 	}
 
 	if (xsurface->surface) {
@@ -684,15 +789,8 @@ char *xwm_get_atom_name(struct wlr_xwm *xwm, xcb_atom_t atom) {
 }
 
 static void read_surface_property(struct wlr_xwm *xwm,
-		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
-		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply = xcb_get_property_reply(xwm->xcb_conn,
-		cookie, NULL);
-	if (reply == NULL) {
-		return;
-	}
-
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		xcb_get_property_reply_t *reply) {
 	if (property == XCB_ATOM_WM_CLASS) {
 		read_surface_class(xwm, xsurface, reply);
 	} else if (property == XCB_ATOM_WM_NAME ||
@@ -722,8 +820,94 @@ static void read_surface_property(struct wlr_xwm *xwm,
 			property, prop_name, xsurface->window_id);
 		free(prop_name);
 	}
+}
 
-	free(reply);
+/**
+ * Ask the X server for a surface property. The reply is handled later on, by
+ * xwm_read_property_replies.
+ */
+static void xwm_request_surface_property(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
+	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
+		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
+
+	struct wlr_xwm_property_request *req =
+		calloc(1, sizeof(struct wlr_xwm_property_request));
+	if (req == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		xcb_get_property_reply_t *reply =
+			xcb_get_property_reply(xwm->xcb_conn, cookie, NULL);
+		if (reply != NULL) {
+			read_surface_property(xwm, xsurface, property, reply);
+			free(reply);
+		}
+		return;
+	}
+	req->surface = xsurface;
+	req->property = property;
+	req->cookie = cookie;
+	wl_list_insert(xwm->pending_properties.prev, &req->link);
+}
+
+/**
+ * Handle the replies to property requests which have already been received,
+ * in request order. If wait_surface is not NULL, block until all pending
+ * requests for this surface are complete.
+ */
+static int xwm_read_property_replies(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *wait_surface) {
+	struct wlr_xwm_property_request *last = NULL, *req, *tmp;
+	if (wait_surface != NULL) {
+		wl_list_for_each_reverse(req, &xwm->pending_properties, link) {
+			if (req->surface == wait_surface) {
+				last = req;
+				break;
+			}
+		}
+	}
+
+	int count = 0;
+	wl_list_for_each_safe(req, tmp, &xwm->pending_properties, link) {
+		xcb_get_property_reply_t *reply = NULL;
+		if (last != NULL) {
+			reply = xcb_get_property_reply(xwm->xcb_conn, req->cookie, NULL);
+		} else {
+			xcb_generic_error_t *error = NULL;
+			if (!xcb_poll_for_reply(xwm->xcb_conn, req->cookie.sequence,
+					(void **)&reply, &error)) {
+				// Replies are received in order
+				break;
+			}
+			free(error);
+		}
+		if (req == last) {
+			last = NULL;
+		}
+
+		struct wlr_xwayland_surface *xsurface = req->surface;
+		xcb_atom_t property = req->property;
+		wl_list_remove(&req->link);
+		free(req);
+
+		if (reply != NULL) {
+			read_surface_property(xwm, xsurface, property, reply);
+			free(reply);
+		}
+		count++;
+	}
+	return count;
+}
+
+static void xwm_cancel_property_requests(struct wlr_xwm *xwm,
+		struct wlr_xwayland_surface *xsurface) {
+	struct wlr_xwm_property_request *req, *tmp;
+	wl_list_for_each_safe(req, tmp, &xwm->pending_properties, link) {
+		if (req->surface == xsurface) {
+			xcb_discard_reply(xwm->xcb_conn, req->cookie.sequence);
+			wl_list_remove(&req->link);
+			free(req);
+		}
+	}
 }
 
 static void xwayland_surface_role_commit(struct wlr_surface *wlr_surface) {
@@ -734,6 +918,8 @@ static void xwayland_surface_role_commit(struct wlr_surface *wlr_surface) {
 	}
 
 	if (!surface->mapped && wlr_surface_has_buffer(surface->surface)) {
+		// Compositors expect the initial properties to be set on map
+		xwm_read_property_replies(surface->xwm, surface);
 		wlr_signal_emit_safe(&surface->events.map, surface);
 		surface->mapped = true;
 		xwm_set_net_client_list(surface->xwm);
@@ -780,7 +966,7 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 
 	xsurface->surface = surface;
 
-	// read all surface properties
+	// request all surface properties at once
 	const xcb_atom_t props[] = {
 		XCB_ATOM_WM_CLASS,
 		XCB_ATOM_WM_NAME,
@@ -795,7 +981,7 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 		xwm->atoms[NET_WM_PID],
 	};
 	for (size_t i = 0; i < sizeof(props)/sizeof(xcb_atom_t); i++) {
-		read_surface_property(xwm, xsurface, props[i]);
+		xwm_request_surface_property(xwm, xsurface, props[i]);
 	}
 
 	xsurface->surface_destroy.notify = handle_surface_destroy;
@@ -813,7 +999,8 @@ static void xsurface_unmap(struct wlr_xwayland_surface *surface) {
 		// Make sure we're not on the unpaired surface list or we
 		// could be assigned a surface during surface creation that
 		// was mapped before this unmap request.
-		wl_list_remove(&surface->unpaired_link);
+		surface_map_remove(&surface->xwm->unpaired_surfaces,
+			&surface->unpaired_link);
 		surface->surface_id = 0;
 	}
 
@@ -970,7 +1157,7 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	read_surface_property(xwm, xsurface, ev->atom);
+	xwm_request_surface_property(xwm, xsurface, ev->atom);
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -982,17 +1169,22 @@ static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
 			ev->window);
 		return;
 	}
+	if (xsurface->surface_id) {
+		// Superseded by this message
+		surface_map_remove(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		xsurface->surface_id = 0;
+	}
+
 	/* Check if we got notified after wayland surface create event */
 	uint32_t id = ev->data.data32[0];
 	struct wl_resource *resource =
 		wl_client_get_object(xwm->xwayland->client, id);
 	if (resource) {
 		struct wlr_surface *surface = wlr_surface_from_resource(resource);
-		xsurface->surface_id = 0;
 		xwm_map_shell_surface(xwm, xsurface, surface);
 	} else {
 		xsurface->surface_id = id;
-		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		surface_map_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
 	}
 }
 
@@ -1307,17 +1499,110 @@ static void xwm_handle_unhandled_event(struct wlr_xwm *xwm, xcb_generic_event_t
 #endif
 }
 
+#define XWM_EVENT_BUDGET 256
+
+/**
+ * Check whether a later event of the batch makes this one redundant. Only the
+ * last ConfigureNotify of a window and the last PropertyNotify of a window
+ * property need to be handled.
+ */
+static bool xwm_event_superseded(xcb_generic_event_t *event,
+		xcb_generic_event_t **later, size_t later_len) {
+	uint8_t type = event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK;
+	if (type != XCB_CONFIGURE_NOTIFY && type != XCB_PROPERTY_NOTIFY) {
+		return false;
+	}
+
+	for (size_t i = 0; i < later_len; i++) {
+		if ((later[i]->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) != type) {
+			continue;
+		}
+		if (type == XCB_CONFIGURE_NOTIFY) {
+			xcb_configure_notify_event_t *ev =
+				(xcb_configure_notify_event_t *)event;
+			xcb_configure_notify_event_t *other =
+				(xcb_configure_notify_event_t *)later[i];
+			if (ev->window == other->window) {
+				return true;
+			}
+		} else {
+			xcb_property_notify_event_t *ev =
+				(xcb_property_notify_event_t *)event;
+			xcb_property_notify_event_t *other =
+				(xcb_property_notify_event_t *)later[i];
+			if (ev->window == other->window && ev->atom == other->atom) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void xwm_handle_event(struct wlr_xwm *xwm, xcb_generic_event_t *event) {
+	switch (event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) {
+	case XCB_CREATE_NOTIFY:
+		xwm_handle_create_notify(xwm, (xcb_create_notify_event_t *)event);
+		break;
+	case XCB_DESTROY_NOTIFY:
+		xwm_handle_destroy_notify(xwm, (xcb_destroy_notify_event_t *)event);
+		break;
+	case XCB_CONFIGURE_REQUEST:
+		xwm_handle_configure_request(xwm,
+			(xcb_configure_request_event_t *)event);
+		break;
+	case XCB_CONFIGURE_NOTIFY:
+		xwm_handle_configure_notify(xwm,
+			(xcb_configure_notify_event_t *)event);
+		break;
+	case XCB_MAP_REQUEST:
+		xwm_handle_map_request(xwm, (xcb_map_request_event_t *)event);
+		break;
+	case XCB_MAP_NOTIFY:
+		xwm_handle_map_notify(xwm, (xcb_map_notify_event_t *)event);
+		break;
+	case XCB_UNMAP_NOTIFY:
+		xwm_handle_unmap_notify(xwm, (xcb_unmap_notify_event_t *)event);
+		break;
+	case XCB_PROPERTY_NOTIFY:
+		xwm_handle_property_notify(xwm,
+			(xcb_property_notify_event_t *)event);
+		break;
+	case XCB_CLIENT_MESSAGE:
+		xwm_handle_client_message(xwm, (xcb_client_message_event_t *)event);
+		break;
+	case XCB_FOCUS_IN:
+		xwm_handle_focus_in(xwm, (xcb_focus_in_event_t *)event);
+		break;
+	case 0:
+		xwm_handle_xcb_error(xwm, (xcb_value_error_t *)event);
+		break;
+	default:
+		xwm_handle_unhandled_event(xwm, event);
+		break;
+	}
+}
+
 static int x11_event_handler(int fd, uint32_t mask, void *data) {
-	int count = 0;
-	xcb_generic_event_t *event;
 	struct wlr_xwm *xwm = data;
 
-	while ((event = xcb_poll_for_event(xwm->xcb_conn))) {
-		count++;
+	// Handle at most XWM_EVENT_BUDGET events per dispatch, so that a busy X
+	// client can't starve Wayland clients
+	xcb_generic_event_t *events[XWM_EVENT_BUDGET];
+	size_t events_len = 0;
+	while (events_len < XWM_EVENT_BUDGET &&
+			(events[events_len] = xcb_poll_for_event(xwm->xcb_conn))) {
+		events_len++;
+	}
+
+	for (size_t i = 0; i < events_len; i++) {
+		xcb_generic_event_t *event = events[i];
+		uint8_t type = event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK;
+		xwm->stats.events[type]++;
 
 		if (xwm->xwayland->user_event_handler &&
 				xwm->xwayland->user_event_handler(xwm, event)) {
-			break;
+			free(event);
+			continue;
 		}
 
 		if (xwm_handle_selection_event(xwm, event)) {
@@ -1325,57 +1610,41 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 			continue;
 		}
 
-		switch (event->response_type & XCB_EVENT_RESPONSE_TYPE_MASK) {
-		case XCB_CREATE_NOTIFY:
-			xwm_handle_create_notify(xwm, (xcb_create_notify_event_t *)event);
-			break;
-		case XCB_DESTROY_NOTIFY:
-			xwm_handle_destroy_notify(xwm, (xcb_destroy_notify_event_t *)event);
-			break;
-		case XCB_CONFIGURE_REQUEST:
-			xwm_handle_configure_request(xwm,
-				(xcb_configure_request_event_t *)event);
-			break;
-		case XCB_CONFIGURE_NOTIFY:
-			xwm_handle_configure_notify(xwm,
-				(xcb_configure_notify_event_t *)event);
-			break;
-		case XCB_MAP_REQUEST:
-			xwm_handle_map_request(xwm, (xcb_map_request_event_t *)event);
-			break;
-		case XCB_MAP_NOTIFY:
-			xwm_handle_map_notify(xwm, (xcb_map_notify_event_t *)event);
-			break;
-		case XCB_UNMAP_NOTIFY:
-			xwm_handle_unmap_notify(xwm, (xcb_unmap_notify_event_t *)event);
-			break;
-		case XCB_PROPERTY_NOTIFY:
-			xwm_handle_property_notify(xwm,
-				(xcb_property_notify_event_t *)event);
-			break;
-		case XCB_CLIENT_MESSAGE:
-			xwm_handle_client_message(xwm, (xcb_client_message_event_t *)event);
-			break;
-		case XCB_FOCUS_IN:
-			xwm_handle_focus_in(xwm, (xcb_focus_in_event_t *)event);
-			break;
-		case 0:
-			xwm_handle_xcb_error(xwm, (xcb_value_error_t *)event);
-			break;
-		default:
-			xwm_handle_unhandled_event(xwm, event);
-			break;
+		if (xwm_event_superseded(event, &events[i + 1],
+				events_len - i - 1)) {
+			xwm->stats.coalesced_events[type]++;
+			free(event);
+			continue;
 		}
+
+		xwm_handle_event(xwm, event);
 		free(event);
 	}
 
+	int count = events_len + xwm_read_property_replies(xwm, NULL);
+
 	if (count) {
 		xcb_flush(xwm->xcb_conn);
 	}
 
+	if (events_len == XWM_EVENT_BUDGET) {
+		// More events may be queued, but xcb might have read them already
+		// so the fd won't wake us up: resume on the next loop iteration,
+		// after other sources had a chance to be dispatched
+		xwm->stats.budget_exhausted++;
+		wl_event_source_timer_update(xwm->dispatch_timer, 1);
+		return 0;
+	}
+
 	return count;
 }
 
+static int x11_dispatch_timer_handler(void *data) {
+	struct wlr_xwm *xwm = data;
+	x11_event_handler(-1, 0, xwm);
+	return 0;
+}
+
 static void handle_compositor_new_surface(struct wl_listener *listener,
 		void *data) {
 	struct wlr_xwm *xwm =
@@ -1388,15 +1657,13 @@ static void handle_compositor_new_surface(struct wl_listener *listener,
 	wlr_log(WLR_DEBUG, "New xwayland surface: %p", surface);
 
 	uint32_t surface_id = wl_resource_get_id(surface->resource);
-	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
-		if (xsurface->surface_id == surface_id) {
-			xwm_map_shell_surface(xwm, xsurface, surface);
-			xsurface->surface_id = 0;
-			wl_list_remove(&xsurface->unpaired_link);
-			xcb_flush(xwm->xcb_conn);
-			return;
-		}
+	struct wlr_xwayland_surface *xsurface =
+		lookup_unpaired_surface(xwm, surface_id);
+	if (xsurface != NULL) {
+		xwm_map_shell_surface(xwm, xsurface, surface);
+		xsurface->surface_id = 0;
+		surface_map_remove(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		xcb_flush(xwm->xcb_conn);
 	}
 }
 
@@ -1475,6 +1742,9 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	if (xwm->event_source) {
 		wl_event_source_remove(xwm->event_source);
 	}
+	if (xwm->dispatch_timer) {
+		wl_event_source_remove(xwm->dispatch_timer);
+	}
 #if WLR_HAS_XCB_ERRORS
 	if (xwm->errors_context) {
 		xcb_errors_context_free(xwm->errors_context);
@@ -1484,9 +1754,8 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_for_each_safe(xsurface, tmp, &xwm->surfaces, link) {
 		xwayland_surface_destroy(xsurface);
 	}
-	wl_list_for_each_safe(xsurface, tmp, &xwm->unpaired_surfaces, link) {
-		xwayland_surface_destroy(xsurface);
-	}
+	surface_map_finish(&xwm->surfaces_by_window);
+	surface_map_finish(&xwm->unpaired_surfaces);
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	xcb_disconnect(xwm->xcb_conn);
@@ -1703,7 +1972,14 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 
 	xwm->xwayland = wlr_xwayland;
 	wl_list_init(&xwm->surfaces);
-	wl_list_init(&xwm->unpaired_surfaces);
+	wl_list_init(&xwm->pending_properties);
+	if (!surface_map_init(&xwm->surfaces_by_window, surface_get_window_id) ||
+			!surface_map_init(&xwm->unpaired_surfaces,
+				surface_get_surface_id)) {
+		surface_map_finish(&xwm->surfaces_by_window);
+		free(xwm);
+		return NULL;
+	}
 	xwm->ping_timeout = 10000;
 
 	xwm->xcb_conn = xcb_connect_to_fd(wlr_xwayland->wm_fd[0], NULL);
@@ -1712,6 +1988,8 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 	if (rc) {
 		wlr_log(WLR_ERROR, "xcb connect failed: %d", rc);
 		close(wlr_xwayland->wm_fd[0]);
+		surface_map_finish(&xwm->surfaces_by_window);
+		surface_map_finish(&xwm->unpaired_surfaces);
 		free(xwm);
 		return NULL;
 	}
@@ -1736,6 +2014,13 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 			x11_event_handler,
 			xwm);
 	wl_event_source_check(xwm->event_source);
+	xwm->dispatch_timer = wl_event_loop_add_timer(event_loop,
+		x11_dispatch_timer_handler, xwm);
+	if (xwm->dispatch_timer == NULL) {
+		wlr_log(WLR_ERROR, "Could not create X11 event dispatch timer");
+		xwm_destroy(xwm);
+		return NULL;
+	}
 
 	xwm_get_resources(xwm);
 	xwm_get_visual_and_colormap(xwm);
@@ -1858,3 +2143,12 @@ bool wlr_xwayland_or_surface_wants_focus(
 
 	return ret;
 }
+
+void wlr_xwayland_get_stats(struct wlr_xwayland *wlr_xwayland,
+		struct wlr_xwayland_stats *stats) {
+	if (wlr_xwayland->xwm == NULL) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+	*stats = wlr_xwayland->xwm->stats;
+}